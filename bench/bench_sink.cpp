@@ -0,0 +1,80 @@
+// Workload sink for pipeline_bench: reads stdin to the end. With --relay the
+// input is copied to stdout, so the program can sit in the middle of a
+// pipeline. With EXPECTED_BYTES the exit status is 1 unless exactly that many
+// bytes arrived.
+//
+//   bench_sink [--relay] [EXPECTED_BYTES]
+
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <optional>
+#include <string_view>
+
+#include <unistd.h>
+
+namespace {
+
+[[nodiscard]] bool write_all(const char *data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t written = write(STDOUT_FILENO, data, size);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool relay = false;
+    std::optional<std::size_t> expected;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        std::size_t value = 0;
+        if (arg == "--relay") {
+            relay = true;
+        } else if (const auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), value);
+                   error == std::errc{} && end == arg.data() + arg.size() && !expected.has_value()) {
+            expected = value;
+        } else {
+            std::fputs("usage: bench_sink [--relay] [EXPECTED_BYTES]\n", stderr);
+            return 2;
+        }
+    }
+
+    static char buffer[64 * 1024];
+    std::size_t total = 0;
+    while (true) {
+        const ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count == 0) {
+            break;
+        }
+
+        if (count == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::perror("bench_sink: read");
+            return 1;
+        }
+
+        total += static_cast<std::size_t>(count);
+        if (relay && !write_all(buffer, static_cast<std::size_t>(count))) {
+            std::perror("bench_sink: write");
+            return 1;
+        }
+    }
+
+    return expected.has_value() && *expected != total ? 1 : 0;
+}
@@ -0,0 +1,42 @@
+// Workload generator for pipeline_bench: writes BYTES bytes to stdout.
+//
+//   bench_source BYTES
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+
+#include <unistd.h>
+
+int main(int argc, char **argv) {
+    std::size_t remaining = 0;
+    const std::string_view arg = argc == 2 ? argv[1] : "";
+    const auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), remaining);
+    if (arg.empty() || error != std::errc{} || end != arg.data() + arg.size()) {
+        std::fputs("usage: bench_source BYTES\n", stderr);
+        return 2;
+    }
+
+    static char chunk[64 * 1024];
+    for (std::size_t i = 0; i < sizeof(chunk); ++i) {
+        chunk[i] = (i % 64 == 63) ? '\n' : static_cast<char>('a' + i % 26);
+    }
+
+    while (remaining > 0) {
+        const ssize_t written = write(STDOUT_FILENO, chunk, std::min(remaining, sizeof(chunk)));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::perror("bench_source: write");
+            return 1;
+        }
+
+        remaining -= static_cast<std::size_t>(written);
+    }
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+// End-to-end pipeline benchmark. Command lines are parsed and run through the
+// same Parser/ProcessExecutor path the shell uses, against the bench_source
+// and bench_sink programs built next to this one. Each workload prints one
+// JSON object per line:
+//
+//   {"workload":"throughput","backend":"posix_spawn","stages":4,"bytes":67108864,
+//    "runs":5,"wall_ns":...,"wall_ns_min":...,"bytes_per_sec":...,"spawn_ns_per_stage":null}
+//
+// wall_ns is the median over the runs. spawn_ns_per_stage is reported for the
+// spawn workloads, whose pipelines move no data.
+//
+//   pipeline_bench [--bytes N] [--runs N] [--max-stages N] [--tools DIR]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <readline/history.h>
+#include <unistd.h>
+
+#include "builtins/builtin_registry.hpp"
+#include "core/line_arena.hpp"
+#include "core/parser.hpp"
+#include "core/path_resolver.hpp"
+#include "execution/process_executor.hpp"
+#include "history/history_manager.hpp"
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::size_t bytes{64 * 1024 * 1024};
+    std::size_t runs{5};
+    std::size_t max_stages{8};
+    fs::path tools;
+};
+
+struct Workload {
+    std::string name;
+    std::string line;
+    std::size_t stages;
+    // Bytes moved through the pipeline per run; 0 when the workload measures
+    // launch cost only.
+    std::size_t bytes;
+    // Removed before every run, so appends do not grow without bound.
+    std::optional<fs::path> output_file;
+};
+
+// Runs command lines the way ShellApp::execute_line does.
+class Driver {
+  public:
+    explicit Driver(shell::SpawnBackend backend) : executor_(resolver_, backend) {}
+
+    [[nodiscard]] int run(std::string_view line) {
+        const auto pipeline = parser_.parse(line, arena_);
+        if (!pipeline.has_value()) {
+            throw std::runtime_error(pipeline.error().message);
+        }
+
+        if (pipeline->stages.size() == 1) {
+            return executor_.execute_single(pipeline->stages.front(), registry_);
+        }
+
+        return executor_.execute_pipeline(*pipeline, registry_);
+    }
+
+  private:
+    shell::PathResolver resolver_;
+    shell::HistoryManager history_manager_;
+    shell::BuiltinRegistry registry_{resolver_, history_manager_};
+    shell::LineArena arena_;
+    shell::Parser parser_;
+    shell::ProcessExecutor executor_;
+};
+
+std::string relay_chain(std::size_t stages, std::size_t bytes) {
+    // source | relay ... | sink, `stages` processes in total.
+    std::string line = std::format("bench_source {}", bytes);
+    for (std::size_t i = 2; i < stages; ++i) {
+        line += " | bench_sink --relay";
+    }
+    if (stages > 1) {
+        line += std::format(" | bench_sink {}", bytes);
+    }
+    return line;
+}
+
+std::vector<std::size_t> stage_counts(std::size_t max_stages) {
+    std::vector<std::size_t> counts;
+    for (std::size_t stages = 1; stages < max_stages; stages *= 2) {
+        counts.push_back(stages);
+    }
+    counts.push_back(max_stages);
+    return counts;
+}
+
+std::vector<Workload> make_workloads(const Options &options, const fs::path &scratch) {
+    std::vector<Workload> workloads;
+
+    for (const std::size_t stages : stage_counts(options.max_stages)) {
+        if (stages > 1) {
+            workloads.push_back({"throughput", relay_chain(stages, options.bytes), stages, options.bytes, std::nullopt});
+        }
+    }
+
+    for (const std::size_t stages : stage_counts(options.max_stages)) {
+        workloads.push_back({"spawn", relay_chain(stages, 0), stages, 0, std::nullopt});
+    }
+
+    const fs::path output = scratch / "out";
+    workloads.push_back({"redirect_truncate",
+                         std::format("bench_source {} > {}", options.bytes, output.string()),
+                         1,
+                         options.bytes,
+                         output});
+    workloads.push_back({"redirect_append",
+                         std::format("bench_source {} >> {}", options.bytes, output.string()),
+                         1,
+                         options.bytes,
+                         output});
+
+    // `<` hands the file itself to the stage, so these cost what the reader
+    // costs; the shell copies nothing.
+    const fs::path input = scratch / "in";
+    std::ofstream(input).close();
+    fs::resize_file(input, options.bytes);
+    workloads.push_back(
+        {"redirect_input", std::format("bench_sink {} < {}", options.bytes, input.string()), 1, options.bytes, std::nullopt});
+    workloads.push_back({"redirect_input",
+                         std::format("bench_sink --relay < {} | bench_sink {}", input.string(), options.bytes),
+                         2,
+                         options.bytes,
+                         std::nullopt});
+
+    std::string words;
+    for (int i = 0; i < 4096; ++i) {
+        words += std::format(" word{}", i);
+    }
+    workloads.push_back({"builtin_echo", "echo" + words + std::format(" | bench_sink {}", words.size()), 2, words.size(), std::nullopt});
+
+    std::ostringstream history;
+    shell::HistoryManager().print(history, history_length);
+    workloads.push_back({"builtin_history", std::format("history | bench_sink {}", history.view().size()), 2, history.view().size(), std::nullopt});
+
+    const std::string pwd = fs::current_path().string() + "\n";
+    workloads.push_back({"builtin_chain",
+                         std::format("pwd | echo | pwd | echo | pwd | bench_sink {}", pwd.size()),
+                         6,
+                         pwd.size(),
+                         std::nullopt});
+
+    return workloads;
+}
+
+void report(std::string_view backend, const Workload &workload, std::vector<std::int64_t> wall_ns) {
+    std::ranges::sort(wall_ns);
+    const std::int64_t median = wall_ns[wall_ns.size() / 2];
+    const double seconds = static_cast<double>(median) / 1e9;
+
+    const std::string bytes_per_sec =
+        workload.bytes > 0 ? std::format("{:.0f}", static_cast<double>(workload.bytes) / seconds) : "null";
+    const std::string spawn_ns =
+        workload.bytes == 0 ? std::format("{}", median / static_cast<std::int64_t>(workload.stages)) : "null";
+
+    std::cout << std::format(
+        "{{\"workload\":\"{}\",\"backend\":\"{}\",\"stages\":{},\"bytes\":{},\"runs\":{},\"wall_ns\":{},"
+        "\"wall_ns_min\":{},\"bytes_per_sec\":{},\"spawn_ns_per_stage\":{}}}\n",
+        workload.name,
+        backend,
+        workload.stages,
+        workload.bytes,
+        wall_ns.size(),
+        median,
+        wall_ns.front(),
+        bytes_per_sec,
+        spawn_ns);
+    std::cout.flush();
+}
+
+[[nodiscard]] bool parse_count(std::string_view text, std::size_t &value) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size() && value > 0;
+}
+
+[[nodiscard]] bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string_view arg = argv[i];
+        const std::string_view value = argv[i + 1];
+
+        if (arg == "--tools") {
+            options.tools = value;
+        } else if (arg == "--bytes") {
+            if (!parse_count(value, options.bytes)) {
+                return false;
+            }
+        } else if (arg == "--runs") {
+            if (!parse_count(value, options.runs)) {
+                return false;
+            }
+        } else if (arg == "--max-stages") {
+            if (!parse_count(value, options.max_stages)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+
+    return argc % 2 == 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "usage: pipeline_bench [--bytes N] [--runs N] [--max-stages N] [--tools DIR]" << std::endl;
+        return 2;
+    }
+
+    // The generator and sink are built next to this program.
+    if (options.tools.empty()) {
+        options.tools = fs::read_symlink("/proc/self/exe").parent_path();
+    }
+    const char *path = std::getenv("PATH");
+    const std::string search_path = options.tools.string() + (path != nullptr ? std::string(":") + path : "");
+    setenv("PATH", search_path.c_str(), 1);
+
+    std::string pattern = (fs::temp_directory_path() / "pipeline_bench_XXXXXX").string();
+    if (mkdtemp(pattern.data()) == nullptr) {
+        std::cerr << "pipeline_bench: cannot create a scratch directory" << std::endl;
+        return 1;
+    }
+    const fs::path scratch = pattern;
+
+    using_history();
+    for (int i = 0; i < 10000; ++i) {
+        add_history(std::format("echo history entry {}", i).c_str());
+    }
+
+    int result = 0;
+    const auto workloads = make_workloads(options, scratch);
+    for (const auto backend : {shell::SpawnBackend::PosixSpawn, shell::SpawnBackend::Fork}) {
+        const std::string_view backend_name = backend == shell::SpawnBackend::PosixSpawn ? "posix_spawn" : "fork";
+        Driver driver(backend);
+
+        for (const auto &workload : workloads) {
+            std::vector<std::int64_t> wall_ns;
+            // The first run warms the PATH hash table and the page cache.
+            for (std::size_t run = 0; run <= options.runs; ++run) {
+                if (workload.output_file.has_value()) {
+                    std::error_code ec;
+                    fs::remove(*workload.output_file, ec);
+                }
+
+                const auto start = Clock::now();
+                const int status = driver.run(workload.line);
+                const auto elapsed = Clock::now() - start;
+
+                if (status != 0) {
+                    std::cerr << "pipeline_bench: " << workload.name << " exited with status " << status << std::endl;
+                    result = 1;
+                    break;
+                }
+
+                if (run > 0) {
+                    wall_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+                }
+            }
+
+            if (wall_ns.size() == options.runs) {
+                report(backend_name, workload, std::move(wall_ns));
+            }
+        }
+    }
+
+    std::error_code ec;
+    fs::remove_all(scratch, ec);
+    return result;
+}
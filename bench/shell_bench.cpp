@@ -0,0 +1,366 @@
+// Microbenchmarks for the shell's hot paths. Each benchmark is run in batches
+// sized to take at least --min-time-ms; the median of several batches is
+// reported as ns/op, together with the global operator new calls per op.
+//
+//   shell_bench [--min-time-ms N] [--path-dirs N] [--path-files N] [filter]
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <readline/history.h>
+#include <unistd.h>
+
+#include "builtins/builtin_registry.hpp"
+#include "core/line_arena.hpp"
+#include "core/parser.hpp"
+#include "core/path_resolver.hpp"
+#include "core/tokenizer.hpp"
+#include "execution/fd_writer.hpp"
+#include "history/history_manager.hpp"
+#include "line_editing/completion.hpp"
+
+namespace {
+
+std::size_t allocation_count = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    ++allocation_count;
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t /*size*/) noexcept { std::free(memory); }
+
+namespace {
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// Keeps the compiler from discarding a result it can see is unused.
+template <typename T> void keep(const T &value) { asm volatile("" : : "g"(&value) : "memory"); }
+
+struct Options {
+    std::chrono::milliseconds min_time{200};
+    std::size_t path_dirs{8};
+    std::size_t path_files{200};
+    std::string_view filter;
+};
+
+struct Benchmark {
+    std::string name;
+    // Runs the operation `iterations` times.
+    std::function<void(std::size_t iterations)> run;
+};
+
+struct Result {
+    std::size_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+};
+
+constexpr int samples = 5;
+
+Result measure(const Benchmark &benchmark, std::chrono::milliseconds min_time) {
+    benchmark.run(1);
+
+    std::size_t iterations = 1;
+    while (true) {
+        const auto start = Clock::now();
+        benchmark.run(iterations);
+        if (Clock::now() - start >= min_time / samples || iterations >= (std::size_t{1} << 32)) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    std::array<double, samples> ns_per_op{};
+    std::size_t allocations = 0;
+    for (auto &sample : ns_per_op) {
+        const std::size_t allocations_before = allocation_count;
+        const auto start = Clock::now();
+        benchmark.run(iterations);
+        const auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start);
+        allocations = allocation_count - allocations_before;
+        sample = elapsed.count() / static_cast<double>(iterations);
+    }
+
+    std::ranges::sort(ns_per_op);
+    return Result{
+        .iterations = iterations,
+        .ns_per_op = ns_per_op[samples / 2],
+        .allocs_per_op = static_cast<double>(allocations) / static_cast<double>(iterations),
+    };
+}
+
+// A PATH of `dirs` directories holding `files` executables each, removed again
+// when the fixture goes away. PATH is restored as well.
+class SyntheticPath {
+  public:
+    SyntheticPath(std::size_t dirs, std::size_t files) {
+        std::string pattern = "/tmp/shell_bench_XXXXXX";
+        if (mkdtemp(pattern.data()) == nullptr) {
+            throw std::runtime_error("mkdtemp failed");
+        }
+        root_ = pattern;
+
+        if (const char *path = std::getenv("PATH"); path != nullptr) {
+            saved_path_ = path;
+        }
+
+        std::string path;
+        for (std::size_t d = 0; d < dirs; ++d) {
+            const fs::path dir = root_ / std::format("bin{}", d);
+            fs::create_directory(dir);
+            for (std::size_t f = 0; f < files; ++f) {
+                make_executable(dir / std::format("cmd{}_{}", d, f));
+            }
+
+            if (!path.empty()) {
+                path += ':';
+            }
+            path += dir.string();
+        }
+
+        // The lookup target lives in the last directory, so a miss in the
+        // hash table has to search every directory before it.
+        last_command_ = std::format("cmd{}_{}", dirs - 1, files - 1);
+        setenv("PATH", path.c_str(), 1);
+    }
+
+    ~SyntheticPath() {
+        setenv("PATH", saved_path_.c_str(), 1);
+        std::error_code ec;
+        fs::remove_all(root_, ec);
+    }
+
+    SyntheticPath(const SyntheticPath &) = delete;
+    SyntheticPath &operator=(const SyntheticPath &) = delete;
+
+    [[nodiscard]] const std::string &last_command() const noexcept { return last_command_; }
+
+  private:
+    fs::path root_;
+    std::string saved_path_;
+    std::string last_command_;
+
+    static void make_executable(const fs::path &path) {
+        const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+        if (fd == -1) {
+            throw std::runtime_error("cannot create " + path.string());
+        }
+        close(fd);
+    }
+};
+
+std::string long_line() {
+    std::string line = "printf";
+    for (int i = 0; i < 200; ++i) {
+        line += std::format(" argument-{:03}", i);
+    }
+    return line;
+}
+
+std::string quoted_line() {
+    std::string line = "echo";
+    for (int i = 0; i < 50; ++i) {
+        line += std::format(R"( "double {} quoted" 'single | {}' esc\ aped\"{})", i, i, i);
+    }
+    return line;
+}
+
+void add_lexer_benchmarks(std::vector<Benchmark> &benchmarks) {
+    struct Line {
+        std::string_view name;
+        std::string text;
+    };
+
+    for (Line line : {Line{"short", "echo hello world"}, Line{"long", long_line()}, Line{"quoted", quoted_line()}}) {
+        benchmarks.push_back({std::format("tokenize/{}", line.name), [text = line.text](std::size_t iterations) {
+                                  static shell::LineArena arena;
+                                  const shell::Tokenizer tokenizer;
+                                  for (std::size_t i = 0; i < iterations; ++i) {
+                                      keep(tokenizer.tokenize(text, arena));
+                                  }
+                              }});
+    }
+
+    for (Line line : {Line{"short", "echo hello world"},
+                      Line{"pipeline", "cat input.txt | grep -v '^#' | sort | uniq -c > counts.txt 2>> errors.log"},
+                      Line{"long", long_line()}}) {
+        benchmarks.push_back({std::format("parse/{}", line.name), [text = line.text](std::size_t iterations) {
+                                  static shell::LineArena arena;
+                                  const shell::Parser parser;
+                                  for (std::size_t i = 0; i < iterations; ++i) {
+                                      keep(parser.parse(text, arena));
+                                  }
+                              }});
+    }
+}
+
+void add_resolver_benchmarks(std::vector<Benchmark> &benchmarks, const SyntheticPath &path) {
+    benchmarks.push_back({"path/hashed", [&path](std::size_t iterations) {
+                              static shell::PathResolver resolver;
+                              for (std::size_t i = 0; i < iterations; ++i) {
+                                  keep(resolver.find_command_path(path.last_command()));
+                              }
+                          }});
+
+    benchmarks.push_back({"path/cold", [&path](std::size_t iterations) {
+                              shell::PathResolver resolver;
+                              for (std::size_t i = 0; i < iterations; ++i) {
+                                  resolver.clear_command_cache();
+                                  keep(resolver.find_command_path(path.last_command()));
+                              }
+                          }});
+
+    benchmarks.push_back({"path/not_found", [](std::size_t iterations) {
+                              static shell::PathResolver resolver;
+                              for (std::size_t i = 0; i < iterations; ++i) {
+                                  keep(resolver.find_command_path("no-such-command"));
+                              }
+                          }});
+}
+
+void add_builtin_benchmarks(std::vector<Benchmark> &benchmarks, const SyntheticPath &path) {
+    struct Case {
+        std::string_view name;
+        std::vector<std::string> args;
+    };
+
+    const std::vector<Case> cases{
+        {"echo", {"echo", "hello", "world"}},
+        {"pwd", {"pwd"}},
+        {"type_builtin", {"type", "echo"}},
+        {"type_external", {"type", path.last_command()}},
+        {"history", {"history"}},
+    };
+
+    for (const auto &bench_case : cases) {
+        benchmarks.push_back({std::format("builtin/{}", bench_case.name), [args = bench_case.args](std::size_t iterations) {
+                                  static shell::PathResolver resolver;
+                                  static shell::HistoryManager history_manager;
+                                  static shell::BuiltinRegistry registry(resolver, history_manager);
+                                  static const int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+
+                                  const std::vector<std::string_view> argv(args.begin() + 1, args.end());
+                                  const auto builtin = registry.find(args.front());
+                                  shell::FdOutputStream out(null_fd);
+                                  for (std::size_t i = 0; i < iterations; ++i) {
+                                      keep(registry.execute(*builtin, argv, out, out));
+                                  }
+                              }});
+    }
+}
+
+void add_completion_benchmarks(std::vector<Benchmark> &benchmarks) {
+    for (std::string_view prefix : {"e", "cmd0_1"}) {
+        benchmarks.push_back({std::format("completion/{}", prefix), [prefix](std::size_t iterations) {
+                                  static shell::PathResolver resolver;
+                                  static shell::HistoryManager history_manager;
+                                  static const shell::BuiltinRegistry registry(resolver, history_manager);
+                                  const shell::CompletionEngine engine(registry, resolver);
+                                  const std::string text(prefix);
+                                  for (std::size_t i = 0; i < iterations; ++i) {
+                                      keep(engine.collect_matches(text));
+                                  }
+                              }});
+    }
+}
+
+[[nodiscard]] bool parse_count(std::string_view text, std::size_t &value) {
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc{} && end == text.data() + text.size() && value > 0;
+}
+
+[[nodiscard]] bool parse_options(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        std::size_t value = 0;
+
+        if ((arg == "--min-time-ms" || arg == "--path-dirs" || arg == "--path-files") && i + 1 < argc) {
+            if (!parse_count(argv[++i], value)) {
+                return false;
+            }
+
+            if (arg == "--min-time-ms") {
+                options.min_time = std::chrono::milliseconds(value);
+            } else if (arg == "--path-dirs") {
+                options.path_dirs = value;
+            } else {
+                options.path_files = value;
+            }
+        } else if (!arg.starts_with("--") && options.filter.empty()) {
+            options.filter = arg;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::cerr << "usage: shell_bench [--min-time-ms N] [--path-dirs N] [--path-files N] [filter]" << std::endl;
+        return 2;
+    }
+
+    const SyntheticPath path(options.path_dirs, options.path_files);
+
+    // A history of the size that used to cost a write per line.
+    using_history();
+    for (int i = 0; i < 10000; ++i) {
+        add_history(std::format("echo history entry {}", i).c_str());
+    }
+
+    std::vector<Benchmark> benchmarks;
+    add_lexer_benchmarks(benchmarks);
+    add_resolver_benchmarks(benchmarks, path);
+    add_builtin_benchmarks(benchmarks, path);
+    add_completion_benchmarks(benchmarks);
+
+#ifndef NDEBUG
+    std::cout << "note: built without NDEBUG; configure with -DCMAKE_BUILD_TYPE=Release for comparable numbers\n";
+#endif
+    std::cout << std::format("PATH: {} dirs x {} files\n", options.path_dirs, options.path_files);
+    std::cout << std::format("{:<24} {:>12} {:>14} {:>12}\n", "benchmark", "iterations", "ns/op", "allocs/op");
+
+    for (const auto &benchmark : benchmarks) {
+        if (!benchmark.name.contains(options.filter)) {
+            continue;
+        }
+
+        const Result result = measure(benchmark, options.min_time);
+        std::cout << std::format(
+            "{:<24} {:>12} {:>14.1f} {:>12.2f}\n", benchmark.name, result.iterations, result.ns_per_op, result.allocs_per_op);
+        std::cout.flush();
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "app/script_source.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shell {
+
+std::expected<ScriptSource, std::string> ScriptSource::open_file(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return std::unexpected(std::string(std::strerror(errno)));
+    }
+
+    struct stat info {};
+    if (fstat(fd, &info) == -1) {
+        const int saved_errno = errno;
+        close(fd);
+        return std::unexpected(std::string(std::strerror(saved_errno)));
+    }
+
+    if (S_ISDIR(info.st_mode)) {
+        close(fd);
+        return std::unexpected(std::string(std::strerror(EISDIR)));
+    }
+
+    ScriptSource source;
+
+    // Pipes and other special files cannot be mapped; stream them instead.
+    if (!S_ISREG(info.st_mode)) {
+        source.fd_ = fd;
+        source.owns_fd_ = true;
+        return source;
+    }
+
+    if (info.st_size > 0) {
+        void *mapping = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const int saved_errno = errno;
+            close(fd);
+            return std::unexpected(std::string(std::strerror(saved_errno)));
+        }
+
+        madvise(mapping, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+        source.mapping_ = mapping;
+        source.mapping_size_ = static_cast<std::size_t>(info.st_size);
+        source.pending_ = std::string_view(static_cast<const char *>(mapping), source.mapping_size_);
+    }
+
+    close(fd);
+    return source;
+}
+
+ScriptSource ScriptSource::from_fd(int fd, std::size_t block_size) {
+    ScriptSource source;
+    source.fd_ = fd;
+    source.block_size_ = block_size > 0 ? block_size : default_block_size;
+    return source;
+}
+
+ScriptSource ScriptSource::from_string(std::string_view text) {
+    ScriptSource source;
+    source.pending_ = text;
+    return source;
+}
+
+ScriptSource::ScriptSource(ScriptSource &&other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      owns_fd_(std::exchange(other.owns_fd_, false)),
+      block_size_(other.block_size_),
+      eof_(other.eof_),
+      pending_(std::exchange(other.pending_, {})),
+      mapping_(std::exchange(other.mapping_, nullptr)),
+      mapping_size_(std::exchange(other.mapping_size_, 0)),
+      buffer_(std::move(other.buffer_)) {}
+
+ScriptSource &ScriptSource::operator=(ScriptSource &&other) noexcept {
+    if (this != &other) {
+        release();
+        fd_ = std::exchange(other.fd_, -1);
+        owns_fd_ = std::exchange(other.owns_fd_, false);
+        block_size_ = other.block_size_;
+        eof_ = other.eof_;
+        pending_ = std::exchange(other.pending_, {});
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mapping_size_ = std::exchange(other.mapping_size_, 0);
+        buffer_ = std::move(other.buffer_);
+    }
+
+    return *this;
+}
+
+ScriptSource::~ScriptSource() { release(); }
+
+std::optional<std::string_view> ScriptSource::next_line() {
+    while (true) {
+        if (const auto newline = pending_.find('\n'); newline != std::string_view::npos) {
+            const auto line = pending_.substr(0, newline);
+            pending_.remove_prefix(newline + 1);
+            return line;
+        }
+
+        if (fd_ == -1 || eof_) {
+            if (pending_.empty()) {
+                return std::nullopt;
+            }
+
+            return std::exchange(pending_, {});
+        }
+
+        if (!fill_buffer()) {
+            eof_ = true;
+        }
+    }
+}
+
+bool ScriptSource::fill_buffer() {
+    // Keep the partial line at the front of the buffer and read the next block
+    // behind it; the buffer only grows for lines longer than a block.
+    const std::size_t kept = pending_.size();
+    if (kept > 0 && pending_.data() != buffer_.data()) {
+        std::memmove(buffer_.data(), pending_.data(), kept);
+    }
+
+    if (buffer_.size() < kept + block_size_) {
+        buffer_.resize(kept + block_size_);
+    }
+
+    ssize_t count = 0;
+    do {
+        count = read(fd_, buffer_.data() + kept, block_size_);
+    } while (count == -1 && errno == EINTR);
+
+    if (count <= 0) {
+        pending_ = std::string_view(buffer_.data(), kept);
+        return false;
+    }
+
+    pending_ = std::string_view(buffer_.data(), kept + static_cast<std::size_t>(count));
+    return true;
+}
+
+void ScriptSource::release() noexcept {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        mapping_size_ = 0;
+    }
+
+    if (owns_fd_ && fd_ != -1) {
+        close(fd_);
+    }
+
+    fd_ = -1;
+    owns_fd_ = false;
+    pending_ = {};
+}
+
+} // namespace shell
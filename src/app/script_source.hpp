@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shell {
+
+// Line source for non-interactive execution. Script files are mapped into
+// memory, other descriptors are read in large blocks, and -c strings are used
+// in place; lines are handed out as views without the trailing newline.
+class ScriptSource {
+  public:
+    static constexpr std::size_t default_block_size = 64 * 1024;
+
+    [[nodiscard]] static std::expected<ScriptSource, std::string> open_file(const std::string &path);
+    [[nodiscard]] static ScriptSource from_fd(int fd, std::size_t block_size = default_block_size);
+    [[nodiscard]] static ScriptSource from_string(std::string_view text);
+
+    ScriptSource(ScriptSource &&other) noexcept;
+    ScriptSource &operator=(ScriptSource &&other) noexcept;
+    ~ScriptSource();
+
+    ScriptSource(const ScriptSource &) = delete;
+    ScriptSource &operator=(const ScriptSource &) = delete;
+
+    // The returned view stays valid until the next call.
+    [[nodiscard]] std::optional<std::string_view> next_line();
+
+  private:
+    ScriptSource() = default;
+
+    int fd_{-1};
+    bool owns_fd_{false};
+    std::size_t block_size_{default_block_size};
+    bool eof_{false};
+
+    // Unconsumed text: either the whole mapping / -c string, or the live part
+    // of buffer_ when reading from a descriptor.
+    std::string_view pending_;
+    void *mapping_{nullptr};
+    std::size_t mapping_size_{0};
+    std::vector<char> buffer_;
+
+    [[nodiscard]] bool fill_buffer();
+    void release() noexcept;
+};
+
+} // namespace shell
@@ -1,31 +1,203 @@
 #include "app/shell_app.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <future>
 #include <iostream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
 
+#include <fcntl.h>
 #include <readline/readline.h>
+#include <unistd.h>
+
+#include "app/script_source.hpp"
+#include "core/tokenizer.hpp"
+#include "core/trace.hpp"
+#include "execution/child_reaper.hpp"
+#include "execution/fd_writer.hpp"
+#include "execution/job_table.hpp"
+#include "execution/resource_usage.hpp"
 
 namespace shell {
 
+namespace {
+
+// Traces a whole run into the file named by SHELL_TRACE.
+class TraceSession {
+  public:
+    explicit TraceSession(VariableStore &variables) {
+        const char *path = std::getenv("SHELL_TRACE");
+        if (path == nullptr || *path == '\0') {
+            return;
+        }
+
+        if (!Trace::start(path)) {
+            std::cerr << "shell: cannot write trace to '" << path << "'" << std::endl;
+        }
+
+        // A shell started from this one would truncate the same file.
+        variables.unset("SHELL_TRACE");
+    }
+
+    ~TraceSession() { Trace::stop(); }
+
+    TraceSession(const TraceSession &) = delete;
+    TraceSession &operator=(const TraceSession &) = delete;
+};
+
+[[nodiscard]] std::string_view trimmed(std::string_view text) noexcept {
+    constexpr std::string_view blanks = " \t\r\n";
+    const auto begin = text.find_first_not_of(blanks);
+    if (begin == std::string_view::npos) {
+        return {};
+    }
+
+    return text.substr(begin, text.find_last_not_of(blanks) - begin + 1);
+}
+
+// Appends everything up to end of file to `output`, reading straight into the
+// string's spare room in doubling chunks.
+void read_to_end(int fd, std::string &output) {
+    for (std::size_t chunk = 4096;; chunk = std::min<std::size_t>(chunk * 2, 1024 * 1024)) {
+        const std::size_t used = output.size();
+        ssize_t count = 0;
+        output.resize_and_overwrite(used + chunk, [&](char *data, std::size_t /*size*/) {
+            do {
+                count = read(fd, data + used, chunk);
+            } while (count == -1 && errno == EINTR);
+            return used + static_cast<std::size_t>(std::max<ssize_t>(count, 0));
+        });
+
+        if (count <= 0) {
+            return;
+        }
+    }
+}
+
+} // namespace
+
 ShellApp::ShellApp()
     : path_resolver_(),
       history_manager_(),
       builtin_registry_(path_resolver_, history_manager_),
       completion_engine_(builtin_registry_, path_resolver_),
-      tokenizer_(),
       parser_(),
-      process_executor_(path_resolver_) {}
+      process_executor_(path_resolver_),
+      parameters_(builtin_registry_.variables()) {
+    path_resolver_.use_variables(builtin_registry_.variables());
+    parameters_.set_command_runner([this](std::string_view command) { return substitute_command(command); });
+}
 
-int ShellApp::run() {
-    std::cout << std::unitbuf;
-    std::cerr << std::unitbuf;
+int ShellApp::run(std::span<const char *const> args) {
+    const TraceSession trace_session(builtin_registry_.variables());
+    configure_spawn_backend();
+    configure_pipeline_timeout();
+    configure_autosplit_jobs();
+    JobTable::install_sigchld_handler();
+
+    if (!args.empty() && std::string_view(args[0]) == "-c") {
+        if (args.size() < 2) {
+            std::cerr << "shell: -c: option requires an argument" << std::endl;
+            return 2;
+        }
+
+        auto source = ScriptSource::from_string(args[1]);
+        return run_script(source);
+    }
+
+    if (!args.empty()) {
+        auto source = ScriptSource::open_file(args[0]);
+        if (!source.has_value()) {
+            std::cerr << "shell: " << args[0] << ": " << source.error() << std::endl;
+            return 127;
+        }
+
+        return run_script(*source);
+    }
+
+    if (isatty(STDIN_FILENO) == 0) {
+        auto source = ScriptSource::from_fd(STDIN_FILENO);
+        return run_script(source);
+    }
+
+    return run_interactive();
+}
+
+void ShellApp::configure_spawn_backend() {
+    const char *backend_name = std::getenv("SHELL_SPAWN_BACKEND");
+    if (backend_name == nullptr) {
+        return;
+    }
 
+    if (const auto backend = spawn_backend_from_name(backend_name); backend.has_value()) {
+        process_executor_.set_spawn_backend(*backend);
+    } else {
+        std::cerr << "shell: unknown SHELL_SPAWN_BACKEND '" << backend_name << "'" << std::endl;
+    }
+}
+
+// SHELL_PIPELINE_TIMEOUT: seconds, fractions allowed, that a foreground
+// pipeline may run before its stages are terminated.
+void ShellApp::configure_pipeline_timeout() {
+    const char *seconds_text = std::getenv("SHELL_PIPELINE_TIMEOUT");
+    if (seconds_text == nullptr || *seconds_text == '\0') {
+        return;
+    }
+
+    const std::string_view text(seconds_text);
+    double seconds = 0;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), seconds);
+    if (ec != std::errc{} || ptr != text.data() + text.size() || !(seconds >= 0)) {
+        std::cerr << "shell: invalid SHELL_PIPELINE_TIMEOUT '" << seconds_text << "'" << std::endl;
+        return;
+    }
+
+    process_executor_.set_pipeline_timeout(
+        std::chrono::ceil<std::chrono::milliseconds>(std::chrono::duration<double>(seconds)));
+}
+
+// SHELL_AUTOSPLIT_JOBS: how many batches of a command split by `set -o
+// autosplit` run in parallel; 0 for one per CPU.
+void ShellApp::configure_autosplit_jobs() {
+    const char *jobs_text = std::getenv("SHELL_AUTOSPLIT_JOBS");
+    if (jobs_text == nullptr || *jobs_text == '\0') {
+        return;
+    }
+
+    const std::string_view text(jobs_text);
+    std::size_t jobs = 0;
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), jobs);
+    if (ec != std::errc{} || ptr != text.data() + text.size()) {
+        std::cerr << "shell: invalid SHELL_AUTOSPLIT_JOBS '" << jobs_text << "'" << std::endl;
+        return;
+    }
+
+    process_executor_.set_autosplit_jobs(jobs);
+}
+
+int ShellApp::run_interactive() {
     completion_engine_.install();
     history_manager_.initialize();
+    interactive_ = true;
 
     while (true) {
-        char *line = readline("$ ");
+        JobTable &jobs = builtin_registry_.jobs();
+        jobs.reap_if_signalled();
+        jobs.report_finished(std::cerr);
+
+        char *line = nullptr;
+        {
+            const TraceSpan span("readline");
+            line = readline("$ ");
+        }
         if (line == nullptr) {
             std::cout << std::endl;
             break;
@@ -35,33 +207,310 @@ int ShellApp::run() {
         std::free(line);
 
         history_manager_.record_input(input);
+        execute_line(input);
 
-        const auto tokens = tokenizer_.tokenize(input);
-        if (tokens.empty()) {
-            continue;
+        if (builtin_registry_.exit_requested()) {
+            break;
         }
+    }
 
-        auto pipeline_result = parser_.parse(tokens);
-        if (!pipeline_result.has_value()) {
-            std::cerr << pipeline_result.error().message << std::endl;
-            continue;
+    history_manager_.save();
+    return 0;
+}
+
+// Batch mode: no prompt, no readline and no history; lines go straight to the
+// parser. Commands do not share the script's stdin because input is read
+// ahead in blocks.
+int ShellApp::run_script(ScriptSource &source) {
+    script_ = &source;
+    while (const auto line = source.next_line()) {
+        builtin_registry_.jobs().reap_if_signalled();
+        execute_line(*line);
+
+        if (builtin_registry_.exit_requested()) {
+            break;
         }
+    }
+
+    script_ = nullptr;
+    return parameters_.last_status();
+}
 
-        const Pipeline &pipeline = pipeline_result.value();
+void ShellApp::execute_line(std::string_view input) {
+    // Reading here-document bodies may reuse the storage `input` points into,
+    // so a line that might have any is copied first.
+    if (input.find("<<") != std::string_view::npos) {
+        held_line_.assign(input);
+        input = held_line_;
+    }
+
+    const TraceSpan span("line", input);
+    auto pipeline_result = parser_.parse(input, line_arena_, &parameters_);
+    if (!pipeline_result.has_value()) {
+        std::cerr << pipeline_result.error().message << std::endl;
+        parameters_.set_last_status(2);
+        return;
+    }
 
-        if (pipeline.stages.size() == 1) {
-            process_executor_.execute_single(pipeline.stages.front(), builtin_registry_);
-        } else {
-            process_executor_.execute_pipeline(pipeline, builtin_registry_);
+    if (read_here_documents(*pipeline_result)) {
+        execute_parsed(*pipeline_result, input);
+    }
+
+    here_documents_.clear();
+}
+
+void ShellApp::execute_parsed(const Pipeline &pipeline, std::string_view input) {
+    if (pipeline.background) {
+        start_background(pipeline, input);
+        return;
+    }
+
+    if (pipeline.timing != PipelineTiming::None) {
+        PipelineTimes times;
+        if (!pipeline.empty()) {
+            run_pipeline(pipeline, &times);
         }
+        print_times(std::cerr, times, pipeline.timing == PipelineTiming::PerStage);
+        return;
+    }
 
-        if (builtin_registry_.exit_requested()) {
-            break;
+    if (pipeline.empty()) {
+        return;
+    }
+
+    run_pipeline(pipeline, nullptr);
+}
+
+// Bodies follow the line in the order their redirections appear and are
+// written straight into descriptors as they are read. Returns false, with
+// the status set, if one could not be stored.
+bool ShellApp::read_here_documents(Pipeline &pipeline) {
+    for (auto &stage : pipeline.stages) {
+        for (auto &redirection : stage.redirections) {
+            if (redirection.op != RedirectionOp::StdinDocument) {
+                continue;
+            }
+
+            HereDocument &body = here_documents_.emplace_back();
+            read_here_document(redirection, body);
+            redirection.source_fd = body.finish();
+            if (redirection.source_fd == -1) {
+                std::cerr << "shell: " << body.error() << std::endl;
+                parameters_.set_last_status(1);
+                return false;
+            }
         }
     }
 
-    history_manager_.save();
-    return 0;
+    return true;
+}
+
+void ShellApp::read_here_document(const Redirection &redirection, HereDocument &body) {
+    const TraceSpan span("here_document", redirection.target);
+    while (const auto line = next_continuation_line()) {
+        std::string_view text = *line;
+        if (redirection.strip_tabs) {
+            text.remove_prefix(std::min(text.find_first_not_of('\t'), text.size()));
+        }
+
+        if (text == redirection.target) {
+            return;
+        }
+
+        body.append(redirection.literal ? text : Lexer(text, here_arena_, &parameters_).expand_document());
+        body.append("\n");
+    }
+
+    std::cerr << "shell: warning: here-document delimited by end-of-file (wanted `" << redirection.target << "')"
+              << std::endl;
+}
+
+std::optional<std::string_view> ShellApp::next_continuation_line() {
+    if (script_ != nullptr) {
+        return script_->next_line();
+    }
+
+    char *line = readline("> ");
+    if (line == nullptr) {
+        return std::nullopt;
+    }
+
+    continuation_line_.assign(line);
+    std::free(line);
+    return continuation_line_;
+}
+
+void ShellApp::run_pipeline(const Pipeline &pipeline, PipelineTimes *times) {
+    if (pipeline.stages.size() == 1) {
+        parameters_.set_last_status(process_executor_.execute_single(pipeline.stages.front(), builtin_registry_, times));
+    } else {
+        parameters_.set_last_status(process_executor_.execute_pipeline(pipeline, builtin_registry_, times));
+    }
+
+    parameters_.set_pipe_status(process_executor_.stage_statuses());
+}
+
+// The job is announced as `[N] PID` only at the prompt, like other shells do
+// without job control in scripts. `time` is ignored for background jobs.
+void ShellApp::start_background(const Pipeline &pipeline, std::string_view input) {
+    const auto pids = process_executor_.start_background(pipeline, builtin_registry_);
+    JobTable &jobs = builtin_registry_.jobs();
+    const int id = jobs.add(pids, std::string(trimmed(input)));
+
+    if (!pids.empty() && pids.back() != -1) {
+        parameters_.set_last_background_pid(pids.back());
+        if (interactive_) {
+            std::cerr << '[' << id << "] " << pids.back() << std::endl;
+        }
+    }
+
+    parameters_.set_last_status(0);
+    parameters_.set_pipe_status(std::array{0});
+}
+
+// `$(command)`: the command is parsed and run like a line of its own, with
+// `$?` left at its status, and its output comes back without the trailing
+// newlines. Nested substitutions run while the outer one is being parsed, so
+// each level has its own arena and buffer.
+std::optional<std::string_view> ShellApp::substitute_command(std::string_view command) {
+    const TraceSpan span("substitution", command);
+    if (substitutions_.size() == substitution_depth_) {
+        substitutions_.push_back(std::make_unique<Substitution>());
+    }
+    Substitution &substitution = *substitutions_[substitution_depth_];
+    ++substitution_depth_;
+    struct DepthGuard {
+        std::size_t &depth;
+        ~DepthGuard() { --depth; }
+    } depth_guard{substitution_depth_};
+
+    auto pipeline = parser_.parse(command, substitution.arena, &parameters_);
+    if (!pipeline.has_value()) {
+        std::cerr << pipeline.error().message << std::endl;
+        parameters_.set_last_status(2);
+        return std::nullopt;
+    }
+
+    for (const auto &stage : pipeline->stages) {
+        for (const auto &redirection : stage.redirections) {
+            if (redirection.op == RedirectionOp::StdinDocument) {
+                std::cerr << "shell: here-documents are not supported in command substitutions" << std::endl;
+                parameters_.set_last_status(2);
+                return std::nullopt;
+            }
+        }
+    }
+
+    substitution.output.clear();
+    if (!pipeline->empty() || pipeline->timing != PipelineTiming::None) {
+        capture_output(*pipeline, command, substitution.output);
+    }
+
+    std::string &output = substitution.output;
+    output.erase(output.find_last_not_of('\n') + 1);
+    return output;
+}
+
+// A lone builtin that leaves no shell state behind writes straight into
+// `output`, with no pipe and no fork. Anything else runs with the shell's
+// stdout swapped for a pipe drained into `output` by a reader thread. A
+// pipeline with any stage that could change the shell's state (cd, exit,
+// set -o, a bare assignment), timed or not, runs in a forked copy of the shell
+// instead, like a subshell.
+void ShellApp::capture_output(const Pipeline &pipeline, std::string_view command, std::string &output) {
+    const bool lone = pipeline.stages.size() == 1 && pipeline.timing == PipelineTiming::None && !pipeline.background;
+    const Command *stage = lone ? &pipeline.stages.front() : nullptr;
+    const auto builtin = stage != nullptr ? builtin_registry_.find(stage->name) : std::nullopt;
+
+    if (builtin.has_value() && builtin->runs_in_process(stage->args) && stage->redirections.empty() &&
+        stage->assignments.empty()) {
+        const TraceSpan span("builtin", stage->name);
+        StringOutputStream out(output);
+        const int status = builtin_registry_.execute(*builtin, stage->args, out, std::cerr);
+        parameters_.set_last_status(status);
+        parameters_.set_pipe_status(std::array{status});
+        return;
+    }
+
+    std::array<int, 2> fds{};
+    if (pipe2(fds.data(), O_CLOEXEC) == -1) {
+        std::cerr << "shell: cannot capture output: " << std::strerror(errno) << std::endl;
+        parameters_.set_last_status(1);
+        return;
+    }
+
+    const bool changes_state = std::ranges::any_of(pipeline.stages, [this](const Command &command) {
+        if (command.name.empty()) {
+            return true;
+        }
+        const auto found = builtin_registry_.find(command.name);
+        return found.has_value() && !found->runs_in_process(command.args);
+    });
+    if (changes_state) {
+        std::cout.flush();
+        const pid_t pid = fork();
+        if (pid == -1) {
+            close(fds[0]);
+            close(fds[1]);
+            throw std::runtime_error("fork failed");
+        }
+
+        if (pid == 0) {
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            try {
+                execute_parsed(pipeline, command);
+            } catch (const std::exception &error) {
+                std::cerr << error.what() << std::endl;
+                child_exit(1);
+            }
+            child_exit(parameters_.last_status());
+        }
+
+        close(fds[1]);
+        read_to_end(fds[0], output);
+        close(fds[0]);
+
+        std::array<ChildExit, 1> exits{};
+        reap_children(std::span(&pid, 1), exits);
+        parameters_.set_last_status(exits[0].status);
+        parameters_.set_pipe_status(std::array{exits[0].status});
+        return;
+    }
+
+    std::cout.flush();
+    const int saved_stdout = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+    if (saved_stdout == -1) {
+        std::cerr << "shell: cannot capture output: " << std::strerror(errno) << std::endl;
+        close(fds[0]);
+        close(fds[1]);
+        parameters_.set_last_status(1);
+        return;
+    }
+    dup2(fds[1], STDOUT_FILENO);
+    close(fds[1]);
+    auto reader = std::async(std::launch::async, [fd = fds[0], &output] {
+        read_to_end(fd, output);
+        close(fd);
+    });
+
+    // The reader only sees end of file once the shell's copy of the pipe is
+    // gone too, so stdout comes back before waiting for it, even on error.
+    const auto restore_stdout = [saved_stdout] {
+        std::cout.flush();
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    };
+    try {
+        execute_parsed(pipeline, command);
+    } catch (...) {
+        restore_stdout();
+        reader.get();
+        throw;
+    }
+    restore_stdout();
+    reader.get();
 }
 
 } // namespace shell
@@ -1,29 +1,78 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "app/shell_parameters.hpp"
 #include "builtins/builtin_registry.hpp"
+#include "core/line_arena.hpp"
 #include "core/parser.hpp"
 #include "core/path_resolver.hpp"
-#include "core/tokenizer.hpp"
+#include "execution/here_document.hpp"
 #include "execution/process_executor.hpp"
 #include "history/history_manager.hpp"
 #include "line_editing/completion.hpp"
 
 namespace shell {
 
+class ScriptSource;
+
 class ShellApp {
   public:
     ShellApp();
 
-    int run();
+    // `args` are the command-line arguments after the program name:
+    // `-c COMMANDS`, a script path, or nothing. Without arguments the shell
+    // is interactive when stdin is a terminal and reads a script from stdin
+    // otherwise.
+    int run(std::span<const char *const> args = {});
 
   private:
     PathResolver path_resolver_;
     HistoryManager history_manager_;
     BuiltinRegistry builtin_registry_;
     CompletionEngine completion_engine_;
-    Tokenizer tokenizer_;
+    LineArena line_arena_;
     Parser parser_;
     ProcessExecutor process_executor_;
+    ShellParameters parameters_;
+    bool interactive_{false};
+    // Where the lines after the current one come from: the running script,
+    // or readline when interactive.
+    ScriptSource *script_{nullptr};
+    // A line with here-documents, copied before their bodies are read from
+    // the same source, plus what that reading needs.
+    std::string held_line_;
+    std::string continuation_line_;
+    LineArena here_arena_;
+    std::vector<HereDocument> here_documents_;
+    // What a command substitution is parsed into and its output captured in,
+    // one per level of nesting, kept from one substitution to the next.
+    struct Substitution {
+        LineArena arena;
+        std::string output;
+    };
+    std::vector<std::unique_ptr<Substitution>> substitutions_;
+    std::size_t substitution_depth_{0};
+
+    void configure_spawn_backend();
+    void configure_pipeline_timeout();
+    void configure_autosplit_jobs();
+    int run_interactive();
+    int run_script(ScriptSource &source);
+    void execute_line(std::string_view input);
+    void execute_parsed(const Pipeline &pipeline, std::string_view input);
+    [[nodiscard]] bool read_here_documents(Pipeline &pipeline);
+    void read_here_document(const Redirection &redirection, HereDocument &body);
+    [[nodiscard]] std::optional<std::string_view> next_continuation_line();
+    void run_pipeline(const Pipeline &pipeline, PipelineTimes *times);
+    void start_background(const Pipeline &pipeline, std::string_view input);
+    [[nodiscard]] std::optional<std::string_view> substitute_command(std::string_view command);
+    void capture_output(const Pipeline &pipeline, std::string_view command, std::string &output);
 };
 
 } // namespace shell
@@ -0,0 +1,56 @@
+#include "app/shell_parameters.hpp"
+
+#include <charconv>
+#include <string>
+#include <utility>
+
+#include "core/variable_store.hpp"
+
+namespace shell {
+
+ShellParameters::ShellParameters(const VariableStore &variables) noexcept : variables_(variables) {}
+
+int ShellParameters::last_status() const noexcept { return last_status_; }
+
+void ShellParameters::set_last_status(int status) noexcept { last_status_ = status; }
+
+void ShellParameters::set_last_background_pid(pid_t pid) noexcept { last_background_pid_ = pid; }
+
+void ShellParameters::set_pipe_status(std::span<const int> statuses) {
+    pipe_status_.clear();
+    for (const int status : statuses) {
+        if (!pipe_status_.empty()) {
+            pipe_status_ += ' ';
+        }
+        pipe_status_ += format(status);
+    }
+}
+
+void ShellParameters::set_command_runner(CommandRunner runner) { command_runner_ = std::move(runner); }
+
+std::optional<std::string_view> ShellParameters::parameter(std::string_view name) const {
+    if (name == "?") {
+        return format(last_status_);
+    }
+
+    if (name == "!") {
+        return last_background_pid_.has_value() ? std::optional(format(*last_background_pid_)) : std::nullopt;
+    }
+
+    if (name == "PIPESTATUS") {
+        return pipe_status_;
+    }
+
+    return variables_.get(name);
+}
+
+std::optional<std::string_view> ShellParameters::command_output(std::string_view command) const {
+    return command_runner_ ? command_runner_(command) : std::nullopt;
+}
+
+std::string_view ShellParameters::format(long value) const noexcept {
+    const auto result = std::to_chars(digits_.data(), digits_.data() + digits_.size(), value);
+    return {digits_.data(), result.ptr};
+}
+
+} // namespace shell
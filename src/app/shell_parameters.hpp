@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+
+#include "core/parameters.hpp"
+
+namespace shell {
+
+class VariableStore;
+
+// The shell's special parameters `$?` and `$!`, PIPESTATUS, and the shell's
+// variables for any other name. Command substitutions are handed to the
+// runner the shell installs.
+class ShellParameters final : public ParameterSource {
+  public:
+    explicit ShellParameters(const VariableStore &variables) noexcept;
+
+    [[nodiscard]] int last_status() const noexcept;
+    void set_last_status(int status) noexcept;
+    void set_last_background_pid(pid_t pid) noexcept;
+    // Statuses of the stages of the last foreground pipeline, expanded by
+    // `$PIPESTATUS` as a space-separated list.
+    void set_pipe_status(std::span<const int> statuses);
+
+    using CommandRunner = std::function<std::optional<std::string_view>(std::string_view command)>;
+    void set_command_runner(CommandRunner runner);
+
+    [[nodiscard]] std::optional<std::string_view> parameter(std::string_view name) const override;
+    [[nodiscard]] std::optional<std::string_view> command_output(std::string_view command) const override;
+
+  private:
+    const VariableStore &variables_;
+    CommandRunner command_runner_;
+    int last_status_{0};
+    std::optional<pid_t> last_background_pid_;
+    std::string pipe_status_{"0"};
+    // Values are formatted on demand into this buffer.
+    mutable std::array<char, 24> digits_{};
+
+    [[nodiscard]] std::string_view format(long value) const noexcept;
+};
+
+} // namespace shell
@@ -1,13 +1,20 @@
 #include "builtins/builtin_registry.hpp"
 
+#include <array>
 #include <charconv>
-#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <format>
 #include <iostream>
+#include <iterator>
+#include <optional>
 #include <string>
 #include <system_error>
+#include <utility>
 
 #include <readline/history.h>
+#include <unistd.h>
 
 #include "core/path_resolver.hpp"
 #include "history/history_manager.hpp"
@@ -16,30 +23,221 @@ namespace shell {
 
 namespace fs = std::filesystem;
 
+namespace {
+
+bool always_in_process(std::span<const std::string_view> /*args*/) noexcept { return true; }
+
+bool never_in_process(std::span<const std::string_view> /*args*/) noexcept { return false; }
+
+// Listing is harmless; -r/-w/-a change the history list or files.
+bool history_runs_in_process(std::span<const std::string_view> args) noexcept {
+    return args.empty() || !args[0].starts_with('-');
+}
+
+// Listing and -t only read the hash table.
+bool hash_runs_in_process(std::span<const std::string_view> args) noexcept {
+    return args.empty() || args[0] == "-t";
+}
+
+// Only the listings leave the options alone.
+bool set_runs_in_process(std::span<const std::string_view> args) noexcept {
+    return args.empty() || (args.size() == 1 && (args[0] == "-o" || args[0] == "+o"));
+}
+
+// Only the listing leaves the variables alone.
+bool export_runs_in_process(std::span<const std::string_view> args) noexcept {
+    return args.empty() || (args.size() == 1 && args[0] == "-p");
+}
+
+// Single-quotes a value for `export -p`, so the listing can be read back in.
+[[nodiscard]] std::string quote_value(std::string_view value) {
+    std::string quoted = "'";
+    for (const char c : value) {
+        if (c == '\'') {
+            quoted += "'\\''";
+        } else {
+            quoted += c;
+        }
+    }
+    quoted += '\'';
+    return quoted;
+}
+
+struct OptionName {
+    std::string_view name;
+    bool ShellOptions::*flag;
+};
+
+constexpr std::array option_names{
+    OptionName{"autosplit", &ShellOptions::autosplit},
+    OptionName{"pipefail", &ShellOptions::pipefail},
+};
+
+[[nodiscard]] const OptionName *find_option(std::string_view name) noexcept {
+    for (const auto &option : option_names) {
+        if (option.name == name) {
+            return &option;
+        }
+    }
+
+    return nullptr;
+}
+
+// The compiled-in builtins are looked up through a perfect hash: FNV-1a with a
+// seed searched at compile time so that every name lands in its own slot of a
+// power-of-two table. A lookup is one hash, one mask and one string compare.
+constexpr std::size_t perfect_hash_slots = 16;
+
+[[nodiscard]] constexpr std::uint32_t perfect_hash(std::string_view name, std::uint32_t seed) noexcept {
+    std::uint32_t hash = 2166136261U ^ seed;
+    for (const char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619U;
+    }
+
+    // The low bits of FNV-1a depend only on the low bits of the input and the
+    // seed; folding in the high half lets the seed reach every slot.
+    return hash ^ (hash >> 16);
+}
+
+template <typename Entry, std::size_t N>
+[[nodiscard]] constexpr std::optional<std::uint32_t> find_perfect_hash_seed(const std::array<Entry, N> &entries) {
+    static_assert(N <= perfect_hash_slots);
+
+    for (std::uint32_t seed = 0; seed < 100000; ++seed) {
+        std::array<bool, perfect_hash_slots> used{};
+        bool collision = false;
+
+        for (const auto &entry : entries) {
+            const std::size_t slot = perfect_hash(entry.name, seed) % perfect_hash_slots;
+            if (used[slot]) {
+                collision = true;
+                break;
+            }
+            used[slot] = true;
+        }
+
+        if (!collision) {
+            return seed;
+        }
+    }
+
+    return std::nullopt;
+}
+
+} // namespace
+
 BuiltinRegistry::BuiltinRegistry(PathResolver &path_resolver, HistoryManager &history_manager)
-    : path_resolver_(path_resolver), history_manager_(history_manager) {
-    register_builtins();
+    : path_resolver_(path_resolver), history_manager_(history_manager), variables_(environ) {}
+
+struct BuiltinRegistry::StaticTable {
+    static constexpr std::array<StaticBuiltin, 12> builtins{{
+        {"cd", &BuiltinRegistry::builtin_cd, never_in_process},
+        {"echo", &BuiltinRegistry::builtin_echo, always_in_process},
+        {"exit", &BuiltinRegistry::builtin_exit, never_in_process},
+        {"export", &BuiltinRegistry::builtin_export, export_runs_in_process},
+        {"hash", &BuiltinRegistry::builtin_hash, hash_runs_in_process},
+        {"history", &BuiltinRegistry::builtin_history, history_runs_in_process},
+        {"jobs", &BuiltinRegistry::builtin_jobs, always_in_process},
+        {"pwd", &BuiltinRegistry::builtin_pwd, always_in_process},
+        {"set", &BuiltinRegistry::builtin_set, set_runs_in_process},
+        {"type", &BuiltinRegistry::builtin_type, always_in_process},
+        {"unset", &BuiltinRegistry::builtin_unset, never_in_process},
+        {"wait", &BuiltinRegistry::builtin_wait, never_in_process},
+    }};
+
+    static constexpr std::optional<std::uint32_t> found_seed = find_perfect_hash_seed(builtins);
+    static_assert(found_seed.has_value(), "no perfect hash seed fits the builtin table; raise perfect_hash_slots");
+    static constexpr std::uint32_t seed = *found_seed;
+
+    static constexpr std::array<const StaticBuiltin *, perfect_hash_slots> slots = [] {
+        std::array<const StaticBuiltin *, perfect_hash_slots> table{};
+        for (const auto &entry : builtins) {
+            table[perfect_hash(entry.name, seed) % perfect_hash_slots] = &entry;
+        }
+        return table;
+    }();
+};
+
+std::optional<BuiltinRegistry::Builtin> BuiltinRegistry::find_static(std::string_view command) noexcept {
+    const StaticBuiltin *entry = StaticTable::slots[perfect_hash(command, StaticTable::seed) % perfect_hash_slots];
+    if (entry == nullptr || entry->name != command) {
+        return std::nullopt;
+    }
+
+    Builtin builtin;
+    builtin.name_ = entry->name;
+    builtin.handler_ = entry->handler;
+    builtin.runs_in_process_ = entry->runs_in_process;
+    return builtin;
 }
 
-bool BuiltinRegistry::is_builtin(std::string_view command) const {
-    return registry_.contains(std::string(command));
+std::optional<BuiltinRegistry::Builtin> BuiltinRegistry::find(std::string_view command) const noexcept {
+    if (auto builtin = find_static(command); builtin.has_value() || extensions_.empty()) {
+        return builtin;
+    }
+
+    const auto it = extensions_.find(command);
+    if (it == extensions_.end()) {
+        return std::nullopt;
+    }
+
+    Builtin builtin;
+    builtin.name_ = it->first;
+    builtin.extension_ = &it->second.func;
+    builtin.runs_in_process_ = it->second.runs_in_process ? always_in_process : never_in_process;
+    return builtin;
+}
+
+bool BuiltinRegistry::is_builtin(std::string_view command) const noexcept { return find(command).has_value(); }
+
+bool BuiltinRegistry::runs_in_process(std::string_view command, std::span<const std::string_view> args) const noexcept {
+    const auto builtin = find(command);
+    return builtin.has_value() && builtin->runs_in_process(args);
+}
+
+int BuiltinRegistry::execute(
+    const Builtin &builtin, std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
+    if (builtin.extension_ != nullptr) {
+        return (*builtin.extension_)(args, out, err);
+    }
+
+    return (this->*builtin.handler_)(args, out, err);
 }
 
 int BuiltinRegistry::execute(
-    std::string_view command, const std::vector<std::string> &args, std::ostream &out, std::ostream &err) {
-    auto it = registry_.find(std::string(command));
-    if (it == registry_.end()) {
+    std::string_view command, std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
+    const auto builtin = find(command);
+    if (!builtin.has_value()) {
         return 1;
     }
 
-    return it->second(args, out, err);
+    return execute(*builtin, args, out, err);
+}
+
+int BuiltinRegistry::execute(
+    std::string_view command, std::initializer_list<std::string_view> args, std::ostream &out, std::ostream &err) {
+    return execute(command, std::span<const std::string_view>(args.begin(), args.size()), out, err);
+}
+
+bool BuiltinRegistry::register_builtin(std::string name, BuiltinFunc func, bool runs_in_process) {
+    if (find_static(name).has_value()) {
+        return false;
+    }
+
+    return extensions_.try_emplace(std::move(name), Extension{.func = std::move(func), .runs_in_process = runs_in_process})
+        .second;
 }
 
 std::unordered_set<std::string> BuiltinRegistry::names() const {
     std::unordered_set<std::string> result;
-    result.reserve(registry_.size());
+    result.reserve(StaticTable::builtins.size() + extensions_.size());
 
-    for (const auto &[name, _] : registry_) {
+    for (const auto &builtin : StaticTable::builtins) {
+        result.emplace(builtin.name);
+    }
+
+    for (const auto &[name, _] : extensions_) {
         result.insert(name);
     }
 
@@ -48,35 +246,35 @@ std::unordered_set<std::string> BuiltinRegistry::names() const {
 
 bool BuiltinRegistry::exit_requested() const noexcept { return exit_requested_; }
 
-void BuiltinRegistry::register_builtins() {
-    registry_["cd"] = [this](const auto &args, auto &out, auto &err) { return builtin_cd(args, out, err); };
-    registry_["echo"] = [this](const auto &args, auto &out, auto &err) { return builtin_echo(args, out, err); };
-    registry_["pwd"] = [this](const auto &args, auto &out, auto &err) { return builtin_pwd(args, out, err); };
-    registry_["type"] = [this](const auto &args, auto &out, auto &err) { return builtin_type(args, out, err); };
-    registry_["history"] = [this](const auto &args, auto &out, auto &err) { return builtin_history(args, out, err); };
-    registry_["exit"] = [this](const auto &args, auto &out, auto &err) { return builtin_exit(args, out, err); };
-}
+JobTable &BuiltinRegistry::jobs() noexcept { return job_table_; }
 
-int BuiltinRegistry::builtin_cd(const std::vector<std::string> &args, std::ostream &out, std::ostream & /*err*/) {
+ShellOptions &BuiltinRegistry::options() noexcept { return options_; }
+
+const ShellOptions &BuiltinRegistry::options() const noexcept { return options_; }
+
+VariableStore &BuiltinRegistry::variables() noexcept { return variables_; }
+
+const VariableStore &BuiltinRegistry::variables() const noexcept { return variables_; }
+
+int BuiltinRegistry::builtin_cd(std::span<const std::string_view> args, std::ostream &out, std::ostream & /*err*/) {
     fs::path target_path(args.empty() ? "~" : args.front());
     if (target_path == "~") {
-        const char *home = std::getenv("HOME");
-        if (home != nullptr) {
-            target_path = home;
+        if (const auto home = variables_.get("HOME"); home.has_value()) {
+            target_path = *home;
         }
     }
 
     std::error_code ec;
     fs::current_path(target_path, ec);
     if (ec) {
-        out << "cd: " << target_path.string() << ": No such file or directory" << std::endl;
+        out << "cd: " << target_path.string() << ": No such file or directory" << '\n';
         return 1;
     }
 
     return 0;
 }
 
-int BuiltinRegistry::builtin_echo(const std::vector<std::string> &args, std::ostream &out, std::ostream & /*err*/) {
+int BuiltinRegistry::builtin_echo(std::span<const std::string_view> args, std::ostream &out, std::ostream & /*err*/) {
     for (std::size_t i = 0; i < args.size(); ++i) {
         if (i > 0) {
             out << ' ';
@@ -85,77 +283,77 @@ int BuiltinRegistry::builtin_echo(const std::vector<std::string> &args, std::ost
         out << args[i];
     }
 
-    out << std::endl;
+    out << '\n';
     return 0;
 }
 
-int BuiltinRegistry::builtin_pwd(const std::vector<std::string> & /*args*/, std::ostream &out, std::ostream & /*err*/) {
-    out << fs::current_path().string() << std::endl;
+int BuiltinRegistry::builtin_pwd(std::span<const std::string_view> /*args*/, std::ostream &out, std::ostream & /*err*/) {
+    out << fs::current_path().string() << '\n';
     return 0;
 }
 
-int BuiltinRegistry::builtin_type(const std::vector<std::string> &args, std::ostream &out, std::ostream &err) {
+int BuiltinRegistry::builtin_type(std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
     if (args.empty()) {
-        err << "type: missing argument" << std::endl;
+        err << "type: missing argument" << '\n';
         return 1;
     }
 
-    const auto &name = args.front();
+    const std::string_view name = args.front();
     if (is_builtin(name)) {
-        out << name << " is a shell builtin" << std::endl;
+        out << name << " is a shell builtin" << '\n';
         return 0;
     }
 
     const auto file_path = path_resolver_.find_command_path(name);
     if (!file_path.empty()) {
-        out << name << " is " << file_path << std::endl;
+        out << name << " is " << file_path << '\n';
         return 0;
     }
 
-    out << name << ": not found" << std::endl;
+    out << name << ": not found" << '\n';
     return 1;
 }
 
-int BuiltinRegistry::builtin_history(const std::vector<std::string> &args, std::ostream &out, std::ostream &err) {
+int BuiltinRegistry::builtin_history(std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
     if (!args.empty() && args[0] == "-r") {
         if (args.size() < 2) {
-            err << "history: -r requires a file argument" << std::endl;
+            err << "history: -r requires a file argument" << '\n';
             return 1;
         }
 
-        history_manager_.read_from_file(args[1]);
+        history_manager_.read_from_file(std::string(args[1]));
         return 0;
     }
 
     if (!args.empty() && args[0] == "-w") {
         if (args.size() < 2) {
-            err << "history: -w requires a file argument" << std::endl;
+            err << "history: -w requires a file argument" << '\n';
             return 1;
         }
 
-        history_manager_.write_to_file(args[1]);
+        history_manager_.write_to_file(std::string(args[1]));
         return 0;
     }
 
     if (!args.empty() && args[0] == "-a") {
         if (args.size() < 2) {
-            err << "history: -a requires a file argument" << std::endl;
+            err << "history: -a requires a file argument" << '\n';
             return 1;
         }
 
-        history_manager_.append_session_to_file(args[1]);
+        history_manager_.append_session_to_file(std::string(args[1]));
         return 0;
     }
 
     int limit = history_length;
     if (!args.empty()) {
-        const auto &token = args[0];
+        const std::string_view token = args[0];
         const char *first = token.data();
         const char *last = token.data() + token.size();
         auto [ptr, ec] = std::from_chars(first, last, limit);
 
         if (ec != std::errc{} || ptr != last || limit < 0) {
-            err << "history: invalid numeric argument" << std::endl;
+            err << "history: invalid numeric argument" << '\n';
             return 1;
         }
     }
@@ -164,7 +362,7 @@ int BuiltinRegistry::builtin_history(const std::vector<std::string> &args, std::
     return 0;
 }
 
-int BuiltinRegistry::builtin_exit(const std::vector<std::string> &args, std::ostream & /*out*/, std::ostream & /*err*/) {
+int BuiltinRegistry::builtin_exit(std::span<const std::string_view> args, std::ostream & /*out*/, std::ostream & /*err*/) {
     if (args.empty() || args[0] == "0") {
         exit_requested_ = true;
     }
@@ -172,4 +370,259 @@ int BuiltinRegistry::builtin_exit(const std::vector<std::string> &args, std::ost
     return 0;
 }
 
+int BuiltinRegistry::builtin_hash(std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
+    if (args.empty()) {
+        const auto commands = path_resolver_.cached_commands();
+        if (commands.empty()) {
+            out << "hash: hash table empty" << '\n';
+            return 0;
+        }
+
+        out << "hits\tcommand\n";
+        for (const auto &command : commands) {
+            std::format_to(std::ostreambuf_iterator<char>(out), "{:>4}\t{}\n", command.hits, command.path);
+        }
+        return 0;
+    }
+
+    const std::string_view option = args[0];
+
+    if (option == "-r") {
+        path_resolver_.clear_command_cache();
+        return 0;
+    }
+
+    if (option == "-p") {
+        if (args.size() < 3) {
+            err << "hash: -p requires a path and a name" << '\n';
+            return 1;
+        }
+
+        path_resolver_.remember_command(args[2], std::string(args[1]));
+        return 0;
+    }
+
+    if (option == "-d" || option == "-t") {
+        if (args.size() < 2) {
+            err << "hash: " << option << " requires a name argument" << '\n';
+            return 1;
+        }
+
+        int status = 0;
+        for (std::size_t i = 1; i < args.size(); ++i) {
+            const std::string_view name = args[i];
+
+            if (option == "-d") {
+                if (!path_resolver_.forget_command(name)) {
+                    err << "hash: " << name << ": not found" << '\n';
+                    status = 1;
+                }
+                continue;
+            }
+
+            const auto path = path_resolver_.cached_command_path(name);
+            if (!path.has_value()) {
+                err << "hash: " << name << ": not found" << '\n';
+                status = 1;
+            } else if (args.size() > 2) {
+                out << name << '\t' << *path << '\n';
+            } else {
+                out << *path << '\n';
+            }
+        }
+
+        return status;
+    }
+
+    int status = 0;
+    for (const std::string_view name : args) {
+        if (is_builtin(name)) {
+            continue;
+        }
+
+        if (path_resolver_.find_command_path(name).empty()) {
+            err << "hash: " << name << ": not found" << '\n';
+            status = 1;
+        }
+    }
+
+    return status;
+}
+
+// `set -o NAME` turns an option on and `set +o NAME` off. `set -o` (or plain
+// `set`) lists the options, `set +o` prints the commands that restore them.
+int BuiltinRegistry::builtin_set(std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
+    if (args.empty() || (args.size() == 1 && args[0] == "-o")) {
+        for (const auto &option : option_names) {
+            std::format_to(std::ostreambuf_iterator<char>(out),
+                           "{:<15}\t{}\n",
+                           option.name,
+                           options_.*option.flag ? "on" : "off");
+        }
+        return 0;
+    }
+
+    if (args.size() == 1 && args[0] == "+o") {
+        for (const auto &option : option_names) {
+            out << "set " << (options_.*option.flag ? '-' : '+') << "o " << option.name << '\n';
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        const std::string_view flag = args[i];
+        if (flag != "-o" && flag != "+o") {
+            err << "set: " << flag << ": invalid option" << '\n';
+            return 2;
+        }
+
+        if (i + 1 == args.size()) {
+            err << "set: " << flag << ": option name required" << '\n';
+            return 2;
+        }
+
+        const std::string_view name = args[++i];
+        const OptionName *option = find_option(name);
+        if (option == nullptr) {
+            err << "set: " << name << ": invalid option name" << '\n';
+            status = 1;
+            continue;
+        }
+
+        options_.*option->flag = flag == "-o";
+    }
+
+    return status;
+}
+
+int BuiltinRegistry::builtin_jobs(std::span<const std::string_view> /*args*/, std::ostream &out, std::ostream & /*err*/) {
+    job_table_.reap();
+    job_table_.print(out);
+    return 0;
+}
+
+// `wait` with no operands waits for every job and succeeds; otherwise the
+// status is that of the last operand: `%N` names a job, anything else a pid.
+int BuiltinRegistry::builtin_wait(std::span<const std::string_view> args, std::ostream & /*out*/, std::ostream &err) {
+    if (args.empty()) {
+        job_table_.wait_all();
+        return 0;
+    }
+
+    int status = 0;
+    for (const std::string_view operand : args) {
+        const bool is_job = operand.starts_with('%');
+        const std::string_view digits = is_job ? operand.substr(1) : operand;
+        int number = 0;
+        const auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), number);
+        if (ec != std::errc{} || ptr != digits.data() + digits.size() || number <= 0) {
+            err << "wait: `" << operand << "': not a pid or valid job spec" << '\n';
+            status = 1;
+            continue;
+        }
+
+        const auto result = is_job ? job_table_.wait_job(number) : job_table_.wait_pid(number);
+        if (result.has_value()) {
+            status = *result;
+        } else if (is_job) {
+            err << "wait: " << operand << ": no such job" << '\n';
+            status = 127;
+        } else {
+            err << "wait: pid " << operand << " is not a child of this shell" << '\n';
+            status = 127;
+        }
+    }
+
+    return status;
+}
+
+// `export NAME=value` assigns and exports, `export NAME` exports what is
+// already there and `-n` takes the export away. With no names, or with -p, it
+// lists the exported variables as commands that recreate them.
+int BuiltinRegistry::builtin_export(std::span<const std::string_view> args, std::ostream &out, std::ostream &err) {
+    bool exported = true;
+    std::size_t first = 0;
+    for (; first < args.size() && args[first].starts_with('-'); ++first) {
+        if (args[first] == "--") {
+            ++first;
+            break;
+        }
+
+        if (args[first] == "-n") {
+            exported = false;
+        } else if (args[first] != "-p") {
+            err << "export: " << args[first] << ": invalid option" << '\n';
+            return 2;
+        }
+    }
+
+    if (first == args.size()) {
+        for (const auto &variable : variables_.variables()) {
+            if (!variable.exported) {
+                continue;
+            }
+
+            out << "export " << variable.name;
+            if (variable.value.has_value()) {
+                out << '=' << quote_value(*variable.value);
+            }
+            out << '\n';
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (const std::string_view operand : args.subspan(first)) {
+        const std::size_t separator = operand.find('=');
+        const std::string_view name = operand.substr(0, separator);
+        if (!VariableStore::valid_name(name)) {
+            err << "export: `" << operand << "': not a valid identifier" << '\n';
+            status = 1;
+            continue;
+        }
+
+        if (separator != std::string_view::npos) {
+            variables_.set(name, operand.substr(separator + 1));
+        }
+        variables_.set_exported(name, exported);
+    }
+
+    return status;
+}
+
+// There are no shell functions, so `-f` finds nothing to remove.
+int BuiltinRegistry::builtin_unset(std::span<const std::string_view> args, std::ostream & /*out*/, std::ostream &err) {
+    bool functions = false;
+    std::size_t first = 0;
+    for (; first < args.size() && args[first].starts_with('-'); ++first) {
+        if (args[first] == "--") {
+            ++first;
+            break;
+        }
+
+        if (args[first] == "-f") {
+            functions = true;
+        } else if (args[first] != "-v") {
+            err << "unset: " << args[first] << ": invalid option" << '\n';
+            return 2;
+        }
+    }
+
+    int status = 0;
+    for (const std::string_view name : args.subspan(first)) {
+        if (!VariableStore::valid_name(name)) {
+            err << "unset: `" << name << "': not a valid identifier" << '\n';
+            status = 1;
+            continue;
+        }
+
+        if (!functions) {
+            variables_.unset(name);
+        }
+    }
+
+    return status;
+}
+
 } // namespace shell
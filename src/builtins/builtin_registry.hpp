@@ -1,12 +1,18 @@
 #pragma once
 
 #include <functional>
+#include <initializer_list>
 #include <iosfwd>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <unordered_set>
-#include <vector>
+
+#include "builtins/shell_options.hpp"
+#include "core/variable_store.hpp"
+#include "execution/job_table.hpp"
 
 namespace shell {
 
@@ -15,30 +21,107 @@ class PathResolver;
 
 class BuiltinRegistry {
   public:
-    using BuiltinFunc = std::function<int(const std::vector<std::string> &, std::ostream &, std::ostream &)>;
+    using BuiltinFunc = std::function<int(std::span<const std::string_view>, std::ostream &, std::ostream &)>;
+    using Handler = int (BuiltinRegistry::*)(std::span<const std::string_view>, std::ostream &, std::ostream &);
+    using InProcessCheck = bool (*)(std::span<const std::string_view>) noexcept;
+
+    // A resolved builtin. find() hands it out and execute() takes it back, so
+    // checking for a builtin and running it costs one lookup.
+    class Builtin {
+      public:
+        [[nodiscard]] std::string_view name() const noexcept { return name_; }
+
+        // Whether a pipeline stage running this builtin may execute inside the
+        // shell process: it must leave no shell state behind that a forked
+        // stage would have discarded (cwd, exit, history list, hash table,
+        // variables).
+        [[nodiscard]] bool runs_in_process(std::span<const std::string_view> args) const noexcept {
+            return runs_in_process_(args);
+        }
+
+      private:
+        friend class BuiltinRegistry;
+
+        std::string_view name_;
+        Handler handler_{nullptr};
+        const BuiltinFunc *extension_{nullptr};
+        InProcessCheck runs_in_process_{nullptr};
+    };
 
     BuiltinRegistry(PathResolver &path_resolver, HistoryManager &history_manager);
 
-    [[nodiscard]] bool is_builtin(std::string_view command) const;
-    int execute(std::string_view command, const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
+    [[nodiscard]] std::optional<Builtin> find(std::string_view command) const noexcept;
+    [[nodiscard]] bool is_builtin(std::string_view command) const noexcept;
+    [[nodiscard]] bool runs_in_process(std::string_view command, std::span<const std::string_view> args) const noexcept;
+
+    int execute(const Builtin &builtin, std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int execute(std::string_view command, std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int execute(
+        std::string_view command, std::initializer_list<std::string_view> args, std::ostream &out, std::ostream &err);
+
+    // Runtime extension point on top of the compiled-in table. Returns false if
+    // the name is already taken. Extensions fork in pipelines unless they
+    // declare that they leave no shell state behind.
+    bool register_builtin(std::string name, BuiltinFunc func, bool runs_in_process = false);
 
     [[nodiscard]] std::unordered_set<std::string> names() const;
     [[nodiscard]] bool exit_requested() const noexcept;
 
+    // Background jobs, for `jobs` and `wait` and for the shell to add to.
+    [[nodiscard]] JobTable &jobs() noexcept;
+
+    [[nodiscard]] ShellOptions &options() noexcept;
+    [[nodiscard]] const ShellOptions &options() const noexcept;
+
+    // Shell variables, imported from the environment; the exported ones make
+    // up the environment of every command the shell runs.
+    [[nodiscard]] VariableStore &variables() noexcept;
+    [[nodiscard]] const VariableStore &variables() const noexcept;
+
   private:
+    struct StaticBuiltin {
+        std::string_view name;
+        Handler handler;
+        InProcessCheck runs_in_process;
+    };
+
+    struct StaticTable;
+
+    struct Extension {
+        BuiltinFunc func;
+        bool runs_in_process;
+    };
+
+    struct StringHash {
+        using is_transparent = void;
+
+        [[nodiscard]] std::size_t operator()(std::string_view value) const noexcept {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
     PathResolver &path_resolver_;
     HistoryManager &history_manager_;
     bool exit_requested_{false};
-    std::unordered_map<std::string, BuiltinFunc> registry_;
+    JobTable job_table_;
+    ShellOptions options_;
+    VariableStore variables_;
+    std::unordered_map<std::string, Extension, StringHash, std::equal_to<>> extensions_;
 
-    void register_builtins();
+    [[nodiscard]] static std::optional<Builtin> find_static(std::string_view command) noexcept;
 
-    int builtin_cd(const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
-    int builtin_echo(const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
-    int builtin_pwd(const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
-    int builtin_type(const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
-    int builtin_history(const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
-    int builtin_exit(const std::vector<std::string> &args, std::ostream &out, std::ostream &err);
+    int builtin_cd(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_echo(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_pwd(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_type(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_history(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_exit(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_hash(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_set(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_jobs(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_wait(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_export(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
+    int builtin_unset(std::span<const std::string_view> args, std::ostream &out, std::ostream &err);
 };
 
 } // namespace shell
@@ -0,0 +1,16 @@
+#pragma once
+
+namespace shell {
+
+// Options changed with `set -o NAME` and `set +o NAME`.
+struct ShellOptions {
+    // A pipeline's status is that of the last stage to fail, not of the last
+    // stage.
+    bool pipefail{false};
+    // An external command whose arguments exceed ARG_MAX runs as several
+    // commands, each with as many of them as fit, instead of failing with
+    // E2BIG.
+    bool autosplit{false};
+};
+
+} // namespace shell
@@ -1,30 +1,71 @@
 #pragma once
 
-#include <string>
+#include <memory_resource>
+#include <string_view>
 #include <vector>
 
 namespace shell {
 
 enum class RedirectionOp {
+    StdinRead,
+    StdinDocument,
+    StdinString,
     StdoutTruncate,
     StdoutAppend,
     StderrTruncate,
     StderrAppend,
+    // `N>&M` and `N<&M`: the descriptor becomes a copy of source_fd.
+    Duplicate,
 };
 
+// Words are views into the line they were parsed from (or into the tokenizer's
+// LineArena) and must not outlive it. The containers are pmr so that the parser
+// can carve a whole pipeline out of the line's arena; they default to the heap.
 struct Redirection {
     RedirectionOp op;
-    std::string target;
+    // The file name; for a here-string its text, and for a here-document the
+    // line that ends its body.
+    std::string_view target;
+    // Here-documents only. A quoted delimiter leaves the body unexpanded and
+    // `<<-` strips leading tabs from its lines.
+    bool literal{false};
+    bool strip_tabs{false};
+    // An already open descriptor that takes target_fd's place: M for a
+    // duplication, or a here-document's body once it has been read. It is
+    // not owned by the redirection.
+    int source_fd{-1};
+    // The descriptor redirected, as in `3>`; -1 for the one `op` implies.
+    int target_fd{-1};
+};
+
+// `NAME=value`, on its own or before a command name, where it sets the
+// variable for that command only.
+struct Assignment {
+    std::string_view name;
+    std::string_view value;
 };
 
 struct Command {
-    std::string name;
-    std::vector<std::string> args;
-    std::vector<Redirection> redirections;
+    // Empty for a command made only of assignments.
+    std::string_view name;
+    std::pmr::vector<std::string_view> args;
+    std::pmr::vector<Redirection> redirections;
+    // Defaulted so that commands built without assignments need not name it.
+    std::pmr::vector<Assignment> assignments{};
+};
+
+// Set by a leading `time` keyword; `time -v` also reports every stage.
+enum class PipelineTiming {
+    None,
+    Total,
+    PerStage,
 };
 
 struct Pipeline {
-    std::vector<Command> stages;
+    std::pmr::vector<Command> stages;
+    PipelineTiming timing{PipelineTiming::None};
+    // Ended with `&`: started as a job without waiting for it.
+    bool background{false};
 
     [[nodiscard]] bool empty() const noexcept { return stages.empty(); }
 };
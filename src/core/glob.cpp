@@ -0,0 +1,309 @@
+#include "core/glob.hpp"
+
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shell {
+
+namespace {
+
+// Large enough that a directory of a few thousand entries comes back in one
+// getdents64 call.
+constexpr std::size_t dirent_buffer_size = 128 * 1024;
+
+// Past the `[` at `open`: the offset just after the closing `]`, or npos if
+// the bracket expression is not terminated (and the `[` is then literal).
+// `matched` tells whether `c` is in the set.
+[[nodiscard]] std::size_t match_bracket(std::string_view pattern, std::size_t open, char c, bool &matched) noexcept {
+    std::size_t i = open + 1;
+    const bool negated = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+    if (negated) {
+        ++i;
+    }
+
+    bool found = false;
+    // A `]` right after the opening bracket is a member, not the end.
+    for (bool first = true; i < pattern.size(); first = false) {
+        char low = pattern[i];
+        if (low == ']' && !first) {
+            matched = found != negated;
+            return i + 1;
+        }
+        if (low == '\\' && i + 1 < pattern.size()) {
+            low = pattern[++i];
+        }
+        ++i;
+
+        char high = low;
+        if (i + 1 < pattern.size() && pattern[i] == '-' && pattern[i + 1] != ']') {
+            high = pattern[i + 1];
+            i += 2;
+            if (high == '\\' && i < pattern.size()) {
+                high = pattern[i++];
+            }
+        }
+
+        const auto value = static_cast<unsigned char>(c);
+        if (static_cast<unsigned char>(low) <= value && value <= static_cast<unsigned char>(high)) {
+            found = true;
+        }
+    }
+
+    return std::string_view::npos;
+}
+
+// Appends `pattern` with its escapes removed.
+void append_literal(std::string &path, std::string_view pattern) {
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        if (pattern[i] == '\\' && i + 1 < pattern.size()) {
+            ++i;
+        }
+        path += pattern[i];
+    }
+}
+
+// Walks the pattern one component (directory level) at a time, reusing one
+// path buffer and one getdents64 buffer for the whole expansion.
+class GlobWalker {
+  public:
+    GlobWalker(std::span<const std::string_view> components, const std::function<void(std::string_view)> &emit)
+        : components_(components), emit_(emit) {}
+
+    std::size_t walk(std::string path) {
+        path_ = std::move(path);
+        level(0);
+        return matches_;
+    }
+
+  private:
+    std::span<const std::string_view> components_;
+    const std::function<void(std::string_view)> &emit_;
+    std::string path_;
+    std::unique_ptr<char[]> buffer_;
+    std::size_t matches_{0};
+
+    void found() {
+        emit_(path_);
+        ++matches_;
+    }
+
+    void level(std::size_t index) {
+        const std::string_view pattern = components_[index];
+        const bool last = index + 1 == components_.size();
+        const std::size_t mark = path_.size();
+
+        if (!glob_has_magic(pattern)) {
+            append_literal(path_, pattern);
+            if (!last) {
+                path_ += '/';
+                level(index + 1);
+            } else if (struct stat info{}; fstatat(AT_FDCWD, path_.c_str(), &info, AT_SYMLINK_NOFOLLOW) == 0) {
+                found();
+            }
+            path_.resize(mark);
+            return;
+        }
+
+        // Only directories lead anywhere below the last level. Symlinks and
+        // file systems that do not report a type are tried anyway; opening
+        // them as a directory is the check.
+        std::string candidates;
+        if (!scan_directory(pattern, last, candidates)) {
+            return;
+        }
+
+        for (std::size_t begin = 0; begin < candidates.size();) {
+            const std::size_t end = candidates.find('\0', begin);
+            path_.append(candidates, begin, end - begin);
+            path_ += '/';
+            level(index + 1);
+            path_.resize(mark);
+            begin = end + 1;
+        }
+    }
+
+    // Matches the entries of the directory named by path_ against `pattern`.
+    // On the last level every match is emitted as it is read; otherwise the
+    // names are collected, NUL-separated, so the directory is closed before
+    // the walk descends.
+    bool scan_directory(std::string_view pattern, bool last, std::string &candidates) {
+        const int fd = open(path_.empty() ? "." : path_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+
+        if (buffer_ == nullptr) {
+            buffer_ = std::make_unique_for_overwrite<char[]>(dirent_buffer_size);
+        }
+
+        const bool dot_allowed = pattern.starts_with('.') || pattern.starts_with("\\.");
+        const std::size_t mark = path_.size();
+        while (true) {
+            const ssize_t count = getdents64(fd, buffer_.get(), dirent_buffer_size);
+            if (count <= 0) {
+                break;
+            }
+
+            for (ssize_t offset = 0; offset < count;) {
+                const auto *entry = reinterpret_cast<const dirent64 *>(buffer_.get() + offset);
+                offset += entry->d_reclen;
+
+                const std::string_view name(entry->d_name);
+                if (name.starts_with('.') && (!dot_allowed || name == "." || name == "..")) {
+                    continue;
+                }
+                if (!last && entry->d_type != DT_DIR && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) {
+                    continue;
+                }
+                if (!glob_match(pattern, name)) {
+                    continue;
+                }
+
+                if (last) {
+                    path_ += name;
+                    found();
+                    path_.resize(mark);
+                } else {
+                    candidates += name;
+                    candidates += '\0';
+                }
+            }
+        }
+
+        close(fd);
+        return true;
+    }
+};
+
+} // namespace
+
+bool glob_has_magic(std::string_view pattern) noexcept {
+    for (std::size_t i = 0; i < pattern.size(); ++i) {
+        switch (pattern[i]) {
+        case '*':
+        case '?':
+            return true;
+        case '[': {
+            bool matched = false;
+            if (match_bracket(pattern, i, '\0', matched) != std::string_view::npos) {
+                return true;
+            }
+            break;
+        }
+        case '\\':
+            ++i;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+// Iterative matching with a single backtrack point: on a mismatch, the last
+// `*` swallows one more character. That is enough because a later `*` can
+// always absorb whatever an earlier one would have, so matching stays linear
+// in practice rather than exponential.
+bool glob_match(std::string_view pattern, std::string_view name) noexcept {
+    std::size_t p = 0;
+    std::size_t n = 0;
+    std::size_t star = std::string_view::npos;
+    std::size_t star_name = 0;
+
+    while (n < name.size()) {
+        bool advanced = false;
+        if (p < pattern.size()) {
+            char expected = pattern[p];
+            if (expected == '*') {
+                star = ++p;
+                star_name = n;
+                continue;
+            }
+
+            std::size_t next = p + 1;
+            bool matched = false;
+            if (expected == '?') {
+                matched = true;
+            } else if (expected == '[') {
+                const std::size_t end = match_bracket(pattern, p, name[n], matched);
+                if (end != std::string_view::npos) {
+                    next = end;
+                } else {
+                    matched = name[n] == '[';
+                }
+            } else {
+                if (expected == '\\' && p + 1 < pattern.size()) {
+                    expected = pattern[p + 1];
+                    next = p + 2;
+                }
+                matched = name[n] == expected;
+            }
+
+            if (matched) {
+                p = next;
+                ++n;
+                advanced = true;
+            }
+        }
+
+        if (!advanced) {
+            if (star == std::string_view::npos) {
+                return false;
+            }
+            p = star;
+            n = ++star_name;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+std::size_t glob_expand(std::string_view pattern, const std::function<void(std::string_view path)> &emit) {
+    std::string root;
+    if (pattern.starts_with('/')) {
+        root = "/";
+        const std::size_t first = pattern.find_first_not_of('/');
+        pattern.remove_prefix(first == std::string_view::npos ? pattern.size() : first);
+    }
+
+    // A trailing '/' leaves an empty last component, which only a directory
+    // satisfies.
+    std::vector<std::string_view> components;
+    bool magic = false;
+    while (!pattern.empty()) {
+        const std::size_t slash = pattern.find('/');
+        const std::string_view component = pattern.substr(0, slash);
+        if (!component.empty()) {
+            components.push_back(component);
+            magic = magic || glob_has_magic(component);
+        }
+        if (slash == std::string_view::npos) {
+            break;
+        }
+        pattern.remove_prefix(slash + 1);
+        if (pattern.empty()) {
+            components.emplace_back();
+        }
+    }
+
+    if (!magic) {
+        return 0;
+    }
+
+    GlobWalker walker(components, emit);
+    return walker.walk(std::move(root));
+}
+
+} // namespace shell
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+namespace shell {
+
+// Pathname expansion. Patterns use `*`, `?` and `[...]` (with `!` or `^` to
+// negate and `a-z` ranges); a backslash makes the next character literal.
+// Wildcards never match '/', nor a leading '.' unless the pattern spells it
+// out, and `.` and `..` are never matched.
+
+// Whether `pattern` has a wildcard that could match more than itself.
+[[nodiscard]] bool glob_has_magic(std::string_view pattern) noexcept;
+
+// Matches one path component against one pattern component.
+[[nodiscard]] bool glob_match(std::string_view pattern, std::string_view name) noexcept;
+
+// Calls `emit` with every existing path that matches `pattern`, in the order
+// the directories list them, and returns how many there were. Directories are
+// read with getdents64 and filtered on d_type, so no entry is stat()ed except
+// to confirm a literal last component; a pattern over several components only
+// descends into the directories its earlier components matched. The view
+// passed to `emit` is only valid during the call.
+std::size_t glob_expand(std::string_view pattern, const std::function<void(std::string_view path)> &emit);
+
+} // namespace shell
@@ -0,0 +1,267 @@
+#include "core/lexer_scan.hpp"
+
+#include <array>
+#include <bit>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SHELL_LEXER_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace shell {
+
+namespace {
+
+using ScanFunc = std::size_t (*)(const char *, std::size_t, std::size_t) noexcept;
+
+struct ScanKernelTable {
+    ScanKernel kind;
+    ScanFunc unquoted;
+    ScanFunc double_quoted;
+};
+
+constexpr std::array<bool, 256> unquoted_special_table = [] {
+    std::array<bool, 256> table{};
+    for (int c = 0; c < 256; ++c) {
+        table[static_cast<std::size_t>(c)] = is_lexer_space(static_cast<char>(c));
+    }
+
+    for (const unsigned char c : {'\'', '"', '`', '\\', '|', '>', '<', '&', '$', '*', '?', '['}) {
+        table[c] = true;
+    }
+
+    return table;
+}();
+
+std::size_t find_unquoted_scalar(const char *data, std::size_t size, std::size_t from) noexcept {
+    for (std::size_t i = from; i < size; ++i) {
+        if (unquoted_special_table[static_cast<unsigned char>(data[i])]) {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+std::size_t find_double_quoted_scalar(const char *data, std::size_t size, std::size_t from) noexcept {
+    for (std::size_t i = from; i < size; ++i) {
+        if (data[i] == '"' || data[i] == '\\' || data[i] == '$' || data[i] == '`') {
+            return i;
+        }
+    }
+
+    return size;
+}
+
+constexpr ScanKernelTable scalar_kernels{ScanKernel::Scalar, find_unquoted_scalar, find_double_quoted_scalar};
+
+#ifdef SHELL_LEXER_SCAN_X86
+
+// Both vector kernels share the same shape: compare a block against every
+// special byte, OR the results, and let the lowest set bit of the byte mask
+// give the offset. \t..\r are matched as one range via an unsigned minimum.
+// The tail shorter than one block goes through the scalar kernel.
+
+__attribute__((target("sse2"))) std::size_t
+find_unquoted_sse2(const char *data, std::size_t size, std::size_t from) noexcept {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i single_quote = _mm_set1_epi8('\'');
+    const __m128i double_quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i greater = _mm_set1_epi8('>');
+    const __m128i less = _mm_set1_epi8('<');
+    const __m128i ampersand = _mm_set1_epi8('&');
+    const __m128i dollar = _mm_set1_epi8('$');
+    const __m128i backquote = _mm_set1_epi8('`');
+    const __m128i star = _mm_set1_epi8('*');
+    const __m128i question = _mm_set1_epi8('?');
+    const __m128i bracket = _mm_set1_epi8('[');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i control_span = _mm_set1_epi8('\r' - '\t');
+
+    std::size_t i = from;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        const __m128i shifted = _mm_sub_epi8(block, tab);
+        __m128i hits = _mm_cmpeq_epi8(_mm_min_epu8(shifted, control_span), shifted);
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, space));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, single_quote));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, double_quote));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, backslash));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, pipe));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, greater));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, less));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, ampersand));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, dollar));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, backquote));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, star));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, question));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, bracket));
+
+        if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits)); mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+
+    return find_unquoted_scalar(data, size, i);
+}
+
+__attribute__((target("sse2"))) std::size_t
+find_double_quoted_sse2(const char *data, std::size_t size, std::size_t from) noexcept {
+    const __m128i double_quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i dollar = _mm_set1_epi8('$');
+    const __m128i backquote = _mm_set1_epi8('`');
+
+    std::size_t i = from;
+    for (; i + 16 <= size; i += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, double_quote), _mm_cmpeq_epi8(block, backslash));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, dollar));
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, backquote));
+
+        if (const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hits)); mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+
+    return find_double_quoted_scalar(data, size, i);
+}
+
+__attribute__((target("avx2"))) std::size_t
+find_unquoted_avx2(const char *data, std::size_t size, std::size_t from) noexcept {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i single_quote = _mm256_set1_epi8('\'');
+    const __m256i double_quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i pipe = _mm256_set1_epi8('|');
+    const __m256i greater = _mm256_set1_epi8('>');
+    const __m256i less = _mm256_set1_epi8('<');
+    const __m256i ampersand = _mm256_set1_epi8('&');
+    const __m256i dollar = _mm256_set1_epi8('$');
+    const __m256i backquote = _mm256_set1_epi8('`');
+    const __m256i star = _mm256_set1_epi8('*');
+    const __m256i question = _mm256_set1_epi8('?');
+    const __m256i bracket = _mm256_set1_epi8('[');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i control_span = _mm256_set1_epi8('\r' - '\t');
+
+    std::size_t i = from;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const __m256i shifted = _mm256_sub_epi8(block, tab);
+        __m256i hits = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, control_span), shifted);
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, space));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, single_quote));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, double_quote));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, backslash));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, pipe));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, greater));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, less));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, ampersand));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, dollar));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, backquote));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, star));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, question));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, bracket));
+
+        if (const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits)); mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+
+    return find_unquoted_sse2(data, size, i);
+}
+
+__attribute__((target("avx2"))) std::size_t
+find_double_quoted_avx2(const char *data, std::size_t size, std::size_t from) noexcept {
+    const __m256i double_quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i dollar = _mm256_set1_epi8('$');
+    const __m256i backquote = _mm256_set1_epi8('`');
+
+    std::size_t i = from;
+    for (; i + 32 <= size; i += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, double_quote), _mm256_cmpeq_epi8(block, backslash));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, dollar));
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, backquote));
+
+        if (const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(hits)); mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+
+    return find_double_quoted_sse2(data, size, i);
+}
+
+constexpr ScanKernelTable sse2_kernels{ScanKernel::Sse2, find_unquoted_sse2, find_double_quoted_sse2};
+constexpr ScanKernelTable avx2_kernels{ScanKernel::Avx2, find_unquoted_avx2, find_double_quoted_avx2};
+
+#endif
+
+[[nodiscard]] const ScanKernelTable *kernels_for(ScanKernel kernel) noexcept {
+    switch (kernel) {
+    case ScanKernel::Scalar:
+        return &scalar_kernels;
+#ifdef SHELL_LEXER_SCAN_X86
+    case ScanKernel::Sse2:
+        return __builtin_cpu_supports("sse2") ? &sse2_kernels : nullptr;
+    case ScanKernel::Avx2:
+        return __builtin_cpu_supports("avx2") ? &avx2_kernels : nullptr;
+#else
+    case ScanKernel::Sse2:
+    case ScanKernel::Avx2:
+        return nullptr;
+#endif
+    }
+
+    return nullptr;
+}
+
+[[nodiscard]] const ScanKernelTable *detect_kernels() noexcept {
+    for (const auto kernel : {ScanKernel::Avx2, ScanKernel::Sse2}) {
+        if (const auto *table = kernels_for(kernel); table != nullptr) {
+            return table;
+        }
+    }
+
+    return &scalar_kernels;
+}
+
+const ScanKernelTable *active_kernels = nullptr;
+
+[[nodiscard]] const ScanKernelTable &kernels() noexcept {
+    if (active_kernels == nullptr) {
+        active_kernels = detect_kernels();
+    }
+
+    return *active_kernels;
+}
+
+} // namespace
+
+bool scan_kernel_supported(ScanKernel kernel) noexcept { return kernels_for(kernel) != nullptr; }
+
+ScanKernel active_scan_kernel() noexcept { return kernels().kind; }
+
+bool select_scan_kernel(ScanKernel kernel) noexcept {
+    const auto *table = kernels_for(kernel);
+    if (table == nullptr) {
+        return false;
+    }
+
+    active_kernels = table;
+    return true;
+}
+
+std::size_t find_unquoted_special(std::string_view text, std::size_t from) noexcept {
+    return kernels().unquoted(text.data(), text.size(), from);
+}
+
+std::size_t find_double_quoted_special(std::string_view text, std::size_t from) noexcept {
+    return kernels().double_quoted(text.data(), text.size(), from);
+}
+
+} // namespace shell
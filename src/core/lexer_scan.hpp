@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace shell {
+
+// Block-scanning kernels used by the tokenizer to skip over runs of ordinary
+// characters. The widest kernel the CPU supports is picked on first use.
+enum class ScanKernel {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+// Whitespace as the "C" locale's isspace() sees it, independent of setlocale().
+[[nodiscard]] constexpr bool is_lexer_space(char c) noexcept {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+[[nodiscard]] bool scan_kernel_supported(ScanKernel kernel) noexcept;
+[[nodiscard]] ScanKernel active_scan_kernel() noexcept;
+
+// Overrides the automatic choice; unsupported kernels are ignored and false is
+// returned. Meant for tests and benchmarks, not for concurrent use.
+bool select_scan_kernel(ScanKernel kernel) noexcept;
+
+// Offset of the first whitespace, quote, backquote, backslash, '|', '>', '<',
+// '&', '$' or glob character ('*', '?', '[') at or after `from`, or
+// text.size() if the rest of the text is an ordinary run.
+[[nodiscard]] std::size_t find_unquoted_special(std::string_view text, std::size_t from) noexcept;
+
+// Offset of the first '"', backslash, '$' or backquote at or after `from`, or
+// text.size().
+[[nodiscard]] std::size_t find_double_quoted_special(std::string_view text, std::size_t from) noexcept;
+
+} // namespace shell
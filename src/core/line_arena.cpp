@@ -0,0 +1,113 @@
+#include "core/line_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace shell {
+
+ArenaResource::ArenaResource(std::size_t initial_block_size) noexcept
+    : initial_block_size_(initial_block_size > 0 ? initial_block_size : default_block_size) {}
+
+void ArenaResource::rewind() noexcept {
+    current_ = 0;
+    offset_ = 0;
+}
+
+std::size_t ArenaResource::block_count() const noexcept { return blocks_.size(); }
+
+void *ArenaResource::do_allocate(std::size_t bytes, std::size_t alignment) {
+    while (true) {
+        if (current_ < blocks_.size()) {
+            Block &block = blocks_[current_];
+            const auto base = reinterpret_cast<std::uintptr_t>(block.data.get());
+            const std::uintptr_t aligned = (base + offset_ + alignment - 1) & ~(std::uintptr_t{alignment} - 1);
+            const std::size_t begin = static_cast<std::size_t>(aligned - base);
+
+            if (begin <= block.size && bytes <= block.size - begin) {
+                offset_ = begin + bytes;
+                return block.data.get() + begin;
+            }
+
+            ++current_;
+            offset_ = 0;
+            continue;
+        }
+
+        // Out of retained blocks: add one at least twice the size of the last
+        // so a long line needs only a few of them.
+        const std::size_t previous = blocks_.empty() ? initial_block_size_ / 2 : blocks_.back().size;
+        const std::size_t size = std::max(previous * 2, bytes + alignment);
+        blocks_.push_back(Block{.data = std::make_unique_for_overwrite<std::byte[]>(size), .size = size});
+        current_ = blocks_.size() - 1;
+        offset_ = 0;
+    }
+}
+
+void ArenaResource::do_deallocate(void * /*pointer*/, std::size_t /*bytes*/, std::size_t /*alignment*/) noexcept {}
+
+bool ArenaResource::do_is_equal(const std::pmr::memory_resource &other) const noexcept { return this == &other; }
+
+void LineArena::reset(std::size_t capacity) {
+    if (capacity > capacity_) {
+        buffer_ = std::make_unique_for_overwrite<char[]>(capacity);
+        capacity_ = capacity;
+    }
+
+    text_ = buffer_.get();
+    text_capacity_ = capacity_;
+    used_ = 0;
+    pending_begin_ = 0;
+    resource_.rewind();
+}
+
+void LineArena::append(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+
+    if (text.size() > text_capacity_ - used_) {
+        grow(text.size());
+    }
+
+    std::memcpy(text_ + used_, text.data(), text.size());
+    used_ += text.size();
+}
+
+void LineArena::append(char c) {
+    if (used_ == text_capacity_) {
+        grow(1);
+    }
+
+    text_[used_++] = c;
+}
+
+// Moves the unfinished text into a larger block from the resource; text that
+// was already finished stays where it is.
+void LineArena::grow(std::size_t needed) {
+    const std::size_t pending = used_ - pending_begin_;
+    const std::size_t capacity = std::max(text_capacity_ * 2, pending + needed);
+    auto *text = static_cast<char *>(resource_.allocate(capacity, 1));
+    if (pending > 0) {
+        std::memcpy(text, text_ + pending_begin_, pending);
+    }
+
+    text_ = text;
+    text_capacity_ = capacity;
+    used_ = pending;
+    pending_begin_ = 0;
+}
+
+std::string_view LineArena::finish() noexcept {
+    const std::string_view text(text_ + pending_begin_, used_ - pending_begin_);
+    pending_begin_ = used_;
+    return text;
+}
+
+std::size_t LineArena::pending_size() const noexcept { return used_ - pending_begin_; }
+
+std::pmr::memory_resource *LineArena::resource() noexcept { return &resource_; }
+
+const ArenaResource &LineArena::arena_resource() const noexcept { return resource_; }
+
+} // namespace shell
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+namespace shell {
+
+// Monotonic memory resource that keeps its blocks when rewound, so once it has
+// grown to fit the largest line seen, parsing further lines allocates nothing
+// from the heap. Deallocation is a no-op; everything is reclaimed by rewind().
+class ArenaResource final : public std::pmr::memory_resource {
+  public:
+    static constexpr std::size_t default_block_size = 4 * 1024;
+
+    explicit ArenaResource(std::size_t initial_block_size = default_block_size) noexcept;
+
+    ArenaResource(const ArenaResource &) = delete;
+    ArenaResource &operator=(const ArenaResource &) = delete;
+
+    // Invalidates everything allocated so far.
+    void rewind() noexcept;
+
+    [[nodiscard]] std::size_t block_count() const noexcept;
+
+  private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        std::size_t size;
+    };
+
+    std::vector<Block> blocks_;
+    std::size_t initial_block_size_;
+    std::size_t current_{0};
+    std::size_t offset_{0};
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void *pointer, std::size_t bytes, std::size_t alignment) noexcept override;
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+};
+
+// Per-line storage reused from one line to the next: the text of tokens whose
+// spelling changed during quote or escape removal or expansion (and therefore
+// cannot be a view into the input line), and the memory resource the parsed
+// Pipeline is allocated from. Room for a whole line of text is reserved up
+// front so views handed out earlier never move.
+class LineArena {
+  public:
+    // Drops everything stored for the previous line and reserves room for
+    // `capacity` bytes of text. A Pipeline parsed from the previous line must
+    // be destroyed first: its commands live in the rewound memory, so
+    // destroying it afterwards is undefined behaviour.
+    void reset(std::size_t capacity);
+
+    // Text beyond the reserved capacity (expansions can make a line longer)
+    // continues in memory from resource(); finished text never moves.
+    void append(std::string_view text);
+    void append(char c);
+
+    // Ends the text built by the appends since the last finish().
+    [[nodiscard]] std::string_view finish() noexcept;
+    [[nodiscard]] std::size_t pending_size() const noexcept;
+
+    [[nodiscard]] std::pmr::memory_resource *resource() noexcept;
+    [[nodiscard]] const ArenaResource &arena_resource() const noexcept;
+
+  private:
+    std::unique_ptr<char[]> buffer_;
+    std::size_t capacity_{0};
+    // Where text currently goes: buffer_, or a spill block from resource_.
+    char *text_{nullptr};
+    std::size_t text_capacity_{0};
+    std::size_t used_{0};
+    std::size_t pending_begin_{0};
+    ArenaResource resource_;
+
+    void grow(std::size_t needed);
+};
+
+} // namespace shell
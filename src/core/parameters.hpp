@@ -0,0 +1,27 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+namespace shell {
+
+// Supplies the values the lexer substitutes for `$` expansions and command
+// substitutions. The lexer copies a value before asking for the next one, so a
+// view into a buffer the source reuses is fine.
+class ParameterSource {
+  public:
+    virtual ~ParameterSource() = default;
+
+    // `name` is a special parameter such as "?" or "!", or a variable name.
+    // No value expands to nothing.
+    [[nodiscard]] virtual std::optional<std::string_view> parameter(std::string_view name) const = 0;
+
+    // The output of `command` for `$(command)` or `command` in backquotes,
+    // without its trailing newlines. By default commands are not run and
+    // substitute nothing.
+    [[nodiscard]] virtual std::optional<std::string_view> command_output(std::string_view /*command*/) const {
+        return std::nullopt;
+    }
+};
+
+} // namespace shell
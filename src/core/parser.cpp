@@ -1,81 +1,240 @@
 #include "core/parser.hpp"
 
+#include <algorithm>
+#include <format>
 #include <optional>
 #include <utility>
 
+#include <unistd.h>
+
+#include "core/glob.hpp"
+#include "core/line_arena.hpp"
+#include "core/tokenizer.hpp"
+#include "core/trace.hpp"
+
 namespace shell {
 
 namespace {
 
-[[nodiscard]] std::optional<RedirectionOp> redirection_from_token(std::string_view token) {
-    if (token == ">" || token == "1>") {
-        return RedirectionOp::StdoutTruncate;
+[[nodiscard]] RedirectionOp redirection_op_for(const Token &token) noexcept {
+    if (token.duplicate) {
+        return RedirectionOp::Duplicate;
+    }
+
+    if (token.here == HereKind::String) {
+        return RedirectionOp::StdinString;
     }
 
-    if (token == ">>" || token == "1>>") {
-        return RedirectionOp::StdoutAppend;
+    if (token.here != HereKind::None) {
+        return RedirectionOp::StdinDocument;
     }
 
-    if (token == "2>") {
-        return RedirectionOp::StderrTruncate;
+    if (token.input) {
+        return RedirectionOp::StdinRead;
     }
 
-    if (token == "2>>") {
-        return RedirectionOp::StderrAppend;
+    if (token.fd == 2) {
+        return token.append ? RedirectionOp::StderrAppend : RedirectionOp::StderrTruncate;
+    }
+
+    return token.append ? RedirectionOp::StdoutAppend : RedirectionOp::StdoutTruncate;
+}
+
+// The `M` of `N>&M`: a single digit, like the descriptors a redirection can
+// name.
+[[nodiscard]] std::optional<int> descriptor_number(const Token &target) noexcept {
+    if (target.text.size() != 1 || target.text[0] < '0' || target.text[0] > '9') {
+        return std::nullopt;
     }
 
-    return std::nullopt;
+    return target.text[0] - '0';
+}
+
+[[nodiscard]] bool is_keyword(const std::optional<Token> &token, std::string_view keyword) noexcept {
+    return token.has_value() && token->kind == TokenKind::Word && !token->quoted && token->text == keyword;
 }
 
+[[nodiscard]] Command make_command(std::pmr::memory_resource *resource) {
+    return Command{
+        .name = {},
+        .args = std::pmr::vector<std::string_view>(resource),
+        .redirections = std::pmr::vector<Redirection>(resource),
+        .assignments = std::pmr::vector<Assignment>(resource),
+    };
+}
+
+// A word as written: a glob pattern with its escapes removed.
+[[nodiscard]] std::string_view literal_text(const Token &word, LineArena &arena) {
+    if (!word.glob || word.text.find('\\') == std::string_view::npos) {
+        return word.text;
+    }
+
+    for (std::size_t i = 0; i < word.text.size(); ++i) {
+        if (word.text[i] == '\\' && i + 1 < word.text.size()) {
+            ++i;
+        }
+        arena.append(word.text[i]);
+    }
+    return arena.finish();
+}
+
+// Adds the paths a glob pattern matches to `command`, or the word itself if it
+// matches nothing. Matches are streamed straight into the arguments as the
+// directories are read, and only the new ones are sorted, once, at the end.
+void expand_glob(const Token &word, Command &command, LineArena &arena) {
+    const std::size_t first = command.args.size();
+    const std::size_t matches = glob_expand(word.text, [&](std::string_view path) {
+        arena.append(path);
+        command.args.push_back(arena.finish());
+    });
+
+    if (matches == 0) {
+        command.args.push_back(literal_text(word, arena));
+    } else {
+        std::sort(command.args.begin() + static_cast<std::ptrdiff_t>(first), command.args.end());
+    }
+
+    if (command.name.empty()) {
+        command.name = command.args[first];
+        command.args.erase(command.args.begin() + static_cast<std::ptrdiff_t>(first));
+    }
+}
+
+constexpr std::string_view standalone_assignments = "variable assignments without a command must stand alone";
+
 } // namespace
 
-std::expected<Pipeline, ParseError> Parser::parse(std::span<const std::string> tokens) const {
-    Pipeline pipeline;
-    Command current;
+std::expected<Pipeline, ParseError>
+Parser::parse(std::string_view line, LineArena &arena, const ParameterSource *parameters) const {
+    // Lexing happens inside this pass, so the span covers both.
+    const TraceSpan span("parse");
+    Lexer lexer(line, arena, parameters);
+    std::pmr::memory_resource *resource = arena.resource();
+    Pipeline pipeline{.stages = std::pmr::vector<Command>(resource)};
+    Command current = make_command(resource);
     bool last_token_was_pipe = false;
 
-    for (std::size_t i = 0; i < tokens.size(); ++i) {
-        const auto &token = tokens[i];
+    std::optional<Token> token = lexer.next();
+    if (is_keyword(token, "time")) {
+        pipeline.timing = PipelineTiming::Total;
+        token = lexer.next();
+        if (is_keyword(token, "-v")) {
+            pipeline.timing = PipelineTiming::PerStage;
+            token = lexer.next();
+        }
+    }
+
+    for (; token.has_value(); token = lexer.next()) {
+        last_token_was_pipe = false;
+
+        if (pipeline.background) {
+            return std::unexpected(ParseError{"`&' must end the command line"});
+        }
+
+        switch (token->kind) {
+        case TokenKind::Background:
+            if (current.name.empty() && !current.assignments.empty()) {
+                return std::unexpected(ParseError{std::string(standalone_assignments)});
+            }
+
+            if (current.name.empty()) {
+                return std::unexpected(ParseError{"syntax error near unexpected token `&'"});
+            }
+
+            pipeline.background = true;
+            break;
+
+        case TokenKind::Pipe:
+            if (current.name.empty() && !current.assignments.empty()) {
+                return std::unexpected(ParseError{std::string(standalone_assignments)});
+            }
 
-        if (token == "|") {
             if (current.name.empty()) {
                 return std::unexpected(ParseError{"syntax error near unexpected token `|'"});
             }
 
             pipeline.stages.push_back(std::move(current));
-            current = Command{};
+            current = make_command(resource);
             last_token_was_pipe = true;
-            continue;
-        }
+            break;
 
-        last_token_was_pipe = false;
-
-        if (const auto redirection = redirection_from_token(token); redirection.has_value()) {
-            if (current.name.empty()) {
+        case TokenKind::Redirection: {
+            if (current.name.empty() && current.assignments.empty()) {
                 return std::unexpected(ParseError{"redirection requires a command"});
             }
 
-            if (i + 1 >= tokens.size() || tokens[i + 1] == "|") {
+            const auto target = lexer.next();
+            if (!lexer.error().empty()) {
+                return std::unexpected(ParseError{std::string(lexer.error())});
+            }
+            if (!target.has_value() || target->kind != TokenKind::Word) {
                 return std::unexpected(ParseError{"redirection missing target file"});
             }
 
-            current.redirections.push_back(Redirection{.op = *redirection, .target = tokens[i + 1]});
-            ++i;
-            continue;
+            Redirection redirection{
+                .op = redirection_op_for(*token),
+                .target = literal_text(*target, arena),
+                .literal = target->quoted,
+                .strip_tabs = token->here == HereKind::DocumentStripTabs,
+                .target_fd = token->fd,
+            };
+
+            if (token->duplicate) {
+                const auto source = descriptor_number(*target);
+                if (!source.has_value()) {
+                    return std::unexpected(
+                        ParseError{std::format("{}: redirection needs a file descriptor", target->text)});
+                }
+                redirection.source_fd = *source;
+            }
+
+            current.redirections.push_back(redirection);
+
+            // `&> file` is `> file 2>&1`.
+            if (token->both) {
+                current.redirections.push_back(Redirection{
+                    .op = RedirectionOp::Duplicate,
+                    .target = redirection.target,
+                    .source_fd = STDOUT_FILENO,
+                    .target_fd = STDERR_FILENO,
+                });
+            }
+            break;
         }
 
-        if (current.name.empty()) {
-            current.name = token;
-        } else {
-            current.args.push_back(token);
+        case TokenKind::Word:
+            if (current.name.empty() && token->assignment) {
+                // Assignment values are not globbed.
+                const std::string_view text = literal_text(*token, arena);
+                const std::size_t separator = text.find('=');
+                current.assignments.push_back(Assignment{
+                    .name = text.substr(0, separator),
+                    .value = text.substr(separator + 1),
+                });
+            } else if (token->glob) {
+                expand_glob(*token, current, arena);
+            } else if (!current.name.empty()) {
+                current.args.push_back(token->text);
+            } else {
+                current.name = token->text;
+            }
+            break;
         }
     }
 
+    if (!lexer.error().empty()) {
+        return std::unexpected(ParseError{std::string(lexer.error())});
+    }
+
     if (last_token_was_pipe) {
         return std::unexpected(ParseError{"syntax error near unexpected token `|'"});
     }
 
-    if (!current.name.empty()) {
+    if (current.name.empty() && !current.assignments.empty() && !pipeline.stages.empty()) {
+        return std::unexpected(ParseError{std::string(standalone_assignments)});
+    }
+
+    if (!current.name.empty() || !current.assignments.empty()) {
         pipeline.stages.push_back(std::move(current));
     }
 
@@ -1,21 +1,32 @@
 #pragma once
 
 #include <expected>
-#include <span>
 #include <string>
-#include <vector>
+#include <string_view>
 
 #include "core/command.hpp"
 
 namespace shell {
 
+class LineArena;
+class ParameterSource;
+
 struct ParseError {
     std::string message;
 };
 
 class Parser {
   public:
-    [[nodiscard]] std::expected<Pipeline, ParseError> parse(std::span<const std::string> tokens) const;
+    // Lexes and parses `line` in a single pass. The pipeline is allocated from
+    // `arena` and its words are views into `line` and `arena`, so it must be
+    // discarded before either changes. A blank or comment-only line yields an
+    // empty pipeline. A leading unquoted `time` or `time -v` sets its timing,
+    // and a trailing `&` marks it as a background job. `parameters` supplies
+    // `$` expansions (see Lexer); glob patterns are expanded here, against the
+    // current directory. Here-documents come back with their delimiters;
+    // reading their bodies is up to the caller.
+    [[nodiscard]] std::expected<Pipeline, ParseError>
+    parse(std::string_view line, LineArena &arena, const ParameterSource *parameters = nullptr) const;
 };
 
 } // namespace shell
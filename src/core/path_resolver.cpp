@@ -1,34 +1,131 @@
 #include "core/path_resolver.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <filesystem>
-#include <sstream>
 #include <string>
 #include <system_error>
+#include <utility>
+
+#include "core/trace.hpp"
+#include "core/variable_store.hpp"
 
 namespace shell {
 
 namespace fs = std::filesystem;
 
-void PathResolver::scan_path_executables(
-    std::string_view prefix,
-    const std::function<bool(std::string_view filename, std::string_view full_path)> &callback) const {
-    const char *path_env = std::getenv("PATH");
-    if (path_env == nullptr) {
+namespace {
+
+constexpr auto executable_bits = fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec;
+
+[[nodiscard]] bool is_executable_file(const fs::path &path) {
+    std::error_code ec;
+    const auto status = fs::status(path, ec);
+    return !ec && fs::is_regular_file(status) && (status.permissions() & executable_bits) != fs::perms::none;
+}
+
+} // namespace
+
+void PathResolver::use_variables(const VariableStore &variables) noexcept { variables_ = &variables; }
+
+void PathResolver::refresh_path_directories() const {
+    std::optional<std::string_view> path_env;
+    if (variables_ != nullptr) {
+        path_env = variables_->get("PATH");
+    } else if (const char *value = std::getenv("PATH"); value != nullptr) {
+        path_env = value;
+    }
+
+    if (!path_env.has_value()) {
+        if (path_env_.has_value()) {
+            path_env_.reset();
+            path_directories_.clear();
+            command_cache_.clear();
+        }
+        return;
+    }
+
+    if (path_env_.has_value() && *path_env_ == *path_env) {
         return;
     }
 
-    std::stringstream path_stream(path_env);
-    std::string dir;
+    std::vector<PathDirectory> directories;
+    std::string_view remaining = *path_env;
+    while (!remaining.empty()) {
+        const auto separator = remaining.find(':');
+        const auto dir = remaining.substr(0, separator);
+        if (!dir.empty()) {
+            directories.push_back(PathDirectory{.path = std::string(dir), .observed = false, .mtime = std::nullopt});
+        }
+
+        if (separator == std::string_view::npos) {
+            break;
+        }
+        remaining.remove_prefix(separator + 1);
+    }
+
+    command_cache_.clear();
+    path_directories_ = std::move(directories);
+    path_env_ = std::string(*path_env);
+}
+
+bool PathResolver::sync_directory(std::size_t index) const {
+    std::error_code ec;
+    std::optional<fs::file_time_type> mtime;
+    if (const auto time = fs::last_write_time(path_directories_[index].path, ec); !ec) {
+        mtime = time;
+    }
+
+    auto &directory = path_directories_[index];
+    const bool changed = directory.observed && directory.mtime != mtime;
+    if (changed) {
+        clear_command_cache();
+    }
+
+    directory.observed = true;
+    directory.mtime = mtime;
+    return changed;
+}
+
+bool PathResolver::entry_is_current(std::size_t directory_index) const {
+    if (directory_index == std::string::npos) {
+        return true;
+    }
+
+    for (std::size_t i = 0; i <= directory_index && i < path_directories_.size(); ++i) {
+        if (sync_directory(i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+std::optional<PathResolver::CachedCommand> PathResolver::search_path(std::string_view command) const {
+    for (std::size_t i = 0; i < path_directories_.size(); ++i) {
+        (void)sync_directory(i);
+
+        fs::path candidate = fs::path(path_directories_[i].path) / command;
+        if (is_executable_file(candidate)) {
+            return CachedCommand{.path = std::move(candidate).string(), .directory_index = i, .hits = 1};
+        }
+    }
+
+    return std::nullopt;
+}
+
+void PathResolver::scan_path_executables(
+    std::string_view prefix,
+    const std::function<bool(std::string_view filename, std::string_view full_path)> &callback) const {
+    refresh_path_directories();
 
-    while (std::getline(path_stream, dir, ':')) {
+    for (const auto &directory : path_directories_) {
         std::error_code ec;
-        for (const auto &entry : fs::directory_iterator(dir, ec)) {
-            if (ec) {
-                break;
-            }
+        for (fs::directory_iterator it(directory.path, ec), end; !ec && it != end; it.increment(ec)) {
+            const auto &entry = *it;
 
-            if (!entry.is_regular_file(ec) || ec) {
+            std::error_code entry_ec;
+            if (!entry.is_regular_file(entry_ec) || entry_ec) {
                 continue;
             }
 
@@ -37,11 +134,7 @@ void PathResolver::scan_path_executables(
                 continue;
             }
 
-            constexpr auto executable_bits =
-                fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec;
-
-            const auto status = fs::status(entry.path(), ec);
-            if (ec || (status.permissions() & executable_bits) == fs::perms::none) {
+            if (!is_executable_file(entry.path())) {
                 continue;
             }
 
@@ -53,18 +146,51 @@ void PathResolver::scan_path_executables(
 }
 
 std::string PathResolver::find_command_path(std::string_view command) const {
-    std::string resolved_path;
+    const TraceSpan span("resolve", command);
+    if (command.empty() || command.find('/') != std::string_view::npos) {
+        return {};
+    }
+
+    refresh_path_directories();
 
-    scan_path_executables(command, [&](std::string_view filename, std::string_view full_path) {
-        if (filename == command) {
-            resolved_path = full_path;
-            return true;
+    if (auto it = command_cache_.find(command); it != command_cache_.end()) {
+        if (entry_is_current(it->second.directory_index)) {
+            ++it->second.hits;
+            return it->second.path;
         }
+    }
 
-        return false;
-    });
+    auto found = search_path(command);
+    if (!found.has_value()) {
+        return {};
+    }
 
-    return resolved_path;
+    auto [it, inserted] = command_cache_.insert_or_assign(std::string(command), std::move(*found));
+    return it->second.path;
+}
+
+std::string PathResolver::find_command_path_in(std::string_view command, std::string_view path) const {
+    const TraceSpan span("resolve", command);
+    if (command.empty() || command.find('/') != std::string_view::npos) {
+        return {};
+    }
+
+    while (!path.empty()) {
+        const auto separator = path.find(':');
+        if (const auto dir = path.substr(0, separator); !dir.empty()) {
+            fs::path candidate = fs::path(dir) / command;
+            if (is_executable_file(candidate)) {
+                return std::move(candidate).string();
+            }
+        }
+
+        if (separator == std::string_view::npos) {
+            break;
+        }
+        path.remove_prefix(separator + 1);
+    }
+
+    return {};
 }
 
 std::set<std::string> PathResolver::executable_candidates(std::string_view prefix) const {
@@ -78,4 +204,49 @@ std::set<std::string> PathResolver::executable_candidates(std::string_view prefi
     return candidates;
 }
 
+void PathResolver::remember_command(std::string_view command, std::string path) {
+    refresh_path_directories();
+    command_cache_.insert_or_assign(
+        std::string(command),
+        CachedCommand{.path = std::move(path), .directory_index = std::string::npos, .hits = 0});
+}
+
+bool PathResolver::forget_command(std::string_view command) {
+    const auto it = command_cache_.find(command);
+    if (it == command_cache_.end()) {
+        return false;
+    }
+
+    command_cache_.erase(it);
+    return true;
+}
+
+void PathResolver::clear_command_cache() const noexcept {
+    command_cache_.clear();
+    for (auto &directory : path_directories_) {
+        directory.observed = false;
+    }
+}
+
+std::optional<std::string> PathResolver::cached_command_path(std::string_view command) const {
+    const auto it = command_cache_.find(command);
+    if (it == command_cache_.end()) {
+        return std::nullopt;
+    }
+
+    return it->second.path;
+}
+
+std::vector<PathResolver::HashedCommand> PathResolver::cached_commands() const {
+    std::vector<HashedCommand> commands;
+    commands.reserve(command_cache_.size());
+
+    for (const auto &[name, entry] : command_cache_) {
+        commands.push_back(HashedCommand{.name = name, .path = entry.path, .hits = entry.hits});
+    }
+
+    std::ranges::sort(commands, {}, &HashedCommand::name);
+    return commands;
+}
+
 } // namespace shell
@@ -1,18 +1,82 @@
 #pragma once
 
+#include <cstddef>
+#include <filesystem>
 #include <functional>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <vector>
 
 namespace shell {
 
+class VariableStore;
+
+// Resolves command names against PATH. Successful lookups are remembered in a
+// bash-style hash table that is dropped whenever PATH itself changes or one of
+// the directories searched for an entry has been modified since it was cached.
 class PathResolver {
   public:
+    struct HashedCommand {
+        std::string name;
+        std::string path;
+        std::size_t hits;
+    };
+
+    // Reads PATH from the shell's variables instead of the process
+    // environment.
+    void use_variables(const VariableStore &variables) noexcept;
+
     [[nodiscard]] std::string find_command_path(std::string_view command) const;
+    // Searches `path` instead of PATH, for `PATH=... command`. The hash table
+    // is neither consulted nor updated.
+    [[nodiscard]] std::string find_command_path_in(std::string_view command, std::string_view path) const;
     [[nodiscard]] std::set<std::string> executable_candidates(std::string_view prefix) const;
 
+    void remember_command(std::string_view command, std::string path);
+    bool forget_command(std::string_view command);
+    void clear_command_cache() const noexcept;
+
+    [[nodiscard]] std::optional<std::string> cached_command_path(std::string_view command) const;
+    [[nodiscard]] std::vector<HashedCommand> cached_commands() const;
+
   private:
+    struct StringHash {
+        using is_transparent = void;
+
+        [[nodiscard]] std::size_t operator()(std::string_view value) const noexcept {
+            return std::hash<std::string_view>{}(value);
+        }
+    };
+
+    struct PathDirectory {
+        std::string path;
+        bool observed;
+        std::optional<std::filesystem::file_time_type> mtime;
+    };
+
+    struct CachedCommand {
+        std::string path;
+        // Index of the PATH directory the command was found in, or npos for
+        // entries seeded explicitly with `hash -p`.
+        std::size_t directory_index;
+        std::size_t hits;
+    };
+
+    using CommandCache = std::unordered_map<std::string, CachedCommand, StringHash, std::equal_to<>>;
+
+    const VariableStore *variables_{nullptr};
+    mutable std::optional<std::string> path_env_;
+    mutable std::vector<PathDirectory> path_directories_;
+    mutable CommandCache command_cache_;
+
+    void refresh_path_directories() const;
+    [[nodiscard]] bool sync_directory(std::size_t index) const;
+    [[nodiscard]] bool entry_is_current(std::size_t directory_index) const;
+    [[nodiscard]] std::optional<CachedCommand> search_path(std::string_view command) const;
+
     void scan_path_executables(
         std::string_view prefix,
         const std::function<bool(std::string_view filename, std::string_view full_path)> &callback) const;
@@ -1,102 +1,499 @@
 #include "core/tokenizer.hpp"
 
-#include <cctype>
-#include <string>
-#include <utility>
+#include "core/lexer_scan.hpp"
+#include "core/line_arena.hpp"
+#include "core/parameters.hpp"
+#include "core/trace.hpp"
 
 namespace shell {
 
-std::vector<std::string> Tokenizer::tokenize(std::string_view input) const {
-    std::vector<std::string> tokens;
-    std::string token;
+namespace {
 
-    bool single_quoted = false;
-    bool double_quoted = false;
-    bool escaped = false;
+[[nodiscard]] constexpr bool is_name_start(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+[[nodiscard]] constexpr bool is_name_char(char c) noexcept { return is_name_start(c) || (c >= '0' && c <= '9'); }
 
-    auto flush_token = [&]() {
-        if (!token.empty()) {
-            tokens.push_back(token);
-            token.clear();
+// Past the '(' of a `$(`: the offset of the matching ')', skipping quoted text
+// and nested parentheses, or text.size() if there is none.
+[[nodiscard]] std::size_t matching_parenthesis(std::string_view text, std::size_t from) noexcept {
+    std::size_t depth = 1;
+    for (std::size_t i = from; i < text.size(); ++i) {
+        switch (text[i]) {
+        case '\\':
+            ++i;
+            break;
+        case '\'':
+            i = text.find('\'', i + 1);
+            if (i == std::string_view::npos) {
+                return text.size();
+            }
+            break;
+        case '"':
+            for (++i; i < text.size() && text[i] != '"'; ++i) {
+                if (text[i] == '\\') {
+                    ++i;
+                }
+            }
+            if (i >= text.size()) {
+                return text.size();
+            }
+            break;
+        case '(':
+            ++depth;
+            break;
+        case ')':
+            if (--depth == 0) {
+                return i;
+            }
+            break;
+        default:
+            break;
         }
-    };
+    }
+
+    return text.size();
+}
+
+} // namespace
+
+Lexer::Lexer(std::string_view input, LineArena &arena, const ParameterSource *parameters)
+    : input_(input),
+      arena_(arena),
+      parameters_(parameters),
+      quoted_ranges_(arena.resource()),
+      backquoted_(arena.resource()) {
+    // Unescaping only ever drops characters, so a line's worth of arena space
+    // is enough unless an expansion (or escaping a glob pattern) makes a word
+    // longer.
+    arena_.reset(input.size());
+}
 
-    for (std::size_t i = 0; i < input.size(); ++i) {
-        const char current = input[i];
+// Ordinary characters are consumed a run at a time by the scan kernels; the
+// loop body only ever sees quotes, escapes, operators and whitespace. An
+// operator that ends a word is left in place and lexed by the next call.
+std::optional<Token> Lexer::next() {
+    const std::size_t size = input_.size();
 
-        if (escaped) {
-            if (double_quoted && current != '\\' && current != '"') {
-                token.push_back('\\');
+    while (position_ < size) {
+        if (word_empty()) {
+            const char first = input_[position_];
+            if (first == '#') {
+                position_ = size;
+                break;
             }
-            token.push_back(current);
-            escaped = false;
-            continue;
+
+            // A single digit right before `<` or `>` names the descriptor.
+            if (first >= '0' && first <= '9' && position_ + 1 < size &&
+                (input_[position_ + 1] == '<' || input_[position_ + 1] == '>')) {
+                const std::size_t start = position_++;
+                Token token = lex_operator();
+                token.text = input_.substr(start, position_ - start);
+                token.fd = first - '0';
+                return token;
+            }
+
+            // A word that starts with an unquoted `NAME=` is an assignment.
+            if (!word_quoted_ && is_name_start(first)) {
+                std::size_t end = position_ + 1;
+                while (end < size && is_name_char(input_[end])) {
+                    ++end;
+                }
+                word_assignment_ = end < size && input_[end] == '=';
+            }
+        }
+
+        const std::size_t special = find_unquoted_special(input_, position_);
+        append_run(position_, special - position_);
+        position_ = special;
+        if (position_ == size) {
+            break;
         }
 
-        if (current == '\\' && !single_quoted) {
-            escaped = true;
+        const char current = input_[position_];
+
+        if (current == '|' || current == '>' || current == '<' || current == '&') {
+            if (!word_empty()) {
+                return take_word();
+            }
+            word_quoted_ = false;
+            return lex_operator();
+        }
+
+        ++position_;
+
+        if (is_lexer_space(current)) {
+            if (!word_empty()) {
+                return take_word();
+            }
+            word_quoted_ = false;
             continue;
         }
 
-        if (current == '\'' && !double_quoted) {
-            single_quoted = !single_quoted;
+        switch (current) {
+        case '$':
+            expand_parameter(false);
+            break;
+
+        case '`':
+            substitute_backquoted(false);
+            break;
+
+        case '*':
+        case '?':
+        case '[':
+            append_run(position_ - 1, 1);
+            word_glob_ = true;
+            break;
+
+        case '\\':
+            if (position_ < size) {
+                const std::size_t begin = word_length();
+                append_run(position_++, 1);
+                mark_quoted(begin);
+                word_quoted_ = true;
+            }
+            break;
+
+        case '\'': {
+            word_quoted_ = true;
+            const std::size_t begin = word_length();
+            const std::size_t close = input_.find('\'', position_);
+            const std::size_t end = close == std::string_view::npos ? size : close;
+            append_run(position_, end - position_);
+            position_ = end == size ? size : end + 1;
+            mark_quoted(begin);
+            break;
+        }
+
+        case '"': {
+            word_quoted_ = true;
+            const std::size_t begin = word_length();
+            scan_double_quoted(false);
+            mark_quoted(begin);
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    if (!error_.empty()) {
+        return std::nullopt;
+    }
+
+    if (!word_empty()) {
+        return take_word();
+    }
+
+    return std::nullopt;
+}
+
+std::string_view Lexer::expand_document() {
+    scan_double_quoted(true);
+    return word_empty() ? std::string_view{} : take_word().text;
+}
+
+void Lexer::scan_double_quoted(bool document) {
+    const std::size_t size = input_.size();
+    while (position_ < size) {
+        const std::size_t stop = find_double_quoted_special(input_, position_);
+        append_run(position_, stop - position_);
+        position_ = stop;
+        if (position_ == size) {
+            break;
+        }
+
+        const char special = input_[position_++];
+        if (special == '"') {
+            if (!document) {
+                break;
+            }
+            append_run(position_ - 1, 1);
             continue;
         }
 
-        if (current == '"' && !single_quoted) {
-            double_quoted = !double_quoted;
+        if (special == '$') {
+            expand_parameter(true);
             continue;
         }
 
-        const bool in_quotes = single_quoted || double_quoted;
+        if (special == '`') {
+            substitute_backquoted(true);
+            continue;
+        }
 
-        if (!in_quotes) {
-            if (std::isspace(static_cast<unsigned char>(current))) {
-                flush_token();
-                continue;
+        // A backslash only escapes '$', '`', itself and, inside double
+        // quotes, '"'; before anything else it is kept.
+        if (position_ < size) {
+            const char escaped = input_[position_];
+            if (escaped != '\\' && escaped != '$' && escaped != '`' && (document || escaped != '"')) {
+                append_run(position_ - 1, 1);
             }
+            append_run(position_++, 1);
+        }
+    }
+}
 
-            if (current == '|') {
-                flush_token();
-                tokens.emplace_back("|");
-                continue;
-            }
+void Lexer::append_run(std::size_t begin, std::size_t count) {
+    if (count == 0) {
+        return;
+    }
 
-            if (
-                token.empty() && (current == '1' || current == '2') && i + 1 < input.size() &&
-                input[i + 1] == '>') {
-                flush_token();
-                std::string op;
-                op.push_back(current);
-                op.push_back('>');
+    if (word_in_arena_) {
+        arena_.append(input_.substr(begin, count));
+        return;
+    }
 
-                if (i + 2 < input.size() && input[i + 2] == '>') {
-                    op.push_back('>');
-                    ++i;
-                }
+    if (word_size_ == 0) {
+        word_begin_ = begin;
+        word_size_ = count;
+        return;
+    }
+
+    if (word_begin_ + word_size_ == begin) {
+        word_size_ += count;
+        return;
+    }
 
+    arena_.append(input_.substr(word_begin_, word_size_));
+    arena_.append(input_.substr(begin, count));
+    word_in_arena_ = true;
+}
+
+// Text that is not part of the input, such as an expanded value, always goes
+// through the arena.
+void Lexer::append_text(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+
+    if (!word_in_arena_) {
+        arena_.append(input_.substr(word_begin_, word_size_));
+        word_in_arena_ = true;
+    }
+
+    arena_.append(text);
+}
+
+// Wildcards in an unquoted value make the word a glob pattern.
+void Lexer::append_expansion(std::string_view value, bool quoted) {
+    append_text(value);
+    if (!quoted && value.find_first_of("*?[") != std::string_view::npos) {
+        word_glob_ = true;
+    }
+}
+
+// Called just past a '$'. A '$' that does not start `$?`, `$!`, `$NAME`, the
+// braced form of one of them or a `$(command)` stays as written.
+void Lexer::expand_parameter(bool quoted) {
+    const std::size_t dollar = position_ - 1;
+    if (parameters_ == nullptr || position_ == input_.size()) {
+        append_run(dollar, 1);
+        return;
+    }
+
+    if (input_[position_] == '(') {
+        const std::size_t close = matching_parenthesis(input_, position_ + 1);
+        if (close == input_.size()) {
+            fail("unexpected EOF while looking for matching `)'");
+            return;
+        }
+
+        const std::string_view command = input_.substr(position_ + 1, close - position_ - 1);
+        position_ = close + 1;
+        if (const auto output = parameters_->command_output(command); output.has_value()) {
+            append_expansion(*output, quoted);
+        }
+        return;
+    }
+
+    const bool braced = input_[position_] == '{';
+    const std::size_t start = braced ? position_ + 1 : position_;
+    std::size_t end = start;
+    if (end < input_.size() && (input_[end] == '?' || input_[end] == '!')) {
+        ++end;
+    } else if (end < input_.size() && is_name_start(input_[end])) {
+        while (end < input_.size() && is_name_char(input_[end])) {
+            ++end;
+        }
+    }
+
+    if (end == start || (braced && (end == input_.size() || input_[end] != '}'))) {
+        append_run(dollar, 1);
+        return;
+    }
+
+    position_ = braced ? end + 1 : end;
+    if (const auto value = parameters_->parameter(input_.substr(start, end - start)); value.has_value()) {
+        append_expansion(*value, quoted);
+    }
+}
+
+// Called just past an opening '`'. Up to the closing one, a backslash escapes
+// only '$', '`' and itself; the command is passed on as a view into the input
+// unless one did. Without parameters the '`' is an ordinary character.
+void Lexer::substitute_backquoted(bool quoted) {
+    const std::size_t open = position_ - 1;
+    if (parameters_ == nullptr) {
+        append_run(open, 1);
+        return;
+    }
+
+    const std::size_t size = input_.size();
+    std::size_t end = position_;
+    bool escaped = false;
+    while (end < size && input_[end] != '`') {
+        if (input_[end] == '\\' && end + 1 < size) {
+            const char next = input_[end + 1];
+            escaped = escaped || next == '$' || next == '`' || next == '\\';
+            ++end;
+        }
+        ++end;
+    }
+
+    if (end == size) {
+        fail("unexpected EOF while looking for matching ``'");
+        return;
+    }
+
+    std::string_view command = input_.substr(position_, end - position_);
+    position_ = end + 1;
+    if (escaped) {
+        backquoted_.clear();
+        for (std::size_t i = 0; i < command.size(); ++i) {
+            if (command[i] == '\\' && i + 1 < command.size() &&
+                (command[i + 1] == '$' || command[i + 1] == '`' || command[i + 1] == '\\')) {
                 ++i;
-                tokens.push_back(std::move(op));
-                continue;
             }
+            backquoted_ += command[i];
+        }
+        command = backquoted_;
+    }
 
-            if (current == '>') {
-                flush_token();
-                if (i + 1 < input.size() && input[i + 1] == '>') {
-                    tokens.emplace_back(">>");
-                    ++i;
-                } else {
-                    tokens.emplace_back(">");
-                }
-                continue;
+    if (const auto output = parameters_->command_output(command); output.has_value()) {
+        append_expansion(*output, quoted);
+    }
+}
+
+std::string_view Lexer::error() const noexcept { return error_; }
+
+void Lexer::fail(std::string_view message) noexcept {
+    error_ = message;
+    position_ = input_.size();
+}
+
+bool Lexer::word_empty() const noexcept { return !word_in_arena_ && word_size_ == 0; }
+
+std::size_t Lexer::word_length() const noexcept { return word_in_arena_ ? arena_.pending_size() : word_size_; }
+
+void Lexer::mark_quoted(std::size_t begin) {
+    if (const std::size_t end = word_length(); end > begin) {
+        quoted_ranges_.emplace_back(begin, end - begin);
+    }
+}
+
+Token Lexer::take_word() {
+    std::string_view text = word_in_arena_ ? arena_.finish() : input_.substr(word_begin_, word_size_);
+
+    // Only a glob pattern needs its quoted wildcards told apart from the
+    // unquoted ones; every other word keeps its plain spelling.
+    if (word_glob_ && !quoted_ranges_.empty()) {
+        auto range = quoted_ranges_.begin();
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            while (range != quoted_ranges_.end() && i >= range->first + range->second) {
+                ++range;
             }
+            const char c = text[i];
+            if (range != quoted_ranges_.end() && i >= range->first &&
+                (c == '*' || c == '?' || c == '[' || c == '\\')) {
+                arena_.append('\\');
+            }
+            arena_.append(c);
+        }
+        text = arena_.finish();
+    }
+
+    const Token token{
+        .kind = TokenKind::Word,
+        .text = text,
+        .quoted = word_quoted_,
+        .assignment = word_assignment_,
+        .glob = word_glob_,
+    };
+    word_in_arena_ = false;
+    word_size_ = 0;
+    word_quoted_ = false;
+    word_assignment_ = false;
+    word_glob_ = false;
+    quoted_ranges_.clear();
+    return token;
+}
+
+Token Lexer::lex_operator() noexcept {
+    const std::string_view rest = input_.substr(position_);
+    if (rest.front() == '|') {
+        return Token{.kind = TokenKind::Pipe, .text = input_.substr(position_++, 1)};
+    }
+
+    Token token{.kind = TokenKind::Redirection, .text = {}, .fd = 1};
+    std::size_t length = 1;
+    if (rest.front() == '&') {
+        if (!rest.starts_with("&>")) {
+            return Token{.kind = TokenKind::Background, .text = input_.substr(position_++, 1)};
         }
 
-        token.push_back(current);
+        token.both = true;
+        token.append = rest.starts_with("&>>");
+        length = token.append ? 3 : 2;
+    } else if (rest.front() == '<') {
+        token.fd = 0;
+        token.input = true;
+        if (rest.starts_with("<<<")) {
+            token.here = HereKind::String;
+            length = 3;
+        } else if (rest.starts_with("<<-")) {
+            token.here = HereKind::DocumentStripTabs;
+            length = 3;
+        } else if (rest.starts_with("<<")) {
+            token.here = HereKind::Document;
+            length = 2;
+        } else if (rest.starts_with("<&")) {
+            token.duplicate = true;
+            length = 2;
+        }
+    } else if (rest.starts_with(">>")) {
+        token.append = true;
+        length = 2;
+    } else if (rest.starts_with(">&")) {
+        token.duplicate = true;
+        length = 2;
     }
 
-    if (!token.empty()) {
-        tokens.push_back(std::move(token));
+    token.text = rest.substr(0, length);
+    position_ += length;
+    return token;
+}
+
+std::vector<Token> Tokenizer::tokenize(std::string_view input, LineArena &arena) const {
+    const TraceSpan span("tokenize");
+    std::vector<Token> tokens;
+    Lexer lexer(input, arena);
+    while (const auto token = lexer.next()) {
+        tokens.push_back(*token);
+    }
+
+    return tokens;
+}
+
+std::vector<std::string> Tokenizer::tokenize(std::string_view input) const {
+    LineArena arena;
+    std::vector<std::string> tokens;
+    Lexer lexer(input, arena);
+    while (const auto token = lexer.next()) {
+        tokens.emplace_back(token->text);
     }
 
     return tokens;
@@ -1,13 +1,128 @@
 #pragma once
 
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace shell {
 
+class LineArena;
+class ParameterSource;
+
+enum class TokenKind {
+    Word,
+    Pipe,
+    Redirection,
+    Background,
+};
+
+// Redirections that feed stdin from the shell itself: `<<`, `<<-` and `<<<`.
+enum class HereKind {
+    None,
+    Document,
+    DocumentStripTabs,
+    String,
+};
+
+struct Token {
+    TokenKind kind;
+    // Words after quote and escape removal; operators as written.
+    std::string_view text;
+    // Redirections only: the descriptor being redirected (0 for `<`, 1 for `>`
+    // unless a digit names another), whether it is read rather than written,
+    // and whether the target is appended to (>>) rather than truncated (>).
+    // `>&` and `<&` make it a copy of the descriptor named by the target;
+    // `&>` and `&>>` redirect stdout and stderr together.
+    int fd{-1};
+    bool input{false};
+    bool append{false};
+    bool duplicate{false};
+    bool both{false};
+    HereKind here{HereKind::None};
+    // Words only: some part of the word was quoted or escaped, so it cannot
+    // be a keyword.
+    bool quoted{false};
+    // Words only: starts with an unquoted `NAME=`.
+    bool assignment{false};
+    // Words only: has an unquoted `*`, `?` or `[`. The text is then a glob
+    // pattern in which a backslash makes the next character literal, so
+    // quoted wildcards (and backslashes) come back escaped.
+    bool glob{false};
+};
+
+// Pull lexer over one line. Quoting is resolved here, so a quoted "|", ">" or
+// "<" comes back as a Word. Word text is a view into the input whenever quote and
+// escape removal leaves its characters contiguous, and a view into the arena
+// otherwise; both stay valid until the input or the arena changes.
+//
+// With `parameters`, `$?`, `$!` and `$NAME`, braced or not, outside single
+// quotes are replaced by their values, and `$(command)` and `command` in
+// backquotes by the command's output; without, `$` and '`' are ordinary
+// characters. A substitution the line never closes is an error (see error())
+// and is not run.
+// Wildcards are only marked (see Token::glob); expanding them is up to the
+// caller.
+class Lexer {
+  public:
+    // Rewinds `arena` for this line.
+    Lexer(std::string_view input, LineArena &arena, const ParameterSource *parameters = nullptr);
+
+    [[nodiscard]] std::optional<Token> next();
+
+    // Expands the whole input as one line of a here-document body: like
+    // double-quoted text, except that '"' is an ordinary character.
+    [[nodiscard]] std::string_view expand_document();
+
+    // Why lexing stopped early, or empty. Once set, next() yields nothing more.
+    [[nodiscard]] std::string_view error() const noexcept;
+
+  private:
+    std::string_view input_;
+    LineArena &arena_;
+    const ParameterSource *parameters_;
+    std::size_t position_{0};
+    std::string_view error_;
+
+    // Word under construction: an offset and length into the input until the
+    // first gap moves it into the arena.
+    std::size_t word_begin_{0};
+    std::size_t word_size_{0};
+    bool word_in_arena_{false};
+    bool word_quoted_{false};
+    bool word_assignment_{false};
+    bool word_glob_{false};
+    // Offsets and lengths of the quoted parts of the word, kept only so that a
+    // word that turns out to be a glob pattern can escape them.
+    std::pmr::vector<std::pair<std::size_t, std::size_t>> quoted_ranges_;
+    // A backquoted command with its escapes removed.
+    std::pmr::string backquoted_;
+
+    void append_run(std::size_t begin, std::size_t count);
+    void append_text(std::string_view text);
+    void append_expansion(std::string_view value, bool quoted);
+    void expand_parameter(bool quoted);
+    void substitute_backquoted(bool quoted);
+    // Records `message` and skips the rest of the input.
+    void fail(std::string_view message) noexcept;
+    // Called past an opening '"', or at the start of a document line; stops
+    // after the closing '"' or at the end of the input.
+    void scan_double_quoted(bool document);
+    [[nodiscard]] bool word_empty() const noexcept;
+    [[nodiscard]] std::size_t word_length() const noexcept;
+    void mark_quoted(std::size_t begin);
+    [[nodiscard]] Token take_word();
+    [[nodiscard]] Token lex_operator() noexcept;
+};
+
 class Tokenizer {
   public:
+    [[nodiscard]] std::vector<Token> tokenize(std::string_view input, LineArena &arena) const;
+
+    // Token spellings only, for callers that do not care about kinds.
     [[nodiscard]] std::vector<std::string> tokenize(std::string_view input) const;
 };
 
@@ -0,0 +1,147 @@
+#include "core/trace.hpp"
+
+#include <cerrno>
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace shell {
+
+namespace {
+
+// Events are written once this much JSON has accumulated.
+constexpr std::size_t flush_threshold = 64 * 1024;
+
+struct TraceFile {
+    int fd{-1};
+    pid_t owner{-1};
+    pid_t tid{0};
+    bool first_event{true};
+    std::string pending;
+
+    ~TraceFile() { close_file(); }
+
+    void write_pending() noexcept {
+        std::string_view data = pending;
+        while (!data.empty()) {
+            const ssize_t written = write(fd, data.data(), data.size());
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            data.remove_prefix(static_cast<std::size_t>(written));
+        }
+        pending.clear();
+    }
+
+    void close_file() noexcept {
+        if (fd == -1) {
+            return;
+        }
+
+        // A forked child shares the descriptor but not the right to write.
+        if (getpid() == owner) {
+            pending += "\n]\n";
+            write_pending();
+        }
+
+        close(fd);
+        fd = -1;
+        pending.clear();
+    }
+};
+
+TraceFile trace_file;
+
+void append_json_string(std::string &out, std::string_view text) {
+    out += '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                std::format_to(std::back_inserter(out), "\\u{:04x}", static_cast<unsigned>(c));
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+bool Trace::start(const std::string &path) {
+    stop();
+
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    trace_file.fd = fd;
+    trace_file.owner = getpid();
+    trace_file.tid = gettid();
+    trace_file.first_event = true;
+    trace_file.pending.reserve(flush_threshold + 1024);
+    trace_file.pending = "[";
+    enabled_ = true;
+    return true;
+}
+
+void Trace::stop() noexcept {
+    enabled_ = false;
+    trace_file.close_file();
+}
+
+void Trace::record(std::string_view name, std::string_view detail, Clock::time_point begin, Clock::time_point end) {
+    if (getpid() != trace_file.owner || gettid() != trace_file.tid) {
+        return;
+    }
+
+    std::string &out = trace_file.pending;
+    out += trace_file.first_event ? "\n" : ",\n";
+    trace_file.first_event = false;
+
+    const auto ts = std::chrono::duration<double, std::micro>(begin.time_since_epoch()).count();
+    const auto dur = std::chrono::duration<double, std::micro>(end - begin).count();
+
+    out += R"({"name":)";
+    append_json_string(out, name);
+    std::format_to(std::back_inserter(out),
+                   R"(,"cat":"shell","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{})",
+                   ts,
+                   dur,
+                   trace_file.owner,
+                   trace_file.tid);
+    if (!detail.empty()) {
+        out += R"(,"args":{"detail":)";
+        append_json_string(out, detail);
+        out += '}';
+    }
+    out += '}';
+
+    if (out.size() >= flush_threshold) {
+        trace_file.write_pending();
+    }
+}
+
+} // namespace shell
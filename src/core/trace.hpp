@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <string_view>
+
+namespace shell {
+
+// Opt-in recording of the shell's own phases as Chrome trace events
+// (chrome://tracing, Perfetto). Events are complete ("X") spans collected in
+// memory and written to the trace file in large blocks. Only the shell's main
+// thread records; a forked child never writes to its parent's trace.
+class Trace {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Starts a trace in `path`, replacing any trace already running. Returns
+    // false if the file cannot be created.
+    static bool start(const std::string &path);
+
+    // Writes out pending events and closes the trace file.
+    static void stop() noexcept;
+
+    [[nodiscard]] static bool enabled() noexcept { return enabled_; }
+
+    // `detail` is shown as the event's args.detail.
+    static void record(std::string_view name, std::string_view detail, Clock::time_point begin, Clock::time_point end);
+
+  private:
+    static inline bool enabled_ = false;
+};
+
+// Records the time between construction and destruction as one event. Costs
+// a flag test when tracing is off. `name` and `detail` must outlive the span.
+class TraceSpan {
+  public:
+    explicit TraceSpan(std::string_view name, std::string_view detail = {}) noexcept
+        : name_(name), detail_(detail) {
+        if (Trace::enabled()) {
+            begin_ = Trace::Clock::now();
+        }
+    }
+
+    ~TraceSpan() {
+        if (Trace::enabled() && begin_ != Trace::Clock::time_point{}) {
+            Trace::record(name_, detail_, begin_, Trace::Clock::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+  private:
+    std::string_view name_;
+    std::string_view detail_;
+    Trace::Clock::time_point begin_{};
+};
+
+} // namespace shell
@@ -0,0 +1,309 @@
+#include "core/variable_store.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace shell {
+
+namespace {
+
+[[nodiscard]] bool is_name_start(char value) noexcept {
+    return (value >= 'a' && value <= 'z') || (value >= 'A' && value <= 'Z') || value == '_';
+}
+
+[[nodiscard]] bool is_name_char(char value) noexcept {
+    return is_name_start(value) || (value >= '0' && value <= '9');
+}
+
+} // namespace
+
+VariableStore::VariableStore(char *const *environment) {
+    if (environment == nullptr) {
+        return;
+    }
+
+    for (; *environment != nullptr; ++environment) {
+        const std::string_view entry(*environment);
+        const std::size_t separator = entry.find('=');
+        if (separator == std::string_view::npos) {
+            continue;
+        }
+
+        // Entries that are not shell names cannot be reached or changed from
+        // the shell, so they are dropped as other shells drop them.
+        const std::string_view name = entry.substr(0, separator);
+        if (!valid_name(name)) {
+            continue;
+        }
+
+        set(name, entry.substr(separator + 1));
+        set_exported(name, true);
+    }
+}
+
+VariableStore::~VariableStore() {
+    for (Slot &slot : slots_) {
+        if (slot.used) {
+            release(slot);
+        }
+    }
+}
+
+bool VariableStore::valid_name(std::string_view name) noexcept {
+    return !name.empty() && is_name_start(name.front()) && std::ranges::all_of(name, is_name_char);
+}
+
+std::optional<std::string_view> VariableStore::get(std::string_view name) const noexcept {
+    const std::size_t index = find(name, hash_name(name));
+    if (index == slots_.size() || !slots_[index].has_value) {
+        return std::nullopt;
+    }
+
+    return slots_[index].value();
+}
+
+bool VariableStore::exported(std::string_view name) const noexcept {
+    const std::size_t index = find(name, hash_name(name));
+    return index != slots_.size() && slots_[index].exported;
+}
+
+void VariableStore::set(std::string_view name, std::string_view value) {
+    const std::uint32_t hash = hash_name(name);
+    const std::size_t index = find(name, hash);
+    Slot &slot = index == slots_.size() ? insert(name, hash) : slots_[index];
+
+    if (slot.has_value && slot.value() == value) {
+        return;
+    }
+
+    write_text(slot, name, value);
+    if (slot.exported) {
+        envp_dirty_ = true;
+    }
+}
+
+void VariableStore::set_exported(std::string_view name, bool exported) {
+    const std::uint32_t hash = hash_name(name);
+    const std::size_t index = find(name, hash);
+    if (index == slots_.size() && !exported) {
+        return;
+    }
+
+    Slot &slot = index == slots_.size() ? insert(name, hash) : slots_[index];
+    if (slot.exported != exported && slot.has_value) {
+        envp_dirty_ = true;
+    }
+    slot.exported = exported;
+}
+
+bool VariableStore::unset(std::string_view name) {
+    std::size_t index = find(name, hash_name(name));
+    if (index == slots_.size()) {
+        return false;
+    }
+
+    if (slots_[index].exported) {
+        envp_dirty_ = true;
+    }
+    release(slots_[index]);
+    slots_[index].used = false;
+    --size_;
+
+    // Backward-shift deletion: pull later members of the probe run into the
+    // hole so lookups never need tombstones.
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t next = (index + 1) & mask;
+    while (slots_[next].used) {
+        const std::size_t home = slots_[next].hash & mask;
+        // Whether `home` lies cyclically in (index, next]; if it does, the
+        // entry is already as close to its home as the hole would make it.
+        const bool stays = index <= next ? (index < home && home <= next) : (index < home || home <= next);
+        if (!stays) {
+            // Inline text moves with the slot, so envp would point at the old
+            // copy.
+            if (slots_[next].exported) {
+                envp_dirty_ = true;
+            }
+            slots_[index] = slots_[next];
+            slots_[next].used = false;
+            index = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    return true;
+}
+
+std::size_t VariableStore::size() const noexcept { return size_; }
+
+std::vector<VariableStore::Variable> VariableStore::variables() const {
+    std::vector<Variable> variables;
+    variables.reserve(size_);
+    for (const Slot &slot : slots_) {
+        if (!slot.used) {
+            continue;
+        }
+
+        Variable variable{.name = slot.name(), .value = std::nullopt, .exported = slot.exported};
+        if (slot.has_value) {
+            variable.value = slot.value();
+        }
+        variables.push_back(variable);
+    }
+
+    std::ranges::sort(variables, {}, &Variable::name);
+    return variables;
+}
+
+char *const *VariableStore::envp() {
+    if (envp_dirty_) {
+        envp_.clear();
+        for (Slot &slot : slots_) {
+            if (slot.used && slot.exported && slot.has_value) {
+                envp_.push_back(slot.text());
+            }
+        }
+        envp_.push_back(nullptr);
+        envp_dirty_ = false;
+    }
+
+    return envp_.data();
+}
+
+std::uint32_t VariableStore::hash_name(std::string_view name) noexcept {
+    // FNV-1a: names are short, so a byte-at-a-time hash is all they need.
+    std::uint32_t hash = 2166136261U;
+    for (const char value : name) {
+        hash ^= static_cast<unsigned char>(value);
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+std::size_t VariableStore::find(std::string_view name, std::uint32_t hash) const noexcept {
+    if (slots_.empty()) {
+        return 0;
+    }
+
+    const std::size_t mask = slots_.size() - 1;
+    for (std::size_t index = hash & mask; slots_[index].used; index = (index + 1) & mask) {
+        if (slots_[index].hash == hash && slots_[index].name() == name) {
+            return index;
+        }
+    }
+    return slots_.size();
+}
+
+VariableStore::Slot &VariableStore::insert(std::string_view name, std::uint32_t hash) {
+    // Keep the table at most three quarters full so probe runs stay short.
+    if ((size_ + 1) * 4 > slots_.size() * 3) {
+        grow();
+    }
+
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t index = hash & mask;
+    while (slots_[index].used) {
+        index = (index + 1) & mask;
+    }
+
+    Slot &slot = slots_[index];
+    slot = Slot{};
+    slot.hash = hash;
+    slot.used = true;
+    write_text(slot, name, std::nullopt);
+    ++size_;
+    return slot;
+}
+
+void VariableStore::grow() {
+    std::vector<Slot> old = std::exchange(slots_, std::vector<Slot>(std::max(min_slots, slots_.size() * 2)));
+
+    // Slots are plain data, so a copy hands heap text over with the slot.
+    const std::size_t mask = slots_.size() - 1;
+    for (const Slot &slot : old) {
+        if (!slot.used) {
+            continue;
+        }
+
+        std::size_t index = slot.hash & mask;
+        while (slots_[index].used) {
+            index = (index + 1) & mask;
+        }
+        slots_[index] = slot;
+    }
+
+    envp_dirty_ = true;
+}
+
+void VariableStore::write_text(Slot &slot, std::string_view name, std::optional<std::string_view> value) {
+    const std::size_t size = name.size() + (value ? value->size() + 1 : 0);
+    const std::size_t capacity = slot.capacity == 0 ? inline_capacity : slot.capacity;
+
+    if (size + 1 > capacity) {
+        // Grow geometrically so a variable that keeps being appended to does
+        // not reallocate on every assignment.
+        const std::size_t grown = std::max(size + 1, capacity * 2);
+        char *text = new char[grown];
+        std::memcpy(text, slot.text(), slot.name_size);
+        release(slot);
+        slot.heap_text = text;
+        slot.capacity = static_cast<std::uint32_t>(grown);
+    }
+
+    char *text = slot.text();
+    if (slot.name_size != name.size()) {
+        std::memcpy(text, name.data(), name.size());
+        slot.name_size = static_cast<std::uint32_t>(name.size());
+    }
+
+    if (value) {
+        text[name.size()] = '=';
+        std::memcpy(text + name.size() + 1, value->data(), value->size());
+    }
+    text[size] = '\0';
+    slot.size = static_cast<std::uint32_t>(size);
+    slot.has_value = value.has_value();
+}
+
+void VariableStore::release(Slot &slot) noexcept {
+    if (slot.capacity != 0) {
+        delete[] slot.heap_text;
+        slot.capacity = 0;
+    }
+}
+
+ScopedAssignments::ScopedAssignments(VariableStore &variables, std::span<const Assignment> assignments)
+    : variables_(variables) {
+    saved_.reserve(assignments.size());
+    for (const auto &assignment : assignments) {
+        const auto value = variables_.get(assignment.name);
+        const bool exported = variables_.exported(assignment.name);
+        saved_.push_back(Saved{
+            .name = std::string(assignment.name),
+            .value = value.has_value() ? std::optional<std::string>(*value) : std::nullopt,
+            .exported = exported,
+        });
+
+        variables_.set(assignment.name, assignment.value);
+        variables_.set_exported(assignment.name, true);
+    }
+}
+
+// In reverse, so a name assigned twice ends up with its original value.
+ScopedAssignments::~ScopedAssignments() {
+    for (auto saved = saved_.rbegin(); saved != saved_.rend(); ++saved) {
+        if (!saved->value.has_value()) {
+            variables_.unset(saved->name);
+            if (saved->exported) {
+                variables_.set_exported(saved->name, true);
+            }
+            continue;
+        }
+
+        variables_.set(saved->name, *saved->value);
+        variables_.set_exported(saved->name, saved->exported);
+    }
+}
+
+} // namespace shell
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core/command.hpp"
+
+namespace shell {
+
+// Shell variables in a flat open-addressing table. Each slot keeps its
+// variable as the `NAME=value` text execve() wants, inline when it is short,
+// so a typical lookup or assignment touches one slot and no allocation, and
+// exported variables are handed to children without copying. The envp array
+// is cached and rebuilt only after an exported variable has changed.
+class VariableStore {
+  public:
+    struct Variable {
+        std::string_view name;
+        // Unset for a name that is only marked for export.
+        std::optional<std::string_view> value;
+        bool exported;
+    };
+
+    VariableStore() = default;
+    // Imports `NAME=value` entries, such as environ, as exported variables.
+    explicit VariableStore(char *const *environment);
+    ~VariableStore();
+
+    VariableStore(const VariableStore &) = delete;
+    VariableStore &operator=(const VariableStore &) = delete;
+
+    [[nodiscard]] static bool valid_name(std::string_view name) noexcept;
+
+    // Views stay valid until the store next changes.
+    [[nodiscard]] std::optional<std::string_view> get(std::string_view name) const noexcept;
+    [[nodiscard]] bool exported(std::string_view name) const noexcept;
+
+    // Assigns a value; an exported variable stays exported. `value` must not
+    // point into the store.
+    void set(std::string_view name, std::string_view value);
+    // A name exported before it has a value is passed on once it gets one.
+    void set_exported(std::string_view name, bool exported);
+    // Returns false if there was no such variable.
+    bool unset(std::string_view name);
+
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    // Every variable, sorted by name.
+    [[nodiscard]] std::vector<Variable> variables() const;
+
+    // Null-terminated `NAME=value` array of the exported variables with a
+    // value, valid until the store next changes.
+    [[nodiscard]] char *const *envp();
+
+  private:
+    static constexpr std::size_t inline_capacity = 40;
+    static constexpr std::size_t min_slots = 16;
+
+    struct Slot {
+        std::uint32_t hash;
+        std::uint32_t name_size;
+        // Of the text without its terminator: the name alone while there is
+        // no value.
+        std::uint32_t size;
+        // Of the heap buffer; 0 while the text is inline.
+        std::uint32_t capacity;
+        bool used;
+        bool exported;
+        bool has_value;
+        union {
+            char inline_text[inline_capacity];
+            char *heap_text;
+        };
+
+        [[nodiscard]] char *text() noexcept { return capacity == 0 ? inline_text : heap_text; }
+        [[nodiscard]] const char *text() const noexcept { return capacity == 0 ? inline_text : heap_text; }
+        [[nodiscard]] std::string_view name() const noexcept { return {text(), name_size}; }
+        [[nodiscard]] std::string_view value() const noexcept {
+            return {text() + name_size + 1, size - name_size - 1};
+        }
+    };
+
+    static_assert(sizeof(Slot) == 64);
+
+    std::vector<Slot> slots_;
+    std::size_t size_{0};
+    std::vector<char *> envp_{nullptr};
+    bool envp_dirty_{false};
+
+    [[nodiscard]] static std::uint32_t hash_name(std::string_view name) noexcept;
+    [[nodiscard]] std::size_t find(std::string_view name, std::uint32_t hash) const noexcept;
+    [[nodiscard]] Slot &insert(std::string_view name, std::uint32_t hash);
+    void grow();
+    static void write_text(Slot &slot, std::string_view name, std::optional<std::string_view> value);
+    static void release(Slot &slot) noexcept;
+};
+
+// Applies the assignments before a builtin's name, exported, for as long as
+// the builtin runs, and puts back what they replaced when it goes out of
+// scope.
+class ScopedAssignments {
+  public:
+    ScopedAssignments(VariableStore &variables, std::span<const Assignment> assignments);
+    ~ScopedAssignments();
+
+    ScopedAssignments(const ScopedAssignments &) = delete;
+    ScopedAssignments &operator=(const ScopedAssignments &) = delete;
+
+  private:
+    struct Saved {
+        std::string name;
+        std::optional<std::string> value;
+        bool exported;
+    };
+
+    VariableStore &variables_;
+    std::vector<Saved> saved_;
+};
+
+} // namespace shell
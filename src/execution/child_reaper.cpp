@@ -0,0 +1,231 @@
+#include "execution/child_reaper.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/trace.hpp"
+
+#if defined(SYS_pidfd_open) && defined(SYS_pidfd_send_signal)
+#define SHELL_HAVE_PIDFD 1
+#endif
+
+namespace shell {
+
+namespace {
+
+constexpr auto kill_grace = std::chrono::milliseconds(500);
+
+// Owns a descriptor for the duration of one reap.
+class UniqueFd {
+  public:
+    explicit UniqueFd(int fd = -1) noexcept : fd_(fd) {}
+    ~UniqueFd() { reset(); }
+
+    UniqueFd(UniqueFd &&other) noexcept : fd_(other.fd_) { other.fd_ = -1; }
+    UniqueFd &operator=(UniqueFd &&) = delete;
+    UniqueFd(const UniqueFd &) = delete;
+    UniqueFd &operator=(const UniqueFd &) = delete;
+
+    [[nodiscard]] int get() const noexcept { return fd_; }
+
+    void reset() noexcept {
+        if (fd_ != -1) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+  private:
+    int fd_;
+};
+
+void wait_in_order(std::span<const pid_t> pids, std::span<ChildExit> exits) {
+    for (std::size_t i = 0; i < pids.size(); ++i) {
+        if (pids[i] == -1) {
+            continue;
+        }
+
+        int status = 0;
+        rusage usage{};
+        while (wait4(pids[i], &status, 0, &usage) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error("waitpid failed");
+        }
+
+        exits[i] = ChildExit{.status = exit_code_from_wait_status(status), .usage = ResourceUsage::from_rusage(usage)};
+    }
+}
+
+#ifdef SHELL_HAVE_PIDFD
+
+struct WatchedChild {
+    std::size_t index;
+    UniqueFd pidfd;
+};
+
+// The raw waitid system call, unlike the C library wrapper, also hands back
+// the child's rusage.
+[[nodiscard]] ChildExit reap_pidfd(int pidfd) {
+    siginfo_t info{};
+    rusage usage{};
+    while (syscall(SYS_waitid, P_PIDFD, pidfd, &info, WEXITED, &usage) == -1) {
+        if (errno == EINTR) {
+            continue;
+        }
+
+        throw std::runtime_error("waitid failed");
+    }
+
+    int status = 1;
+    if (info.si_code == CLD_EXITED) {
+        status = info.si_status;
+    } else if (info.si_code == CLD_KILLED || info.si_code == CLD_DUMPED) {
+        status = 128 + info.si_status;
+    }
+
+    return ChildExit{.status = status, .usage = ResourceUsage::from_rusage(usage)};
+}
+
+void signal_running(std::span<const WatchedChild> children, int signal) noexcept {
+    for (const auto &child : children) {
+        if (child.pidfd.get() != -1) {
+            syscall(SYS_pidfd_send_signal, child.pidfd.get(), signal, nullptr, 0);
+        }
+    }
+}
+
+// Returns false, having reaped nothing, if pidfds or epoll are unavailable.
+[[nodiscard]] bool reap_with_epoll(
+    std::span<const pid_t> pids, std::span<ChildExit> exits, std::chrono::milliseconds timeout, bool &timed_out) {
+    const UniqueFd epoll(epoll_create1(EPOLL_CLOEXEC));
+    if (epoll.get() == -1) {
+        return false;
+    }
+
+    std::vector<WatchedChild> children;
+    children.reserve(pids.size());
+    for (std::size_t i = 0; i < pids.size(); ++i) {
+        if (pids[i] == -1) {
+            continue;
+        }
+
+        // The child is not reaped yet, so its pid cannot have been reused.
+        UniqueFd pidfd(static_cast<int>(syscall(SYS_pidfd_open, pids[i], 0)));
+        if (pidfd.get() == -1) {
+            return false;
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = children.size();
+        if (epoll_ctl(epoll.get(), EPOLL_CTL_ADD, pidfd.get(), &event) == -1) {
+            return false;
+        }
+
+        children.push_back(WatchedChild{.index = i, .pidfd = std::move(pidfd)});
+    }
+
+    using Clock = std::chrono::steady_clock;
+    std::optional<Clock::time_point> deadline;
+    if (timeout > std::chrono::milliseconds::zero()) {
+        deadline = Clock::now() + timeout;
+    }
+
+    std::size_t running = children.size();
+    std::array<epoll_event, 16> events{};
+    while (running > 0) {
+        int wait_ms = -1;
+        if (deadline.has_value()) {
+            const auto left = std::chrono::ceil<std::chrono::milliseconds>(*deadline - Clock::now());
+            wait_ms = static_cast<int>(std::max<std::chrono::milliseconds::rep>(left.count(), 0));
+        }
+
+        const int ready = epoll_wait(epoll.get(), events.data(), static_cast<int>(events.size()), wait_ms);
+        if (ready == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            throw std::runtime_error("epoll_wait failed");
+        }
+
+        if (ready == 0) {
+            if (!timed_out) {
+                timed_out = true;
+                signal_running(children, SIGTERM);
+                deadline = Clock::now() + kill_grace;
+            } else {
+                signal_running(children, SIGKILL);
+                deadline.reset();
+            }
+            continue;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            auto &child = children[static_cast<std::size_t>(events[static_cast<std::size_t>(i)].data.u64)];
+            exits[child.index] = reap_pidfd(child.pidfd.get());
+            // Closing the pidfd also drops it from the epoll set.
+            child.pidfd.reset();
+            --running;
+        }
+    }
+
+    return true;
+}
+
+#endif
+
+} // namespace
+
+int exit_code_from_wait_status(int status) noexcept {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+
+    return 1;
+}
+
+bool reap_children(std::span<const pid_t> pids, std::span<ChildExit> exits, std::chrono::milliseconds timeout) {
+    const TraceSpan span("wait");
+    bool timed_out = false;
+
+#ifdef SHELL_HAVE_PIDFD
+    const auto children = std::ranges::count_if(pids, [](pid_t pid) { return pid != -1; });
+    if ((children > 1 || timeout > std::chrono::milliseconds::zero()) &&
+        reap_with_epoll(pids, exits, timeout, timed_out)) {
+        return timed_out;
+    }
+#endif
+
+    wait_in_order(pids, exits);
+    return timed_out;
+}
+
+void child_exit(int status) {
+    std::cout.flush();
+    std::cerr.flush();
+    _exit(status);
+}
+
+} // namespace shell
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <span>
+#include <sys/types.h>
+
+#include "execution/resource_usage.hpp"
+
+namespace shell {
+
+// How a child process ended: its status as `$?` reports it, and what it used.
+struct ChildExit {
+    int status{1};
+    ResourceUsage usage;
+};
+
+// `$?` for a raw wait status: the exit code, or 128 + the terminating signal.
+[[nodiscard]] int exit_code_from_wait_status(int status) noexcept;
+
+// Reaps every child in `pids` and stores how each ended in `exits` at the
+// same index; entries of -1 are skipped and their exits left alone.
+//
+// Children are reaped in the order they finish: each gets a pidfd, and one
+// epoll set waits on all of them, so a stage that hangs does not hold up the
+// statuses of the others. A non-zero `timeout` bounds the whole wait: children
+// still running at the deadline get SIGTERM, and SIGKILL if they outlive a
+// short grace period. Signals go through the pidfd, so they can never reach a
+// process that reused a pid. Returns true if the timeout fired.
+//
+// A lone child with no timeout is simply waited for. Without pidfd support
+// (Linux before 5.3) children are waited for in order and the timeout is not
+// enforced.
+bool reap_children(std::span<const pid_t> pids, std::span<ChildExit> exits, std::chrono::milliseconds timeout = {});
+
+// Ends a forked child of the shell. The standard streams are flushed and the
+// child leaves through _exit, so its copy of the shell does not run atexit
+// handlers or static destructors (saving history, finishing the trace) that
+// belong to the parent.
+[[noreturn]] void child_exit(int status);
+
+} // namespace shell
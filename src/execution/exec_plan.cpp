@@ -0,0 +1,202 @@
+#include "execution/exec_plan.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <span>
+
+#include <unistd.h>
+
+namespace shell {
+
+namespace {
+
+constexpr char fallback_shell_path[] = "/bin/sh";
+
+char *copy_string(char *&cursor, std::string_view value) noexcept {
+    char *start = cursor;
+    std::memcpy(cursor, value.data(), value.size());
+    cursor += value.size();
+    *cursor++ = '\0';
+    return start;
+}
+
+char *copy_assignment(char *&cursor, const Assignment &assignment) noexcept {
+    char *start = cursor;
+    std::memcpy(cursor, assignment.name.data(), assignment.name.size());
+    cursor += assignment.name.size();
+    *cursor++ = '=';
+    copy_string(cursor, assignment.value);
+    return start;
+}
+
+[[nodiscard]] bool assigns(std::span<const Assignment> assignments, std::string_view name) noexcept {
+    return std::ranges::any_of(assignments, [name](const Assignment &assignment) { return assignment.name == name; });
+}
+
+// Whether an inherited `NAME=value` entry sets one of the assigned names.
+[[nodiscard]] bool overridden(const char *entry, std::span<const Assignment> assignments) noexcept {
+    return std::ranges::any_of(assignments, [entry](const Assignment &assignment) {
+        const std::size_t size = assignment.name.size();
+        return std::strncmp(entry, assignment.name.data(), size) == 0 && entry[size] == '=';
+    });
+}
+
+// Room for what the kernel copies next to argv and envp: the executable's
+// path, the auxiliary vector and the alignment padding.
+constexpr std::size_t exec_headroom = 4096;
+
+} // namespace
+
+ExecPlan::ExecPlan(std::string_view path, const Command &command, char *const *envp)
+    : ExecPlan(path, command, command.args, envp) {}
+
+ExecPlan::ExecPlan(std::string_view path,
+                   const Command &command,
+                   std::span<const std::string_view> args,
+                   char *const *envp)
+    : envp_(envp), argc_(args.size() + 1) {
+    // Slot 0 is reserved for the /bin/sh fallback, argv starts at slot 1 and
+    // is followed by the terminating nullptr.
+    const std::size_t slot_count = argc_ + 2;
+
+    std::size_t string_bytes = path.size() + 1 + command.name.size() + 1;
+    for (const auto &arg : args) {
+        string_bytes += arg.size() + 1;
+    }
+
+    // The overlaid envp follows argv: every inherited entry the assignments
+    // leave alone, then the assignments, then the terminating nullptr.
+    std::size_t inherited = 0;
+    std::size_t env_slot_count = 0;
+    if (!command.assignments.empty()) {
+        while (envp[inherited] != nullptr) {
+            ++inherited;
+        }
+        env_slot_count = inherited + command.assignments.size() + 1;
+        for (const auto &assignment : command.assignments) {
+            string_bytes += assignment.name.size() + 1 + assignment.value.size() + 1;
+        }
+    }
+
+    storage_ = std::make_unique_for_overwrite<std::byte[]>((slot_count + env_slot_count) * sizeof(char *) +
+                                                           string_bytes);
+    slots_ = reinterpret_cast<char **>(storage_.get());
+
+    char *cursor = reinterpret_cast<char *>(slots_ + slot_count + env_slot_count);
+    path_ = copy_string(cursor, path);
+
+    if (env_slot_count != 0) {
+        const std::span<const Assignment> assignments(command.assignments);
+        char **env = slots_ + slot_count;
+        std::size_t used = 0;
+        for (std::size_t i = 0; i < inherited; ++i) {
+            if (!overridden(envp[i], assignments)) {
+                env[used++] = envp[i];
+            }
+        }
+        // The last assignment to a name wins.
+        for (std::size_t i = 0; i < assignments.size(); ++i) {
+            if (!assigns(assignments.subspan(i + 1), assignments[i].name)) {
+                env[used++] = copy_assignment(cursor, assignments[i]);
+            }
+        }
+        env[used] = nullptr;
+        envp_ = env;
+    }
+
+    slots_[0] = nullptr;
+    name_ = copy_string(cursor, command.name);
+    slots_[1] = name_;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        slots_[i + 2] = copy_string(cursor, args[i]);
+    }
+    slots_[slot_count - 1] = nullptr;
+}
+
+const char *ExecPlan::path() const noexcept { return path_; }
+
+char *const *ExecPlan::argv() const noexcept { return slots_ + 1; }
+
+char *const *ExecPlan::envp() const noexcept { return envp_; }
+
+std::size_t ExecPlan::argc() const noexcept { return argc_; }
+
+std::size_t ExecPlan::exec_size() const noexcept {
+    std::size_t size = 0;
+    for (char *const *arg = argv(); *arg != nullptr; ++arg) {
+        size += exec_argument_size(*arg);
+    }
+    for (char *const *entry = envp_; *entry != nullptr; ++entry) {
+        size += exec_argument_size(*entry);
+    }
+    return size;
+}
+
+void ExecPlan::exec() const noexcept {
+    execve(path_, argv(), envp_);
+    if (errno != ENOEXEC) {
+        return;
+    }
+
+    // Mirror execvp: hand scripts without a shebang to the system shell.
+    use_shell_fallback(true);
+    execve(fallback_shell_path, slots_, envp_);
+
+    const int saved_errno = errno;
+    use_shell_fallback(false);
+    errno = saved_errno;
+}
+
+int ExecPlan::spawn(pid_t &pid, const posix_spawn_file_actions_t *file_actions) const noexcept {
+    int error = posix_spawn(&pid, path_, file_actions, nullptr, argv(), envp_);
+    if (error != ENOEXEC) {
+        return error;
+    }
+
+    use_shell_fallback(true);
+    error = posix_spawn(&pid, fallback_shell_path, file_actions, nullptr, slots_, envp_);
+    use_shell_fallback(false);
+    return error;
+}
+
+std::size_t exec_size_limit() noexcept {
+    const long arg_max = sysconf(_SC_ARG_MAX);
+    const auto limit = arg_max > 0 ? static_cast<std::size_t>(arg_max) : std::size_t{_POSIX_ARG_MAX};
+    return limit > 2 * exec_headroom ? limit - exec_headroom : limit / 2;
+}
+
+std::vector<std::span<const std::string_view>>
+split_arguments(std::span<const std::string_view> args, std::size_t fixed_size, std::size_t limit) {
+    std::vector<std::span<const std::string_view>> runs;
+    std::size_t begin = 0;
+    std::size_t size = fixed_size;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        const std::size_t arg_size = exec_argument_size(args[i]);
+        if (i > begin && size + arg_size > limit) {
+            runs.push_back(args.subspan(begin, i - begin));
+            begin = i;
+            size = fixed_size;
+        }
+        size += arg_size;
+    }
+
+    if (begin < args.size()) {
+        runs.push_back(args.subspan(begin));
+    }
+    return runs;
+}
+
+void ExecPlan::use_shell_fallback(bool enabled) const noexcept {
+    // slot 0 becomes argv[0] for the shell and the script path replaces the
+    // command name, giving `/bin/sh path args...`.
+    if (enabled) {
+        slots_[0] = const_cast<char *>(fallback_shell_path);
+        slots_[1] = const_cast<char *>(path_);
+    } else {
+        slots_[0] = nullptr;
+        slots_[1] = name_;
+    }
+}
+
+} // namespace shell
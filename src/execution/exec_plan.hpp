@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <spawn.h>
+#include <sys/types.h>
+
+#include "core/command.hpp"
+
+extern "C" char **environ;
+
+namespace shell {
+
+// Everything a child needs to replace itself with an external command, built in
+// the parent so the post-fork path performs no PATH lookup and no allocation.
+// The resolved path and the argv strings live in a single heap block together
+// with the argv pointer array; envp is borrowed and must outlive the plan.
+// Assignments before the command name are overlaid on a copy of envp's
+// pointers in the same block, so the strings of the variables they leave
+// alone are never copied.
+class ExecPlan {
+  public:
+    ExecPlan(std::string_view path, const Command &command, char *const *envp = environ);
+    // Runs the command with `args` in place of its own arguments.
+    ExecPlan(std::string_view path, const Command &command, std::span<const std::string_view> args, char *const *envp);
+
+    ExecPlan(ExecPlan &&) noexcept = default;
+    ExecPlan &operator=(ExecPlan &&) noexcept = default;
+
+    [[nodiscard]] const char *path() const noexcept;
+    [[nodiscard]] char *const *argv() const noexcept;
+    [[nodiscard]] char *const *envp() const noexcept;
+    [[nodiscard]] std::size_t argc() const noexcept;
+
+    // What an exec of this plan charges against ARG_MAX: every argv and envp
+    // string with its NUL, plus a pointer for each.
+    [[nodiscard]] std::size_t exec_size() const noexcept;
+
+    // Only returns if the exec failed, leaving errno set. Files without a
+    // recognised executable format are retried through /bin/sh like execvp.
+    void exec() const noexcept;
+
+    // posix_spawn counterpart of exec(): stores the child's pid and returns 0,
+    // or returns the error reported for the spawn or the exec.
+    [[nodiscard]] int spawn(pid_t &pid, const posix_spawn_file_actions_t *file_actions) const noexcept;
+
+  private:
+    std::unique_ptr<std::byte[]> storage_;
+    char **slots_{nullptr};
+    const char *path_{nullptr};
+    char *name_{nullptr};
+    char *const *envp_{nullptr};
+    std::size_t argc_{0};
+
+    void use_shell_fallback(bool enabled) const noexcept;
+};
+
+// ARG_MAX for the current stack limit, less headroom for what the kernel puts
+// next to argv and envp (the executable's path, the auxiliary vector).
+[[nodiscard]] std::size_t exec_size_limit() noexcept;
+
+// What one argument adds to ExecPlan::exec_size().
+[[nodiscard]] constexpr std::size_t exec_argument_size(std::string_view arg) noexcept {
+    return arg.size() + 1 + sizeof(char *);
+}
+
+// Splits `args` into consecutive runs that each keep an exec under `limit`
+// bytes, given the `fixed_size` every exec costs without them. An argument
+// too large to fit even on its own still gets a run, so that its exec fails
+// with E2BIG rather than the argument being dropped.
+[[nodiscard]] std::vector<std::span<const std::string_view>>
+split_arguments(std::span<const std::string_view> args, std::size_t fixed_size, std::size_t limit);
+
+} // namespace shell
@@ -0,0 +1,115 @@
+#include "execution/fd_writer.hpp"
+
+#include <cerrno>
+
+#include <sys/uio.h>
+
+namespace shell {
+
+FdWriter::FdWriter(int fd, std::size_t capacity)
+    : fd_(fd), capacity_(capacity > 0 ? capacity : default_capacity),
+      buffer_(std::make_unique_for_overwrite<char[]>(capacity_)) {
+    setp(buffer_.get(), buffer_.get() + capacity_);
+}
+
+FdWriter::~FdWriter() { (void)write_out(nullptr, 0); }
+
+int FdWriter::fd() const noexcept { return fd_; }
+
+int FdWriter::error() const noexcept { return error_; }
+
+FdWriter::int_type FdWriter::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof())) {
+        return write_out(nullptr, 0) ? traits_type::not_eof(ch) : traits_type::eof();
+    }
+
+    const char c = traits_type::to_char_type(ch);
+    return write_out(&c, 1) ? ch : traits_type::eof();
+}
+
+std::streamsize FdWriter::xsputn(const char_type *data, std::streamsize count) {
+    const auto size = static_cast<std::size_t>(count);
+    const auto available = static_cast<std::size_t>(epptr() - pptr());
+
+    if (size <= available) {
+        traits_type::copy(pptr(), data, size);
+        pbump(static_cast<int>(size));
+        return count;
+    }
+
+    return write_out(data, size) ? count : 0;
+}
+
+int FdWriter::sync() { return write_out(nullptr, 0) ? 0 : -1; }
+
+bool FdWriter::write_out(const char *data, std::size_t size) noexcept {
+    iovec chunks[2] = {
+        {.iov_base = pbase(), .iov_len = static_cast<std::size_t>(pptr() - pbase())},
+        {.iov_base = const_cast<char *>(data), .iov_len = size},
+    };
+    setp(buffer_.get(), buffer_.get() + capacity_);
+
+    if (error_ != 0) {
+        return false;
+    }
+
+    iovec *pending = chunks;
+    int pending_count = 2;
+    while (pending_count > 0) {
+        if (pending->iov_len == 0) {
+            ++pending;
+            --pending_count;
+            continue;
+        }
+
+        const ssize_t written = writev(fd_, pending, pending_count);
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            error_ = errno;
+            return false;
+        }
+
+        auto remaining = static_cast<std::size_t>(written);
+        while (pending_count > 0 && remaining >= pending->iov_len) {
+            remaining -= pending->iov_len;
+            ++pending;
+            --pending_count;
+        }
+
+        if (pending_count > 0) {
+            pending->iov_base = static_cast<char *>(pending->iov_base) + remaining;
+            pending->iov_len -= remaining;
+        }
+    }
+
+    return true;
+}
+
+FdOutputStream::FdOutputStream(int fd, std::size_t capacity) : std::ostream(nullptr), writer_(fd, capacity) {
+    rdbuf(&writer_);
+}
+
+FdWriter &FdOutputStream::writer() noexcept { return writer_; }
+
+StringWriter::StringWriter(std::string &target) noexcept : target_(target) {}
+
+StringWriter::int_type StringWriter::overflow(int_type ch) {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        target_ += traits_type::to_char_type(ch);
+    }
+    return traits_type::not_eof(ch);
+}
+
+std::streamsize StringWriter::xsputn(const char_type *data, std::streamsize count) {
+    target_.append(data, static_cast<std::size_t>(count));
+    return count;
+}
+
+StringOutputStream::StringOutputStream(std::string &target) : std::ostream(nullptr), writer_(target) {
+    rdbuf(&writer_);
+}
+
+} // namespace shell
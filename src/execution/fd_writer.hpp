@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace shell {
+
+// Stream buffer that writes straight to a file descriptor. Output is collected
+// in a fixed buffer and written when the buffer fills, on flush, or when the
+// writer is destroyed; a write larger than the free space goes out together
+// with the buffered bytes in a single writev(). Nothing is written per line.
+class FdWriter final : public std::streambuf {
+  public:
+    static constexpr std::size_t default_capacity = 64 * 1024;
+
+    explicit FdWriter(int fd, std::size_t capacity = default_capacity);
+    ~FdWriter() override;
+
+    FdWriter(const FdWriter &) = delete;
+    FdWriter &operator=(const FdWriter &) = delete;
+
+    [[nodiscard]] int fd() const noexcept;
+
+    // errno of the first failed write, or 0. Output after a failure is dropped.
+    [[nodiscard]] int error() const noexcept;
+
+  protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type *data, std::streamsize count) override;
+    int sync() override;
+
+  private:
+    int fd_;
+    int error_{0};
+    std::size_t capacity_;
+    std::unique_ptr<char[]> buffer_;
+
+    // Writes the buffered bytes followed by `data`.
+    bool write_out(const char *data, std::size_t size) noexcept;
+};
+
+// std::ostream over an FdWriter, for passing to code that takes std::ostream&.
+class FdOutputStream final : public std::ostream {
+  public:
+    explicit FdOutputStream(int fd, std::size_t capacity = FdWriter::default_capacity);
+
+    [[nodiscard]] FdWriter &writer() noexcept;
+
+  private:
+    FdWriter writer_;
+};
+
+// Stream buffer that appends straight to a string the caller owns, for output
+// the shell keeps rather than writes anywhere, such as that of a builtin in a
+// command substitution.
+class StringWriter final : public std::streambuf {
+  public:
+    explicit StringWriter(std::string &target) noexcept;
+
+  protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type *data, std::streamsize count) override;
+
+  private:
+    std::string &target_;
+};
+
+// std::ostream over a StringWriter.
+class StringOutputStream final : public std::ostream {
+  public:
+    explicit StringOutputStream(std::string &target);
+
+  private:
+    StringWriter writer_;
+};
+
+} // namespace shell
@@ -0,0 +1,155 @@
+#include "execution/here_document.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace shell {
+
+namespace {
+
+// Writes `first` and then `second` in as few writev() calls as the descriptor
+// allows.
+[[nodiscard]] bool write_all(int fd, std::string_view first, std::string_view second) noexcept {
+    std::array<iovec, 2> parts{{
+        {.iov_base = const_cast<char *>(first.data()), .iov_len = first.size()},
+        {.iov_base = const_cast<char *>(second.data()), .iov_len = second.size()},
+    }};
+    std::size_t next = 0;
+
+    while (next < parts.size()) {
+        if (parts[next].iov_len == 0) {
+            ++next;
+            continue;
+        }
+
+        const ssize_t written = writev(fd, &parts[next], static_cast<int>(parts.size() - next));
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        auto remaining = static_cast<std::size_t>(written);
+        while (next < parts.size() && remaining >= parts[next].iov_len) {
+            remaining -= parts[next].iov_len;
+            ++next;
+        }
+        if (next < parts.size()) {
+            parts[next].iov_base = static_cast<char *>(parts[next].iov_base) + remaining;
+            parts[next].iov_len -= remaining;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+HereDocument::HereDocument() = default;
+
+HereDocument::~HereDocument() { close_fd(); }
+
+HereDocument::HereDocument(HereDocument &&other) noexcept
+    : buffer_(std::move(other.buffer_)), fd_(std::exchange(other.fd_, -1)), error_(std::move(other.error_)) {}
+
+void HereDocument::append(std::string_view text) {
+    if (!error_.empty()) {
+        return;
+    }
+
+    if (buffer_.size() + text.size() <= buffer_capacity) {
+        buffer_.append(text);
+        return;
+    }
+
+    spill(text);
+}
+
+int HereDocument::finish() {
+    if (!error_.empty()) {
+        return -1;
+    }
+
+    if (fd_ == -1 && buffer_.size() <= pipe_limit) {
+        std::array<int, 2> pipe_fds{};
+        if (pipe2(pipe_fds.data(), O_CLOEXEC) == -1) {
+            fail("pipe");
+            return -1;
+        }
+
+        const bool written = write_all(pipe_fds[1], buffer_, {});
+        close(pipe_fds[1]);
+        fd_ = pipe_fds[0];
+        if (!written) {
+            fail("write");
+            return -1;
+        }
+
+        buffer_.clear();
+        return fd_;
+    }
+
+    spill({});
+    if (!error_.empty()) {
+        return -1;
+    }
+
+    // Sealed, the body cannot change under a reader, even one that was handed
+    // the descriptor read-write.
+    if (fcntl(fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+        fail("sealing");
+        return -1;
+    }
+
+    if (lseek(fd_, 0, SEEK_SET) == -1) {
+        fail("lseek");
+        return -1;
+    }
+
+    return fd_;
+}
+
+int HereDocument::release() noexcept { return std::exchange(fd_, -1); }
+
+const std::string &HereDocument::error() const noexcept { return error_; }
+
+void HereDocument::spill(std::string_view text) {
+    if (fd_ == -1) {
+        fd_ = memfd_create("here-document", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd_ == -1) {
+            fail("memfd_create");
+            return;
+        }
+    }
+
+    if (!write_all(fd_, buffer_, text)) {
+        fail("write");
+        return;
+    }
+
+    buffer_.clear();
+}
+
+void HereDocument::fail(std::string_view operation) {
+    error_ = std::format("here-document: {} failed: {}", operation, std::strerror(errno));
+    buffer_ = {};
+    close_fd();
+}
+
+void HereDocument::close_fd() noexcept {
+    if (fd_ != -1) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+} // namespace shell
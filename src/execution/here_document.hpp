@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace shell {
+
+// Body of a here-document or here-string, turned into a descriptor that a
+// command reads as its stdin. Small bodies are written into a pipe that holds
+// them whole. Anything larger goes into a sealed memfd, written a buffer at a
+// time as it is appended, so a large body is never held in the heap and
+// never touches the filesystem.
+class HereDocument {
+  public:
+    // A pipe always has room for at least one page, so a body this small can
+    // be written before anyone reads it.
+    static constexpr std::size_t pipe_limit = 4096;
+    static constexpr std::size_t buffer_capacity = 64 * 1024;
+
+    HereDocument();
+    ~HereDocument();
+
+    HereDocument(HereDocument &&other) noexcept;
+    HereDocument &operator=(HereDocument &&) = delete;
+    HereDocument(const HereDocument &) = delete;
+    HereDocument &operator=(const HereDocument &) = delete;
+
+    // Text after a failed write is dropped; finish() reports the failure.
+    void append(std::string_view text);
+
+    // Ends the body and returns a descriptor that reads it from the start, or
+    // -1 with error() set. The descriptor stays owned by this object.
+    [[nodiscard]] int finish();
+
+    // Hands the descriptor returned by finish() to the caller.
+    [[nodiscard]] int release() noexcept;
+
+    [[nodiscard]] const std::string &error() const noexcept;
+
+  private:
+    // Text not yet written out; never more than buffer_capacity.
+    std::string buffer_;
+    // The memfd once the body has outgrown the buffer, then whatever finish()
+    // returned.
+    int fd_{-1};
+    std::string error_;
+
+    // Writes the buffer and then `text` to the memfd, creating it first.
+    void spill(std::string_view text);
+    void fail(std::string_view operation);
+    void close_fd() noexcept;
+};
+
+} // namespace shell
@@ -0,0 +1,212 @@
+#include "execution/job_table.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <sys/wait.h>
+
+#include "execution/child_reaper.hpp"
+
+namespace shell {
+
+namespace {
+
+volatile std::sig_atomic_t child_signalled = 0;
+
+extern "C" void note_sigchld(int /*signal*/) { child_signalled = 1; }
+
+// Status recorded for a pid the shell can no longer wait for.
+constexpr int lost_child_status = W_EXITCODE(127, 0);
+
+// Waits for one job process. Returns nullopt if it is still running and
+// `block` is false.
+[[nodiscard]] std::optional<int> wait_for(pid_t pid, bool block) {
+    int status = 0;
+    while (true) {
+        const pid_t result = waitpid(pid, &status, block ? 0 : WNOHANG);
+        if (result == pid) {
+            return status;
+        }
+
+        if (result == 0) {
+            return std::nullopt;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        }
+
+        if (errno == ECHILD) {
+            return lost_child_status;
+        }
+
+        throw std::runtime_error("waitpid failed");
+    }
+}
+
+void wait_job_processes(JobTable::Job &job) {
+    for (std::size_t i = 0; i < job.pids.size(); ++i) {
+        if (!job.statuses[i].has_value()) {
+            job.statuses[i] = wait_for(job.pids[i], true);
+        }
+    }
+}
+
+[[nodiscard]] std::string state_text(const JobTable::Job &job) {
+    if (!job.finished()) {
+        return "Running";
+    }
+
+    const int status = *job.statuses.back();
+    if (WIFSIGNALED(status)) {
+        return strsignal(WTERMSIG(status));
+    }
+
+    const int code = exit_code_from_wait_status(status);
+    return code == 0 ? "Done" : std::format("Exit {}", code);
+}
+
+} // namespace
+
+bool JobTable::Job::finished() const noexcept {
+    return std::ranges::all_of(statuses, [](const std::optional<int> &status) { return status.has_value(); });
+}
+
+int JobTable::Job::exit_status() const noexcept {
+    return statuses.empty() || !statuses.back().has_value() ? 0 : exit_code_from_wait_status(*statuses.back());
+}
+
+void JobTable::install_sigchld_handler() {
+    struct sigaction action{};
+    action.sa_handler = note_sigchld;
+    sigemptyset(&action.sa_mask);
+    // Interrupted reads and writes resume on their own; only stops are of no
+    // interest since there is no job control.
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+
+    if (sigaction(SIGCHLD, &action, nullptr) == -1) {
+        throw std::runtime_error("sigaction failed");
+    }
+}
+
+int JobTable::add(std::span<const pid_t> pids, std::string command) {
+    Job job{
+        .id = jobs_.empty() ? 1 : jobs_.back().id + 1,
+        .command = std::move(command),
+        .pids = {pids.begin(), pids.end()},
+        .statuses = std::vector<std::optional<int>>(pids.size()),
+    };
+
+    for (std::size_t i = 0; i < pids.size(); ++i) {
+        if (pids[i] == -1) {
+            job.statuses[i] = W_EXITCODE(1, 0);
+        }
+    }
+
+    jobs_.push_back(std::move(job));
+    return jobs_.back().id;
+}
+
+bool JobTable::empty() const noexcept { return jobs_.empty(); }
+
+std::span<const JobTable::Job> JobTable::jobs() const noexcept { return jobs_; }
+
+void JobTable::reap() {
+    child_signalled = 0;
+
+    for (auto &job : jobs_) {
+        for (std::size_t i = 0; i < job.pids.size(); ++i) {
+            if (!job.statuses[i].has_value()) {
+                job.statuses[i] = wait_for(job.pids[i], false);
+            }
+        }
+    }
+}
+
+void JobTable::reap_if_signalled() {
+    if (child_signalled != 0) {
+        reap();
+    }
+}
+
+std::optional<int> JobTable::wait_job(int id) {
+    const auto job = std::ranges::find(jobs_, id, &Job::id);
+    if (job == jobs_.end()) {
+        return std::nullopt;
+    }
+
+    wait_job_processes(*job);
+    const int status = job->exit_status();
+    jobs_.erase(job);
+    return status;
+}
+
+std::optional<int> JobTable::wait_pid(pid_t pid) {
+    for (auto job = jobs_.begin(); job != jobs_.end(); ++job) {
+        const auto found = std::ranges::find(job->pids, pid);
+        if (found == job->pids.end()) {
+            continue;
+        }
+
+        auto &status = job->statuses[static_cast<std::size_t>(found - job->pids.begin())];
+        if (!status.has_value()) {
+            status = wait_for(pid, true);
+        }
+
+        const int code = exit_code_from_wait_status(*status);
+        if (job->finished()) {
+            jobs_.erase(job);
+        }
+        return code;
+    }
+
+    return std::nullopt;
+}
+
+void JobTable::wait_all() {
+    for (auto &job : jobs_) {
+        wait_job_processes(job);
+    }
+
+    jobs_.clear();
+}
+
+void JobTable::print(std::ostream &out) {
+    for (std::size_t i = 0; i < jobs_.size(); ++i) {
+        print_job(out, i);
+    }
+
+    remove_finished();
+}
+
+void JobTable::report_finished(std::ostream &out) {
+    for (std::size_t i = 0; i < jobs_.size(); ++i) {
+        if (jobs_[i].finished()) {
+            print_job(out, i);
+        }
+    }
+
+    remove_finished();
+}
+
+// The most recent job is marked `+` and the one before it `-`.
+void JobTable::print_job(std::ostream &out, std::size_t index) const {
+    const Job &job = jobs_[index];
+    const char marker = index + 1 == jobs_.size() ? '+' : index + 2 == jobs_.size() ? '-' : ' ';
+    std::format_to(
+        std::ostreambuf_iterator<char>(out), "[{}]{}  {:<24}{}\n", job.id, marker, state_text(job), job.command);
+}
+
+void JobTable::remove_finished() {
+    std::erase_if(jobs_, [](const Job &job) { return job.finished(); });
+}
+
+} // namespace shell
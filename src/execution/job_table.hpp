@@ -0,0 +1,69 @@
+#pragma once
+
+#include <iosfwd>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace shell {
+
+// Background jobs started with `&`. Children are reaped without blocking:
+// SIGCHLD only raises a flag, and the shell collects exit statuses between
+// commands by waiting for the pids it knows, so no work happens in the signal
+// handler and foreground waits for specific pids are never disturbed.
+class JobTable {
+  public:
+    struct Job {
+        int id;
+        std::string command;
+        std::vector<pid_t> pids;
+        // Wait status of each pid once it has been reaped.
+        std::vector<std::optional<int>> statuses;
+
+        [[nodiscard]] bool finished() const noexcept;
+        // Exit status of a finished job: that of its last process.
+        [[nodiscard]] int exit_status() const noexcept;
+    };
+
+    // Installs the SIGCHLD handler that reap_if_signalled() relies on.
+    static void install_sigchld_handler();
+
+    // Records a started job and returns its number. Pids of -1 stand for
+    // stages that could not be started.
+    int add(std::span<const pid_t> pids, std::string command);
+
+    [[nodiscard]] bool empty() const noexcept;
+    [[nodiscard]] std::span<const Job> jobs() const noexcept;
+
+    // Collects every job process that has exited, without blocking.
+    void reap();
+
+    // reap(), but only if a child has changed state since the last call.
+    void reap_if_signalled();
+
+    // Block until the job with this number, or the process with this pid, has
+    // finished and return its exit status; nullopt if the shell has no such
+    // job. A finished job is forgotten.
+    [[nodiscard]] std::optional<int> wait_job(int id);
+    [[nodiscard]] std::optional<int> wait_pid(pid_t pid);
+
+    // Blocks until every job has finished and forgets them all.
+    void wait_all();
+
+    // `jobs`: one line per job. Finished jobs are listed once and forgotten.
+    void print(std::ostream &out);
+
+    // Announces finished jobs the way the interactive prompt does and forgets
+    // them.
+    void report_finished(std::ostream &out);
+
+  private:
+    std::vector<Job> jobs_;
+
+    void print_job(std::ostream &out, std::size_t index) const;
+    void remove_finished();
+};
+
+} // namespace shell
@@ -1,139 +1,747 @@
 #include "execution/process_executor.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cerrno>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <optional>
+#include <ranges>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/resource.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "builtins/builtin_registry.hpp"
 #include "core/path_resolver.hpp"
+#include "core/trace.hpp"
+#include "execution/child_reaper.hpp"
+#include "execution/exec_plan.hpp"
+#include "execution/fd_writer.hpp"
 #include "execution/redirection.hpp"
 
 namespace shell {
 
 namespace {
 
-[[nodiscard]] std::vector<char *> build_argv(const Command &command) {
-    std::vector<char *> argv;
-    argv.reserve(command.args.size() + 2);
+class SpawnFileActions {
+  public:
+    SpawnFileActions() {
+        if (posix_spawn_file_actions_init(&actions_) != 0) {
+            throw std::runtime_error("posix_spawn_file_actions_init failed");
+        }
+    }
+
+    ~SpawnFileActions() { posix_spawn_file_actions_destroy(&actions_); }
+
+    SpawnFileActions(const SpawnFileActions &) = delete;
+    SpawnFileActions &operator=(const SpawnFileActions &) = delete;
+
+    void add_dup2(int source_fd, int target_fd) {
+        if (posix_spawn_file_actions_adddup2(&actions_, source_fd, target_fd) != 0) {
+            throw std::runtime_error("posix_spawn_file_actions_adddup2 failed");
+        }
+    }
+
+    [[nodiscard]] const posix_spawn_file_actions_t *get() const noexcept { return &actions_; }
+
+  private:
+    posix_spawn_file_actions_t actions_{};
+};
+
+// posix_spawn reports clone and exec failures through the same error code.
+// Resource exhaustion is treated like a failed fork; anything else is reported
+// the way a child would report a failed exec. Returns -1 in that case.
+[[nodiscard]] pid_t spawn_or_report(const ExecPlan &plan, const posix_spawn_file_actions_t *file_actions) {
+    const TraceSpan span("spawn", plan.path());
+    pid_t pid = -1;
+    const int error = plan.spawn(pid, file_actions);
+    if (error == 0) {
+        return pid;
+    }
+
+    if (error == EAGAIN || error == ENOMEM) {
+        throw std::runtime_error("spawn failed");
+    }
+
+    std::cerr << "exec failed: " << std::strerror(error) << std::endl;
+    return -1;
+}
+
+// Blocks SIGPIPE for the calling thread so that writing to a pipe whose reader
+// has gone away fails with EPIPE instead of killing the shell. A SIGPIPE raised
+// in the meantime is consumed before the old mask comes back.
+class ScopedSigpipeBlock {
+  public:
+    ScopedSigpipeBlock() noexcept {
+        sigemptyset(&sigpipe_);
+        sigaddset(&sigpipe_, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &sigpipe_, &previous_);
+    }
+
+    ~ScopedSigpipeBlock() {
+        if (sigismember(&previous_, SIGPIPE) == 0) {
+            const timespec no_wait{};
+            while (sigtimedwait(&sigpipe_, nullptr, &no_wait) == SIGPIPE) {
+            }
+        }
+
+        pthread_sigmask(SIG_SETMASK, &previous_, nullptr);
+    }
+
+    ScopedSigpipeBlock(const ScopedSigpipeBlock &) = delete;
+    ScopedSigpipeBlock &operator=(const ScopedSigpipeBlock &) = delete;
+
+  private:
+    sigset_t sigpipe_{};
+    sigset_t previous_{};
+};
+
+// Ties `stream` to a builtin's buffered output for the builtin's run, so that
+// anything written to `stream` first flushes the output written before it and
+// the two reach a shared descriptor in the order the builtin wrote them.
+class ScopedTie {
+  public:
+    ScopedTie(std::ostream &stream, std::ostream &output) : stream_(stream), previous_(stream.tie(&output)) {}
+
+    ~ScopedTie() { stream_.tie(previous_); }
+
+    ScopedTie(const ScopedTie &) = delete;
+    ScopedTie &operator=(const ScopedTie &) = delete;
+
+  private:
+    std::ostream &stream_;
+    std::ostream *previous_;
+};
+
+// Writes as much of `data` as possible and removes it from the front. Returns
+// 0 once everything is written, or the errno that stopped the write (EAGAIN
+// for a full non-blocking pipe).
+[[nodiscard]] int write_some(int fd, std::string_view &data) noexcept {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+
+    return 0;
+}
 
-    argv.push_back(const_cast<char *>(command.name.c_str()));
-    for (const auto &arg : command.args) {
-        argv.push_back(const_cast<char *>(arg.c_str()));
+// Hands the output of an in-process builtin to the next stage's pipe. What fits
+// into the pipe buffer is written right away; only a remainder that would block
+// goes to a writer thread, which owns and closes the descriptor. The result is
+// 0 or the errno of the failed write.
+[[nodiscard]] std::optional<std::future<int>> feed_pipe(int fd, std::string output) {
+    std::string_view pending = output;
+    int error = 0;
+
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1) {
+        ScopedSigpipeBlock sigpipe_block;
+        error = write_some(fd, pending);
+        fcntl(fd, F_SETFL, flags);
+    } else {
+        error = EAGAIN;
     }
-    argv.push_back(nullptr);
 
-    return argv;
+    if (error != EAGAIN) {
+        close(fd);
+        std::promise<int> done;
+        done.set_value(error);
+        return done.get_future();
+    }
+
+    const std::size_t offset = output.size() - pending.size();
+    return std::async(std::launch::async, [fd, offset, output = std::move(output)]() {
+        ScopedSigpipeBlock sigpipe_block;
+        std::string_view rest = std::string_view(output).substr(offset);
+        const int result = write_some(fd, rest);
+        close(fd);
+        return result;
+    });
 }
 
-[[noreturn]] void child_exit(int code) {
-    std::exit(code);
+// Close-on-exec pipes between consecutive stages: stage i writes to
+// pipes[2i + 1] and stage i + 1 reads from pipes[2i].
+[[nodiscard]] std::vector<int> open_pipes(std::size_t stage_count) {
+    std::vector<int> pipes((stage_count - 1) * 2, -1);
+    for (std::size_t i = 0; i + 1 < stage_count; ++i) {
+        if (pipe2(&pipes[i * 2], O_CLOEXEC) == -1) {
+            for (const int fd : pipes) {
+                if (fd != -1) {
+                    close(fd);
+                }
+            }
+            throw std::runtime_error("pipe failed");
+        }
+    }
+
+    return pipes;
+}
+
+void report_timeout(std::chrono::milliseconds timeout) {
+    std::cerr << "shell: timed out after " << timeout.count() << "ms" << std::endl;
 }
 
 } // namespace
 
-ProcessExecutor::ProcessExecutor(const PathResolver &path_resolver) : path_resolver_(path_resolver) {}
+std::optional<SpawnBackend> spawn_backend_from_name(std::string_view name) noexcept {
+    if (name == "fork") {
+        return SpawnBackend::Fork;
+    }
+
+    if (name == "posix_spawn") {
+        return SpawnBackend::PosixSpawn;
+    }
+
+    return std::nullopt;
+}
+
+ProcessExecutor::ProcessExecutor(const PathResolver &path_resolver, SpawnBackend spawn_backend)
+    : path_resolver_(path_resolver), spawn_backend_(spawn_backend) {}
+
+void ProcessExecutor::set_spawn_backend(SpawnBackend spawn_backend) noexcept { spawn_backend_ = spawn_backend; }
+
+SpawnBackend ProcessExecutor::spawn_backend() const noexcept { return spawn_backend_; }
+
+void ProcessExecutor::set_pipeline_timeout(std::chrono::milliseconds timeout) noexcept { pipeline_timeout_ = timeout; }
+
+std::chrono::milliseconds ProcessExecutor::pipeline_timeout() const noexcept { return pipeline_timeout_; }
+
+void ProcessExecutor::set_autosplit_jobs(std::size_t jobs) noexcept {
+    autosplit_jobs_ = jobs != 0 ? jobs : std::max(1U, std::thread::hardware_concurrency());
+}
+
+std::size_t ProcessExecutor::autosplit_jobs() const noexcept { return autosplit_jobs_; }
+
+std::span<const int> ProcessExecutor::stage_statuses() const noexcept { return stage_statuses_; }
+
+int ProcessExecutor::execute_single(const Command &command, BuiltinRegistry &builtin_registry, PipelineTimes *times) {
+    if (times == nullptr) {
+        const int status = execute_command(command, builtin_registry, nullptr);
+        stage_statuses_.assign(1, status);
+        return status;
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    StageTimes stage{.name = command.name, .usage = {}};
+    const int status = execute_command(command, builtin_registry, &stage);
+
+    times->wall = std::chrono::steady_clock::now() - started;
+    times->total = stage.usage;
+    times->stages.assign(1, stage);
+    stage_statuses_.assign(1, status);
+    return status;
+}
 
-int ProcessExecutor::execute_single(const Command &command, BuiltinRegistry &builtin_registry) {
+int ProcessExecutor::execute_command(const Command &command, BuiltinRegistry &builtin_registry, StageTimes *stage) {
     RedirectionGuard redirection_guard(command.redirections);
     if (!redirection_guard.is_valid()) {
         std::cerr << redirection_guard.error() << std::endl;
         return 1;
     }
 
-    if (builtin_registry.is_builtin(command.name)) {
-        return builtin_registry.execute(command.name, command.args, std::cout, std::cerr);
+    // A command made only of assignments sets shell variables.
+    if (command.name.empty()) {
+        for (const auto &assignment : command.assignments) {
+            builtin_registry.variables().set(assignment.name, assignment.value);
+        }
+        return 0;
     }
 
-    if (path_resolver_.find_command_path(command.name).empty()) {
+    // Builtin output is buffered and written once the builtin returns, while
+    // stdout still points at the redirection target.
+    if (const auto builtin = builtin_registry.find(command.name); builtin.has_value()) {
+        const TraceSpan span("builtin", command.name);
+        const ResourceUsage started = stage != nullptr ? current_thread_usage() : ResourceUsage{};
+        int status = 0;
+        {
+            const ScopedAssignments assignments(builtin_registry.variables(), command.assignments);
+            FdOutputStream out(STDOUT_FILENO);
+            const ScopedTie tie(std::cerr, out);
+            status = builtin_registry.execute(*builtin, command.args, out, std::cerr);
+        }
+
+        if (stage != nullptr) {
+            stage->usage = thread_usage_since(started);
+            stage->in_process = true;
+        }
+        return status;
+    }
+
+    const auto command_path = resolve_command(command);
+    if (command_path.empty()) {
         std::cout << command.name << ": command not found" << std::endl;
         return 127;
     }
 
-    return execute_external(command);
+    // The argv block is already built, so its size says exactly whether the
+    // exec would fail with E2BIG.
+    char *const *envp = builtin_registry.variables().envp();
+    ResourceUsage *usage = stage != nullptr ? &stage->usage : nullptr;
+    const ExecPlan plan(command_path, command, envp);
+    if (builtin_registry.options().autosplit && plan.exec_size() > exec_size_limit()) {
+        return execute_in_batches(plan, command, envp, usage);
+    }
+
+    return execute_external(plan, usage);
 }
 
-int ProcessExecutor::execute_pipeline(const Pipeline &pipeline, BuiltinRegistry &builtin_registry) {
+int ProcessExecutor::execute_pipeline(const Pipeline &pipeline, BuiltinRegistry &builtin_registry, PipelineTimes *times) {
     if (pipeline.stages.empty()) {
         return 0;
     }
 
-    std::vector<int> pipes((pipeline.stages.size() - 1) * 2, -1);
-    for (std::size_t i = 0; i + 1 < pipeline.stages.size(); ++i) {
-        if (pipe(&pipes[i * 2]) == -1) {
-            throw std::runtime_error("pipe failed");
+    const auto started = std::chrono::steady_clock::now();
+    if (times != nullptr) {
+        times->stages.clear();
+        for (const auto &command : pipeline.stages) {
+            times->stages.push_back(StageTimes{.name = command.name, .usage = {}});
+        }
+    }
+    const auto stage_times = [times](std::size_t index) { return times != nullptr ? &times->stages[index] : nullptr; };
+
+    const std::size_t stage_count = pipeline.stages.size();
+    const std::vector<int> pipes = open_pipes(stage_count);
+
+    // Builtins that leave no shell state behind run in-process instead of in a
+    // forked copy of the shell. Assignments before one would change the
+    // variables for the duration, so such a stage forks too.
+    const std::vector<std::optional<ExecPlan>> plans = resolve_stages(pipeline, builtin_registry);
+    std::vector<std::optional<BuiltinRegistry::Builtin>> in_process(stage_count);
+    for (std::size_t i = 0; i < stage_count; ++i) {
+        const auto &command = pipeline.stages[i];
+        if (const auto builtin = builtin_registry.find(command.name); builtin.has_value()) {
+            if (builtin->runs_in_process(command.args) && command.assignments.empty()) {
+                in_process[i] = builtin;
+            }
+        }
+    }
+
+    const std::vector<pid_t> pids = start_stages(pipeline, plans, in_process, pipes, -1, builtin_registry);
+
+    // Every child has its ends now. Builtins never read stdin, so the shell
+    // keeps only the write ends of in-process stages, and only while the next
+    // stage is a process that will read them.
+    std::vector<int> output_pipes(stage_count, -1);
+    for (std::size_t i = 0; i + 1 < stage_count; ++i) {
+        close(pipes[i * 2]);
+
+        if (in_process[i].has_value() && !in_process[i + 1].has_value()) {
+            output_pipes[i] = pipes[i * 2 + 1];
+        } else {
+            close(pipes[i * 2 + 1]);
+        }
+    }
+
+    std::vector<ChildExit> exits(stage_count);
+    std::vector<std::optional<std::future<int>>> pipe_writers(stage_count);
+    for (std::size_t i = 0; i < stage_count; ++i) {
+        if (in_process[i].has_value()) {
+            exits[i].status = execute_builtin_stage(pipeline.stages[i],
+                                                    *in_process[i],
+                                                    i + 1 == stage_count,
+                                                    output_pipes[i],
+                                                    builtin_registry,
+                                                    pipe_writers[i],
+                                                    stage_times(i));
         }
     }
 
+    // Children are reaped as they finish; in-process stages keep their exits.
+    if (reap_children(pids, exits, pipeline_timeout_)) {
+        report_timeout(pipeline_timeout_);
+    }
+
+    stage_statuses_.assign(stage_count, 1);
+    for (std::size_t i = 0; i < stage_count; ++i) {
+        stage_statuses_[i] = exits[i].status;
+        if (pids[i] != -1) {
+            if (StageTimes *stage = stage_times(i); stage != nullptr) {
+                stage->usage = exits[i].usage;
+            }
+        }
+
+        // A builtin whose reader went away ends like a process killed by
+        // SIGPIPE would.
+        if (pipe_writers[i].has_value() && pipe_writers[i]->get() == EPIPE) {
+            stage_statuses_[i] = 128 + SIGPIPE;
+        }
+    }
+
+    if (times != nullptr) {
+        times->wall = std::chrono::steady_clock::now() - started;
+        times->total = {};
+        for (const auto &stage : times->stages) {
+            times->total += stage.usage;
+        }
+    }
+
+    // With pipefail the rightmost failing stage decides.
+    if (builtin_registry.options().pipefail) {
+        for (const int status : stage_statuses_ | std::views::reverse) {
+            if (status != 0) {
+                return status;
+            }
+        }
+        return 0;
+    }
+
+    return stage_statuses_.back();
+}
+
+std::vector<pid_t> ProcessExecutor::start_background(const Pipeline &pipeline, BuiltinRegistry &builtin_registry) {
+    const std::size_t stage_count = pipeline.stages.size();
+    const std::vector<std::optional<ExecPlan>> plans = resolve_stages(pipeline, builtin_registry);
+    const std::vector<std::optional<BuiltinRegistry::Builtin>> in_process(stage_count);
+
+    std::vector<int> fds = open_pipes(stage_count);
+    const int null_input = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (null_input == -1) {
+        for (const int fd : fds) {
+            close(fd);
+        }
+        throw std::runtime_error("cannot open /dev/null");
+    }
+    fds.push_back(null_input);
+    const std::span<const int> pipes(fds.data(), fds.size() - 1);
+
     std::vector<pid_t> pids;
-    pids.reserve(pipeline.stages.size());
+    try {
+        pids = start_stages(pipeline, plans, in_process, pipes, null_input, builtin_registry);
+    } catch (...) {
+        for (const int fd : fds) {
+            close(fd);
+        }
+        throw;
+    }
 
+    for (const int fd : fds) {
+        close(fd);
+    }
+    return pids;
+}
+
+std::string ProcessExecutor::resolve_command(const Command &command) const {
+    std::optional<std::string_view> assigned_path;
+    for (const auto &assignment : command.assignments) {
+        if (assignment.name == "PATH") {
+            assigned_path = assignment.value;
+        }
+    }
+
+    if (assigned_path.has_value()) {
+        return path_resolver_.find_command_path_in(command.name, *assigned_path);
+    }
+    return path_resolver_.find_command_path(command.name);
+}
+
+// Resolve every external stage up front so children go straight to execve.
+// In-process stages never change variables, so the envp the plans share stays
+// valid until the last child has started.
+std::vector<std::optional<ExecPlan>>
+ProcessExecutor::resolve_stages(const Pipeline &pipeline, BuiltinRegistry &builtin_registry) const {
+    std::vector<std::optional<ExecPlan>> plans(pipeline.stages.size());
+    char *const *envp = builtin_registry.variables().envp();
     for (std::size_t i = 0; i < pipeline.stages.size(); ++i) {
         const auto &command = pipeline.stages[i];
+        if (builtin_registry.is_builtin(command.name)) {
+            continue;
+        }
+
+        if (const auto command_path = resolve_command(command); !command_path.empty()) {
+            plans[i].emplace(command_path, command, envp);
+        }
+    }
+
+    return plans;
+}
+
+std::vector<pid_t> ProcessExecutor::start_stages(
+    const Pipeline &pipeline,
+    std::span<const std::optional<ExecPlan>> plans,
+    std::span<const std::optional<BuiltinRegistry::Builtin>> in_process,
+    std::span<const int> pipes,
+    int input_fd,
+    BuiltinRegistry &builtin_registry) const {
+    const std::size_t stage_count = pipeline.stages.size();
+    // A pid of -1 marks a stage that failed before a child existed.
+    std::vector<pid_t> pids(stage_count, -1);
+
+    for (std::size_t i = 0; i < stage_count; ++i) {
+        if (in_process[i].has_value()) {
+            continue;
+        }
+
+        const auto &command = pipeline.stages[i];
+        const ExecPlan *plan = plans[i].has_value() ? &*plans[i] : nullptr;
+
+        if (plan != nullptr && spawn_backend_ == SpawnBackend::PosixSpawn) {
+            pids[i] = spawn_pipeline_stage(command, *plan, i, stage_count, pipes, input_fd);
+            continue;
+        }
 
+        const TraceSpan span("fork", command.name);
         const pid_t pid = fork();
         if (pid == -1) {
             throw std::runtime_error("fork failed");
         }
 
         if (pid == 0) {
-            execute_pipeline_stage_in_child(command, i, pipeline.stages.size(), pipes, builtin_registry);
+            execute_pipeline_stage_in_child(command, plan, i, stage_count, pipes, builtin_registry, input_fd);
         }
 
-        pids.push_back(pid);
+        pids[i] = pid;
     }
 
-    for (const int fd : pipes) {
-        close(fd);
+    return pids;
+}
+
+int ProcessExecutor::execute_builtin_stage(
+    const Command &command,
+    const BuiltinRegistry::Builtin &builtin,
+    bool is_last_stage,
+    int output_pipe_fd,
+    BuiltinRegistry &builtin_registry,
+    std::optional<std::future<int>> &pipe_writer,
+    StageTimes *stage) {
+    OpenedRedirections redirections(command.redirections);
+    if (!redirections.is_valid()) {
+        std::cerr << redirections.error() << std::endl;
+        if (output_pipe_fd != -1) {
+            close(output_pipe_fd);
+        }
+        return 1;
     }
 
-    int last_status = 0;
-    for (const pid_t pid : pids) {
-        last_status = wait_for_process(pid);
+    // Nothing is dup2'd for an in-process builtin, so the redirections are
+    // played out on a table of what each descriptor a command line can name
+    // refers to; -1 is the stage's own stdout, the terminal or the next
+    // stage's pipe. Builtins never read stdin, so an input only has to open.
+    std::array<int, OpenedRedirections::first_private_fd> descriptors{0, -1, STDERR_FILENO, 3, 4, 5, 6, 7, 8, 9};
+    const auto actions = redirections.actions();
+    for (std::size_t i = 0; i < actions.size(); ++i) {
+        const auto [source_fd, target_fd] = actions[i];
+        const bool duplicate = command.redirections[i].op == RedirectionOp::Duplicate;
+        descriptors[static_cast<std::size_t>(target_fd)] =
+            duplicate ? descriptors[static_cast<std::size_t>(source_fd)] : source_fd;
     }
+    const int output_fd = descriptors[STDOUT_FILENO];
+    const int error_fd = descriptors[STDERR_FILENO];
+
+    // Output for the terminal or a redirection target is buffered and written
+    // straight to its descriptor; only output for the next stage's pipe is
+    // collected first, so it can be handed to a writer thread if it does not
+    // fit into the pipe.
+    const TraceSpan span("builtin", command.name);
+    std::ostringstream piped_output;
+    const ResourceUsage started = stage != nullptr ? current_thread_usage() : ResourceUsage{};
+    int status = 0;
+    {
+        ScopedSigpipeBlock sigpipe_block;
+        std::optional<FdOutputStream> output;
+        std::optional<FdOutputStream> errors;
+        if (output_fd != -1 || is_last_stage) {
+            output.emplace(output_fd == -1 ? STDOUT_FILENO : output_fd);
+        }
+        std::ostream &out = output.has_value() ? static_cast<std::ostream &>(*output) : piped_output;
+
+        std::ostream *err = &std::cerr;
+        if (error_fd == output_fd) {
+            err = &out;
+        } else if (error_fd == -1) {
+            err = is_last_stage ? &errors.emplace(STDOUT_FILENO) : static_cast<std::ostream *>(&piped_output);
+        } else if (error_fd != STDERR_FILENO) {
+            err = &errors.emplace(error_fd);
+        }
 
-    return last_status;
+        std::optional<ScopedTie> tie;
+        if (err != &out) {
+            tie.emplace(*err, out);
+        }
+        status = builtin_registry.execute(builtin, command.args, out, *err);
+    }
+
+    if (stage != nullptr) {
+        stage->usage = thread_usage_since(started);
+        stage->in_process = true;
+    }
+
+    if (output_pipe_fd != -1) {
+        if (output_fd == -1 || error_fd == -1) {
+            pipe_writer = feed_pipe(output_pipe_fd, std::move(piped_output).str());
+        } else {
+            close(output_pipe_fd);
+        }
+    }
+
+    return status;
 }
 
-int ProcessExecutor::execute_external(const Command &command) const {
-    const pid_t pid = fork();
+pid_t ProcessExecutor::spawn_pipeline_stage(
+    const Command &command,
+    const ExecPlan &plan,
+    std::size_t stage_index,
+    std::size_t stage_count,
+    std::span<const int> pipes,
+    int input_fd) {
+    OpenedRedirections redirections(command.redirections);
+    if (!redirections.is_valid()) {
+        std::cerr << redirections.error() << std::endl;
+        return -1;
+    }
+
+    // Pipe ends and opened targets are close-on-exec, so only the dup2'd
+    // copies survive into the new program.
+    SpawnFileActions file_actions;
+    if (stage_index > 0) {
+        file_actions.add_dup2(pipes[(stage_index - 1) * 2], STDIN_FILENO);
+    } else if (input_fd != -1) {
+        file_actions.add_dup2(input_fd, STDIN_FILENO);
+    }
+
+    if (stage_index + 1 < stage_count) {
+        file_actions.add_dup2(pipes[stage_index * 2 + 1], STDOUT_FILENO);
+    }
+
+    for (const auto &redirect : redirections.actions()) {
+        file_actions.add_dup2(redirect.source_fd, redirect.target_fd);
+    }
+
+    return spawn_or_report(plan, file_actions.get());
+}
+
+int ProcessExecutor::execute_external(const ExecPlan &plan, ResourceUsage *usage) const {
+    const pid_t pid = start_external(plan);
+    return pid == -1 ? 1 : wait_for_command(pid, usage);
+}
+
+// Like xargs: one exec per run of arguments that fits under ARG_MAX, each with
+// the command name and the same environment, with up to autosplit_jobs_ of them
+// running at a time. The status is that of the first batch to fail, and a
+// timeout stops the batches not yet started.
+int ProcessExecutor::execute_in_batches(
+    const ExecPlan &plan, const Command &command, char *const *envp, ResourceUsage *usage) const {
+    std::size_t fixed_size = plan.exec_size();
+    for (const std::string_view arg : command.args) {
+        fixed_size -= exec_argument_size(arg);
+    }
+    const auto batches = split_arguments(command.args, fixed_size, exec_size_limit());
+
+    if (usage != nullptr) {
+        *usage = {};
+    }
+
+    int status = 0;
+    std::vector<ExecPlan> plans;
+    std::vector<pid_t> pids;
+    std::vector<ChildExit> exits;
+    for (std::size_t first = 0; first < batches.size(); first += autosplit_jobs_) {
+        const std::size_t count = std::min(autosplit_jobs_, batches.size() - first);
+        plans.clear();
+        pids.clear();
+        for (std::size_t i = 0; i < count; ++i) {
+            pids.push_back(start_external(plans.emplace_back(plan.path(), command, batches[first + i], envp)));
+        }
+
+        exits.assign(count, ChildExit{});
+        const bool timed_out = reap_children(pids, exits, pipeline_timeout_);
+        for (const auto &exit : exits) {
+            if (status == 0) {
+                status = exit.status;
+            }
+            if (usage != nullptr) {
+                *usage += exit.usage;
+            }
+        }
+
+        if (timed_out) {
+            report_timeout(pipeline_timeout_);
+            break;
+        }
+    }
+
+    return status;
+}
+
+pid_t ProcessExecutor::start_external(const ExecPlan &plan) const {
+    if (spawn_backend_ == SpawnBackend::PosixSpawn) {
+        return spawn_or_report(plan, nullptr);
+    }
+
+    pid_t pid = -1;
+    {
+        const TraceSpan span("fork", plan.path());
+        pid = fork();
+    }
+
     if (pid == -1) {
         throw std::runtime_error("fork failed");
     }
 
     if (pid == 0) {
-        execute_external_in_child(command);
+        execute_external_in_child(plan);
     }
 
-    return wait_for_process(pid);
+    return pid;
 }
 
-void ProcessExecutor::execute_external_in_child(const Command &command) const noexcept {
-    try {
-        auto argv = build_argv(command);
-        execvp(command.name.c_str(), argv.data());
-        std::perror("exec failed");
-    } catch (const std::exception &error) {
-        std::cerr << error.what() << std::endl;
+int ProcessExecutor::wait_for_command(pid_t pid, ResourceUsage *usage) const {
+    if (pipeline_timeout_ == std::chrono::milliseconds::zero()) {
+        return wait_for_process(pid, usage);
+    }
+
+    std::array<ChildExit, 1> exits{};
+    if (reap_children(std::span(&pid, 1), exits, pipeline_timeout_)) {
+        report_timeout(pipeline_timeout_);
+    }
+
+    if (usage != nullptr) {
+        *usage = exits[0].usage;
     }
 
+    return exits[0].status;
+}
+
+void ProcessExecutor::execute_external_in_child(const ExecPlan &plan) noexcept {
+    plan.exec();
+    std::perror("exec failed");
     child_exit(1);
 }
 
 void ProcessExecutor::execute_pipeline_stage_in_child(
     const Command &command,
+    const ExecPlan *plan,
     std::size_t stage_index,
     std::size_t stage_count,
     std::span<const int> pipes,
-    BuiltinRegistry &builtin_registry) const noexcept {
+    BuiltinRegistry &builtin_registry,
+    int input_fd) const noexcept {
     try {
         if (stage_index > 0) {
             dup2(pipes[(stage_index - 1) * 2], STDIN_FILENO);
+        } else if (input_fd != -1) {
+            dup2(input_fd, STDIN_FILENO);
         }
 
         if (stage_index + 1 < stage_count) {
@@ -143,6 +751,9 @@ void ProcessExecutor::execute_pipeline_stage_in_child(
         for (const int fd : pipes) {
             close(fd);
         }
+        if (input_fd != -1) {
+            close(input_fd);
+        }
 
         RedirectionGuard redirection_guard(command.redirections);
         if (!redirection_guard.is_valid()) {
@@ -150,17 +761,23 @@ void ProcessExecutor::execute_pipeline_stage_in_child(
             child_exit(1);
         }
 
-        if (builtin_registry.is_builtin(command.name)) {
-            const int status = builtin_registry.execute(command.name, command.args, std::cout, std::cerr);
+        if (const auto builtin = builtin_registry.find(command.name); builtin.has_value()) {
+            int status = 0;
+            {
+                const ScopedAssignments assignments(builtin_registry.variables(), command.assignments);
+                FdOutputStream out(STDOUT_FILENO);
+                const ScopedTie tie(std::cerr, out);
+                status = builtin_registry.execute(*builtin, command.args, out, std::cerr);
+            }
             child_exit(status);
         }
 
-        if (path_resolver_.find_command_path(command.name).empty()) {
+        if (plan == nullptr) {
             std::cout << command.name << ": command not found" << std::endl;
             child_exit(127);
         }
 
-        execute_external_in_child(command);
+        execute_external_in_child(*plan);
     } catch (const std::exception &error) {
         std::cerr << error.what() << std::endl;
     }
@@ -168,10 +785,14 @@ void ProcessExecutor::execute_pipeline_stage_in_child(
     child_exit(1);
 }
 
-int ProcessExecutor::wait_for_process(pid_t pid) {
+// wait4 hands back the child's rusage with its status, so timing a pipeline
+// costs nothing beyond the wait itself.
+int ProcessExecutor::wait_for_process(pid_t pid, ResourceUsage *usage) {
+    const TraceSpan span("wait");
     int status = 0;
+    rusage child_usage{};
 
-    while (waitpid(pid, &status, 0) == -1) {
+    while (wait4(pid, &status, 0, usage != nullptr ? &child_usage : nullptr) == -1) {
         if (errno == EINTR) {
             continue;
         }
@@ -179,19 +800,13 @@ int ProcessExecutor::wait_for_process(pid_t pid) {
         throw std::runtime_error("waitpid failed");
     }
 
-    return wait_status_to_exit_code(status);
-}
-
-int ProcessExecutor::wait_status_to_exit_code(int status) {
-    if (WIFEXITED(status)) {
-        return WEXITSTATUS(status);
-    }
-
-    if (WIFSIGNALED(status)) {
-        return 128 + WTERMSIG(status);
+    if (usage != nullptr) {
+        *usage = ResourceUsage::from_rusage(child_usage);
     }
 
-    return 1;
+    return wait_status_to_exit_code(status);
 }
 
+int ProcessExecutor::wait_status_to_exit_code(int status) { return exit_code_from_wait_status(status); }
+
 } // namespace shell
@@ -1,37 +1,121 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
+#include <future>
 #include <iosfwd>
+#include <optional>
 #include <span>
+#include <string_view>
+#include <vector>
 #include <sys/types.h>
 
+#include "builtins/builtin_registry.hpp"
 #include "core/command.hpp"
+#include "execution/resource_usage.hpp"
 
 namespace shell {
 
-class BuiltinRegistry;
+class ExecPlan;
 class PathResolver;
 
+// How external commands are launched. PosixSpawn lets the C library use a
+// vfork-style clone, so launch cost does not grow with the shell's memory
+// footprint; Fork is kept for comparison and as the path for builtins that
+// have to run in a child process (those that would change shell state).
+enum class SpawnBackend {
+    Fork,
+    PosixSpawn,
+};
+
+[[nodiscard]] std::optional<SpawnBackend> spawn_backend_from_name(std::string_view name) noexcept;
+
 class ProcessExecutor {
   public:
-    explicit ProcessExecutor(const PathResolver &path_resolver);
+    explicit ProcessExecutor(const PathResolver &path_resolver, SpawnBackend spawn_backend = SpawnBackend::PosixSpawn);
+
+    // With `times`, wall time and the resource usage of every stage are
+    // collected for the `time` keyword.
+    int execute_single(const Command &command, BuiltinRegistry &builtin_registry, PipelineTimes *times = nullptr);
+    int execute_pipeline(const Pipeline &pipeline, BuiltinRegistry &builtin_registry, PipelineTimes *times = nullptr);
+
+    // Starts every stage of a `&` pipeline in its own process, builtins
+    // included, and returns without waiting. The first stage reads from
+    // /dev/null since the terminal stays with the shell. A pid of -1 marks a
+    // stage that could not be started.
+    [[nodiscard]] std::vector<pid_t> start_background(const Pipeline &pipeline, BuiltinRegistry &builtin_registry);
+
+    void set_spawn_backend(SpawnBackend spawn_backend) noexcept;
+    [[nodiscard]] SpawnBackend spawn_backend() const noexcept;
+
+    // Upper bound on how long a foreground command or pipeline may run; zero
+    // means none. Stages still running at the deadline are terminated.
+    void set_pipeline_timeout(std::chrono::milliseconds timeout) noexcept;
+    [[nodiscard]] std::chrono::milliseconds pipeline_timeout() const noexcept;
 
-    int execute_single(const Command &command, BuiltinRegistry &builtin_registry);
-    int execute_pipeline(const Pipeline &pipeline, BuiltinRegistry &builtin_registry);
+    // How many batches of a command split by `set -o autosplit` run at once;
+    // zero means one per CPU.
+    void set_autosplit_jobs(std::size_t jobs) noexcept;
+    [[nodiscard]] std::size_t autosplit_jobs() const noexcept;
+
+    // Status of every stage of the last command or pipeline run in the
+    // foreground, for PIPESTATUS.
+    [[nodiscard]] std::span<const int> stage_statuses() const noexcept;
 
   private:
     const PathResolver &path_resolver_;
+    SpawnBackend spawn_backend_;
+    std::chrono::milliseconds pipeline_timeout_{};
+    std::size_t autosplit_jobs_{1};
+    std::vector<int> stage_statuses_;
 
-    [[nodiscard]] int execute_external(const Command &command) const;
-    [[noreturn]] void execute_external_in_child(const Command &command) const noexcept;
+    [[nodiscard]] int execute_command(const Command &command, BuiltinRegistry &builtin_registry, StageTimes *stage);
+    [[nodiscard]] int execute_external(const ExecPlan &plan, ResourceUsage *usage = nullptr) const;
+    [[nodiscard]] int execute_in_batches(
+        const ExecPlan &plan, const Command &command, char *const *envp, ResourceUsage *usage) const;
+    // Returns the child's pid, or -1 if the spawn failed and was reported.
+    [[nodiscard]] pid_t start_external(const ExecPlan &plan) const;
+    [[nodiscard]] int wait_for_command(pid_t pid, ResourceUsage *usage) const;
+    // Looks the command up in a PATH assigned before its name, if there is
+    // one, and through the hash table otherwise.
+    [[nodiscard]] std::string resolve_command(const Command &command) const;
+    [[nodiscard]] std::vector<std::optional<ExecPlan>> resolve_stages(
+        const Pipeline &pipeline, BuiltinRegistry &builtin_registry) const;
+    // Forks or spawns every stage without an in-process builtin. `input_fd`,
+    // unless -1, becomes the first stage's stdin.
+    [[nodiscard]] std::vector<pid_t> start_stages(
+        const Pipeline &pipeline,
+        std::span<const std::optional<ExecPlan>> plans,
+        std::span<const std::optional<BuiltinRegistry::Builtin>> in_process,
+        std::span<const int> pipes,
+        int input_fd,
+        BuiltinRegistry &builtin_registry) const;
+    [[nodiscard]] static pid_t spawn_pipeline_stage(
+        const Command &command,
+        const ExecPlan &plan,
+        std::size_t stage_index,
+        std::size_t stage_count,
+        std::span<const int> pipes,
+        int input_fd);
+    [[nodiscard]] static int execute_builtin_stage(
+        const Command &command,
+        const BuiltinRegistry::Builtin &builtin,
+        bool is_last_stage,
+        int output_pipe_fd,
+        BuiltinRegistry &builtin_registry,
+        std::optional<std::future<int>> &pipe_writer,
+        StageTimes *stage);
+    [[noreturn]] static void execute_external_in_child(const ExecPlan &plan) noexcept;
     [[noreturn]] void execute_pipeline_stage_in_child(
         const Command &command,
+        const ExecPlan *plan,
         std::size_t stage_index,
         std::size_t stage_count,
         std::span<const int> pipes,
-        BuiltinRegistry &builtin_registry) const noexcept;
+        BuiltinRegistry &builtin_registry,
+        int input_fd = -1) const noexcept;
 
-    [[nodiscard]] static int wait_for_process(pid_t pid);
+    [[nodiscard]] static int wait_for_process(pid_t pid, ResourceUsage *usage = nullptr);
     [[nodiscard]] static int wait_status_to_exit_code(int status);
 };
 
@@ -1,16 +1,23 @@
 #include "execution/redirection.hpp"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <fcntl.h>
 #include <format>
+#include <utility>
 #include <unistd.h>
 
+#include "core/trace.hpp"
+#include "execution/here_document.hpp"
+
 namespace shell {
 
 namespace {
 
-int posix_dup(int fd) { return dup(fd); }
+// Backups sit above the descriptors a command line can name, so no
+// redirection replaces them, and are not inherited.
+int posix_dup(int fd) { return fcntl(fd, F_DUPFD_CLOEXEC, OpenedRedirections::first_private_fd); }
 
 int posix_open(const char *path, int flags, unsigned int mode) { return open(path, flags, mode); }
 
@@ -27,8 +34,13 @@ const RedirectionSyscalls default_syscalls{
 
 [[nodiscard]] int target_fd_for(RedirectionOp op) {
     switch (op) {
+    case RedirectionOp::StdinRead:
+    case RedirectionOp::StdinDocument:
+    case RedirectionOp::StdinString:
+        return STDIN_FILENO;
     case RedirectionOp::StdoutTruncate:
     case RedirectionOp::StdoutAppend:
+    case RedirectionOp::Duplicate:
         return STDOUT_FILENO;
     case RedirectionOp::StderrTruncate:
     case RedirectionOp::StderrAppend:
@@ -38,8 +50,22 @@ const RedirectionSyscalls default_syscalls{
     return STDOUT_FILENO;
 }
 
+[[nodiscard]] int target_fd_for(const Redirection &redirection) {
+    return redirection.target_fd != -1 ? redirection.target_fd : target_fd_for(redirection.op);
+}
+
+// Redirections whose target is a file the shell opens.
+[[nodiscard]] bool opens_file(RedirectionOp op) {
+    return op != RedirectionOp::Duplicate && op != RedirectionOp::StdinDocument && op != RedirectionOp::StdinString;
+}
+
 [[nodiscard]] int open_flags_for(RedirectionOp op) {
     switch (op) {
+    case RedirectionOp::StdinRead:
+    case RedirectionOp::StdinDocument:
+    case RedirectionOp::StdinString:
+    case RedirectionOp::Duplicate:
+        return O_RDONLY;
     case RedirectionOp::StdoutTruncate:
     case RedirectionOp::StderrTruncate:
         return O_WRONLY | O_CREAT | O_TRUNC;
@@ -53,10 +79,169 @@ const RedirectionSyscalls default_syscalls{
 
 } // namespace
 
+OpenedRedirections::OpenedRedirections(
+    std::span<const Redirection> redirections, const RedirectionSyscalls *syscalls)
+    : syscalls_(syscalls != nullptr ? syscalls : &default_syscalls) {
+    const TraceSpan span("open_redirections");
+    actions_.reserve(redirections.size());
+    for (const auto &redirection : redirections) {
+        const int target_fd = target_fd_for(redirection);
+        if (target_fd < first_private_fd) {
+            command_targets_.set(static_cast<std::size_t>(target_fd));
+        }
+    }
+
+    for (std::size_t i = 0; i < redirections.size(); ++i) {
+        const Redirection &redirection = redirections[i];
+        const int target_fd = target_fd_for(redirection);
+
+        // `N>&M` copies whatever M is by the time it is applied.
+        if (redirection.op == RedirectionOp::Duplicate) {
+            actions_.push_back(FdRedirect{.source_fd = redirection.source_fd, .target_fd = target_fd});
+            continue;
+        }
+
+        // A here-document's body was read along with the command line and is
+        // already open; the reader keeps ownership of the descriptor.
+        if (redirection.op == RedirectionOp::StdinDocument) {
+            if (redirection.source_fd == -1) {
+                fail("here-document body was not read");
+                return;
+            }
+
+            if (!add_action(redirection.source_fd, target_fd, false)) {
+                return;
+            }
+            continue;
+        }
+
+        if (redirection.op == RedirectionOp::StdinString) {
+            HereDocument body;
+            body.append(redirection.target);
+            body.append("\n");
+            if (body.finish() == -1) {
+                fail(body.error());
+                return;
+            }
+
+            if (!add_action(body.release(), target_fd, true)) {
+                return;
+            }
+            continue;
+        }
+
+        // A file named twice is opened once, so writes through both
+        // descriptors share one offset instead of overwriting each other.
+        const int flags = open_flags_for(redirection.op);
+        if (const int shared = find_opened(redirections.first(i), redirection.target, flags); shared != -1) {
+            actions_.push_back(FdRedirect{.source_fd = shared, .target_fd = target_fd});
+            continue;
+        }
+
+        // Targets are views into the command line; open() needs a terminator.
+        const std::string path(redirection.target);
+        const int opened_fd = syscalls_->open_fn(path.c_str(), flags | O_CLOEXEC, 0644);
+        if (opened_fd == -1) {
+            fail(std::format("failed to open '{}': {}", redirection.target, std::strerror(errno)));
+            return;
+        }
+
+        if (!add_action(opened_fd, target_fd, true)) {
+            return;
+        }
+    }
+}
+
+OpenedRedirections::~OpenedRedirections() { close_all(); }
+
+bool OpenedRedirections::is_valid() const noexcept { return valid_; }
+
+const std::string &OpenedRedirections::error() const noexcept { return error_; }
+
+std::span<const FdRedirect> OpenedRedirections::actions() const noexcept { return actions_; }
+
+// Redirections are applied in order with dup2(), so a source descriptor that
+// also has a redirection pointed at it would be replaced before or while it is
+// used. Such a source is moved out of the way first.
+bool OpenedRedirections::add_action(int source_fd, int target_fd, bool owned) {
+    if (owned) {
+        owned_fds_.push_back(source_fd);
+    }
+
+    if (source_fd < first_private_fd && command_targets_.test(static_cast<std::size_t>(source_fd))) {
+        const int moved_fd = fcntl(source_fd, F_DUPFD_CLOEXEC, first_private_fd);
+        if (moved_fd == -1) {
+            fail(std::format("failed to move file descriptor {}: {}", source_fd, std::strerror(errno)));
+            return false;
+        }
+
+        if (owned) {
+            owned_fds_.pop_back();
+            syscalls_->close_fn(source_fd);
+        }
+        owned_fds_.push_back(moved_fd);
+        source_fd = moved_fd;
+    }
+
+    actions_.push_back(FdRedirect{.source_fd = source_fd, .target_fd = target_fd});
+    return true;
+}
+
+int OpenedRedirections::find_opened(
+    std::span<const Redirection> earlier, std::string_view target, int flags) const noexcept {
+    for (std::size_t i = 0; i < earlier.size(); ++i) {
+        if (opens_file(earlier[i].op) && open_flags_for(earlier[i].op) == flags && earlier[i].target == target) {
+            return actions_[i].source_fd;
+        }
+    }
+
+    return -1;
+}
+
+void OpenedRedirections::fail(std::string error) {
+    error_ = std::move(error);
+    valid_ = false;
+    close_all();
+}
+
+void OpenedRedirections::close_all() noexcept {
+    for (const int fd : owned_fds_) {
+        syscalls_->close_fn(fd);
+    }
+
+    owned_fds_.clear();
+    actions_.clear();
+}
+
 RedirectionGuard::RedirectionGuard(std::span<const Redirection> redirections, const RedirectionSyscalls *syscalls)
     : syscalls_(syscalls != nullptr ? syscalls : &default_syscalls) {
+    if (redirections.empty()) {
+        return;
+    }
+
+    const TraceSpan span("redirect");
+
+    // Save the descriptors being replaced before opening anything, so a closed
+    // target fd cannot be handed out by open() and mistaken for the original.
+    saved_fds_.reserve(redirections.size());
     for (const auto &redirection : redirections) {
-        if (!apply_redirection(redirection)) {
+        if (!save_fd(target_fd_for(redirection))) {
+            valid_ = false;
+            restore();
+            return;
+        }
+    }
+
+    OpenedRedirections opened(redirections, syscalls_);
+    if (!opened.is_valid()) {
+        valid_ = false;
+        error_ = opened.error();
+        restore();
+        return;
+    }
+
+    for (const auto &redirect : opened.actions()) {
+        if (!apply_redirection(redirect)) {
             valid_ = false;
             restore();
             return;
@@ -70,37 +255,38 @@ bool RedirectionGuard::is_valid() const noexcept { return valid_; }
 
 const std::string &RedirectionGuard::error() const noexcept { return error_; }
 
-bool RedirectionGuard::apply_redirection(const Redirection &redirection) {
-    const int target_fd = target_fd_for(redirection.op);
-
-    if (find_backup_fd(target_fd) == -1) {
-        const int backup_fd = syscalls_->dup_fn(target_fd);
-        if (backup_fd == -1) {
-            error_ = std::format("failed to save file descriptor {}: {}", target_fd, std::strerror(errno));
-            return false;
-        }
-
-        saved_fds_.push_back(SavedFd{.target_fd = target_fd, .backup_fd = backup_fd});
+bool RedirectionGuard::save_fd(int target_fd) {
+    if (std::ranges::any_of(saved_fds_, [target_fd](const SavedFd &saved) { return saved.target_fd == target_fd; })) {
+        return true;
     }
 
-    const int redirected_fd = syscalls_->open_fn(redirection.target.c_str(), open_flags_for(redirection.op), 0644);
-    if (redirected_fd == -1) {
-        error_ = std::format("failed to open '{}': {}", redirection.target, std::strerror(errno));
+    // A descriptor that was not open is closed again on restore.
+    const int backup_fd = syscalls_->dup_fn(target_fd);
+    if (backup_fd == -1 && errno != EBADF) {
+        error_ = std::format("failed to save file descriptor {}: {}", target_fd, std::strerror(errno));
         return false;
     }
 
-    if (syscalls_->dup2_fn(redirected_fd, target_fd) == -1) {
-        error_ = std::format("failed to redirect file descriptor {}: {}", target_fd, std::strerror(errno));
-        syscalls_->close_fn(redirected_fd);
+    saved_fds_.push_back(SavedFd{.target_fd = target_fd, .backup_fd = backup_fd});
+    return true;
+}
+
+bool RedirectionGuard::apply_redirection(const FdRedirect &redirect) {
+    if (syscalls_->dup2_fn(redirect.source_fd, redirect.target_fd) == -1) {
+        error_ = std::format("failed to redirect file descriptor {}: {}", redirect.target_fd, std::strerror(errno));
         return false;
     }
 
-    syscalls_->close_fn(redirected_fd);
     return true;
 }
 
 void RedirectionGuard::restore() noexcept {
     for (auto it = saved_fds_.rbegin(); it != saved_fds_.rend(); ++it) {
+        if (it->backup_fd == -1) {
+            syscalls_->close_fn(it->target_fd);
+            continue;
+        }
+
         syscalls_->dup2_fn(it->backup_fd, it->target_fd);
         syscalls_->close_fn(it->backup_fd);
     }
@@ -108,14 +294,4 @@ void RedirectionGuard::restore() noexcept {
     saved_fds_.clear();
 }
 
-int RedirectionGuard::find_backup_fd(int target_fd) const noexcept {
-    for (const auto &saved_fd : saved_fds_) {
-        if (saved_fd.target_fd == target_fd) {
-            return saved_fd.backup_fd;
-        }
-    }
-
-    return -1;
-}
-
 } // namespace shell
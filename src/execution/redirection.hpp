@@ -1,7 +1,9 @@
 #pragma once
 
+#include <bitset>
 #include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "core/command.hpp"
@@ -15,6 +17,51 @@ struct RedirectionSyscalls {
     int (*close_fn)(int fd);
 };
 
+// A redirection whose target is already open: dup2(source_fd, target_fd).
+struct FdRedirect {
+    int source_fd;
+    int target_fd;
+};
+
+// Opens every redirection target of a command up front and owns the resulting
+// descriptors, so the same redirections can be installed in-process by
+// RedirectionGuard or handed to posix_spawn as file actions. Here-strings are
+// staged in a HereDocument; here-documents use the descriptor their reader
+// already holds. Each distinct file is opened once per command, and
+// duplications refer to descriptors by number.
+class OpenedRedirections {
+  public:
+    // Command lines name descriptors 0-9; the shell's own copies go above.
+    static constexpr int first_private_fd = 10;
+
+    explicit OpenedRedirections(
+        std::span<const Redirection> redirections, const RedirectionSyscalls *syscalls = nullptr);
+    ~OpenedRedirections();
+
+    OpenedRedirections(const OpenedRedirections &) = delete;
+    OpenedRedirections &operator=(const OpenedRedirections &) = delete;
+
+    [[nodiscard]] bool is_valid() const noexcept;
+    [[nodiscard]] const std::string &error() const noexcept;
+    // One action per redirection, in order, to be applied in that order.
+    [[nodiscard]] std::span<const FdRedirect> actions() const noexcept;
+
+  private:
+    std::vector<FdRedirect> actions_;
+    std::vector<int> owned_fds_;
+    // Descriptors that some redirection of the command replaces.
+    std::bitset<first_private_fd> command_targets_;
+    bool valid_{true};
+    std::string error_;
+    const RedirectionSyscalls *syscalls_;
+
+    [[nodiscard]] bool add_action(int source_fd, int target_fd, bool owned);
+    // The descriptor an earlier redirection already opened `target` with, or -1.
+    [[nodiscard]] int find_opened(std::span<const Redirection> earlier, std::string_view target, int flags) const noexcept;
+    void fail(std::string error);
+    void close_all() noexcept;
+};
+
 class RedirectionGuard {
   public:
     explicit RedirectionGuard(
@@ -38,9 +85,9 @@ class RedirectionGuard {
     std::string error_;
     const RedirectionSyscalls *syscalls_;
 
-    [[nodiscard]] bool apply_redirection(const Redirection &redirection);
+    [[nodiscard]] bool save_fd(int target_fd);
+    [[nodiscard]] bool apply_redirection(const FdRedirect &redirect);
     void restore() noexcept;
-    [[nodiscard]] int find_backup_fd(int target_fd) const noexcept;
 };
 
 } // namespace shell
@@ -0,0 +1,86 @@
+#include "execution/resource_usage.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <format>
+#include <iterator>
+#include <ostream>
+#include <string>
+
+#include <sys/resource.h>
+
+namespace shell {
+
+namespace {
+
+[[nodiscard]] std::chrono::microseconds to_microseconds(const timeval &value) noexcept {
+    return std::chrono::seconds(value.tv_sec) + std::chrono::microseconds(value.tv_usec);
+}
+
+// bash's default TIMEFORMAT precision: 0m0.003s.
+[[nodiscard]] std::string format_duration(std::chrono::nanoseconds duration) {
+    const auto minutes = std::chrono::duration_cast<std::chrono::minutes>(duration);
+    const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(duration - minutes);
+    return std::format("{}m{}.{:03}s", minutes.count(), millis.count() / 1000, millis.count() % 1000);
+}
+
+} // namespace
+
+ResourceUsage ResourceUsage::from_rusage(const rusage &usage) noexcept {
+    return ResourceUsage{
+        .user = to_microseconds(usage.ru_utime),
+        .system = to_microseconds(usage.ru_stime),
+        .max_rss_kib = usage.ru_maxrss,
+    };
+}
+
+ResourceUsage &ResourceUsage::operator+=(const ResourceUsage &other) noexcept {
+    user += other.user;
+    system += other.system;
+    max_rss_kib = std::max(max_rss_kib, other.max_rss_kib);
+    return *this;
+}
+
+ResourceUsage current_thread_usage() noexcept {
+    rusage usage{};
+    if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+        return {};
+    }
+
+    return ResourceUsage::from_rusage(usage);
+}
+
+ResourceUsage thread_usage_since(const ResourceUsage &start) noexcept {
+    ResourceUsage usage = current_thread_usage();
+    usage.user -= start.user;
+    usage.system -= start.system;
+    return usage;
+}
+
+void print_times(std::ostream &out, const PipelineTimes &times, bool per_stage) {
+    auto sink = std::ostreambuf_iterator<char>(out);
+    std::format_to(sink, "\nreal\t{}\n", format_duration(times.wall));
+    std::format_to(sink, "user\t{}\n", format_duration(times.total.user));
+    std::format_to(sink, "sys\t{}\n", format_duration(times.total.system));
+    std::format_to(sink, "maxrss\t{}k\n", times.total.max_rss_kib);
+
+    if (!per_stage) {
+        return;
+    }
+
+    // Builtins that ran inside the shell report the shell thread's time and
+    // the shell's own peak.
+    for (std::size_t i = 0; i < times.stages.size(); ++i) {
+        const auto &stage = times.stages[i];
+        std::format_to(sink,
+                       "[{}]\tuser {}\tsys {}\tmaxrss {}k\t{}{}\n",
+                       i + 1,
+                       format_duration(stage.usage.user),
+                       format_duration(stage.usage.system),
+                       stage.usage.max_rss_kib,
+                       stage.name,
+                       stage.in_process ? " (builtin)" : "");
+    }
+}
+
+} // namespace shell
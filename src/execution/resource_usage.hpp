@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <iosfwd>
+#include <string_view>
+#include <vector>
+
+struct rusage;
+
+namespace shell {
+
+// CPU time and peak resident set size of a process, or of the shell thread
+// while it ran an in-process builtin.
+struct ResourceUsage {
+    std::chrono::microseconds user{};
+    std::chrono::microseconds system{};
+    long max_rss_kib{0};
+
+    [[nodiscard]] static ResourceUsage from_rusage(const rusage &usage) noexcept;
+
+    // Times add up; the peak is the largest of the two.
+    ResourceUsage &operator+=(const ResourceUsage &other) noexcept;
+};
+
+// Usage of the calling thread so far. The peak is that of the whole process.
+[[nodiscard]] ResourceUsage current_thread_usage() noexcept;
+
+// Usage of the calling thread since `start`.
+[[nodiscard]] ResourceUsage thread_usage_since(const ResourceUsage &start) noexcept;
+
+struct StageTimes {
+    std::string_view name;
+    ResourceUsage usage;
+    bool in_process{false};
+};
+
+// Filled in by ProcessExecutor for a pipeline run under `time`. Stage names
+// are views into the parsed pipeline.
+struct PipelineTimes {
+    std::chrono::nanoseconds wall{};
+    ResourceUsage total;
+    std::vector<StageTimes> stages;
+};
+
+// Prints real/user/sys/maxrss like the shell's `time` keyword, followed by
+// one line per stage when `per_stage` is set.
+void print_times(std::ostream &out, const PipelineTimes &times, bool per_stage);
+
+} // namespace shell
@@ -6,6 +6,7 @@
 #include <format>
 #include <fstream>
 #include <ios>
+#include <iterator>
 #include <ostream>
 
 #include <readline/history.h>
@@ -98,7 +99,7 @@ void HistoryManager::print(std::ostream &out, int limit) const {
     for (int i = start; i <= history_length; ++i) {
         const HIST_ENTRY *entry = history_get(i);
         if (entry != nullptr) {
-            out << std::format("    {}  {}\n", i, entry->line);
+            std::format_to(std::ostreambuf_iterator<char>(out), "    {}  {}\n", i, entry->line);
         }
     }
 }
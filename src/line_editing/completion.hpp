@@ -14,6 +14,9 @@ class CompletionEngine {
 
     void install();
 
+    // Builtin names and PATH commands that start with `prefix`, in order.
+    [[nodiscard]] std::set<std::string> collect_matches(const std::string &prefix) const;
+
   private:
     const BuiltinRegistry &builtin_registry_;
     const PathResolver &path_resolver_;
@@ -22,8 +25,6 @@ class CompletionEngine {
 
     static char **completion_callback(const char *text, int start, int end);
     static char *generator_callback(const char *text, int state);
-
-    [[nodiscard]] std::set<std::string> collect_matches(const std::string &prefix) const;
 };
 
 } // namespace shell
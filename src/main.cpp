@@ -1,6 +1,8 @@
+#include <span>
+
 #include "app/shell_app.hpp"
 
-int main() {
+int main(int argc, char *argv[]) {
     shell::ShellApp app;
-    return app.run();
+    return app.run(std::span<const char *const>(argv + 1, argc > 1 ? argc - 1 : 0));
 }
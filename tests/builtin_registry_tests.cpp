@@ -3,8 +3,10 @@
 #include <filesystem>
 #include <fstream>
 #include <new>
+#include <span>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <tuple>
 #include <vector>
@@ -153,6 +155,48 @@ void test_registry_lookup_and_dispatch() {
     assert(names.contains("history"));
     assert(names.contains("pwd"));
     assert(names.contains("type"));
+    assert(names.contains("hash"));
+}
+
+void test_static_lookup_and_runtime_extensions() {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry registry(resolver, history_manager);
+
+    for (const std::string_view name : {"cd", "echo", "exit", "hash", "history", "jobs", "pwd", "set", "type", "wait"}) {
+        const auto builtin = registry.find(name);
+        assert(builtin.has_value());
+        assert(builtin->name() == name);
+    }
+
+    for (const std::string_view name : {"", "c", "cdx", "ech", "echo ", "Echo", "historyx", "greet"}) {
+        assert(!registry.find(name).has_value());
+    }
+
+    const auto echo = registry.find("echo");
+    std::ostringstream out;
+    std::ostringstream err;
+    const std::vector<std::string_view> words{"one", "two"};
+    assert(registry.execute(*echo, words, out, err) == 0);
+    assert(out.str() == "one two\n");
+
+    assert(!registry.register_builtin("echo", [](auto, auto &, auto &) { return 0; }));
+    assert(registry.register_builtin("greet", [](std::span<const std::string_view> args, std::ostream &o, std::ostream &) {
+        o << "hello " << args.size() << '\n';
+        return 3;
+    }));
+    assert(!registry.register_builtin("greet", [](auto, auto &, auto &) { return 0; }));
+
+    const auto greet = registry.find("greet");
+    assert(greet.has_value() && greet->name() == "greet");
+    assert(!greet->runs_in_process({}));
+    out.str("");
+    assert(registry.execute(*greet, words, out, err) == 3);
+    assert(out.str() == "hello 2\n");
+    assert(registry.names().contains("greet"));
+
+    assert(registry.register_builtin("quiet", [](auto, auto &, auto &) { return 0; }, true));
+    assert(registry.runs_in_process("quiet", {}));
 }
 
 void test_cd_echo_pwd_and_exit() {
@@ -315,6 +359,152 @@ void test_history_builtin_variants() {
     fs::remove(append_file, ec);
 }
 
+void test_hash_builtin_variants() {
+    EnvVarGuard path_guard("PATH");
+
+    const std::string dir = make_temp_dir();
+    const fs::path exe = fs::path(dir) / "custom_hash_exe";
+
+    {
+        std::ofstream file(exe);
+        assert(file.is_open());
+        file << "#!/bin/sh\necho ok\n";
+    }
+
+    make_executable(exe);
+    setenv("PATH", dir.c_str(), 1);
+
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry registry(resolver, history_manager);
+
+    std::ostringstream out;
+    std::ostringstream err;
+
+    assert(registry.execute("hash", {}, out, err) == 0);
+    assert(out.str() == "hash: hash table empty\n");
+
+    assert(registry.execute("hash", {"echo", "custom_hash_exe"}, out, err) == 0);
+    assert(registry.execute("hash", {"missing_hash_exe"}, out, err) == 1);
+    assert(err.str().find("hash: missing_hash_exe: not found") != std::string::npos);
+
+    out.str("");
+    out.clear();
+    assert(registry.execute("hash", {}, out, err) == 0);
+    assert(out.str().find("hits\tcommand\n") == 0);
+    assert(out.str().find(exe.string()) != std::string::npos);
+    assert(out.str().find("echo") == std::string::npos);
+
+    out.str("");
+    out.clear();
+    assert(registry.execute("hash", {"-t", "custom_hash_exe"}, out, err) == 0);
+    assert(out.str() == exe.string() + "\n");
+
+    assert(registry.execute("hash", {"-p", "/opt/seeded/tool", "tool"}, out, err) == 0);
+    out.str("");
+    out.clear();
+    assert(registry.execute("hash", {"-t", "tool", "custom_hash_exe"}, out, err) == 0);
+    assert(out.str() == "tool\t/opt/seeded/tool\ncustom_hash_exe\t" + exe.string() + "\n");
+
+    assert(registry.execute("hash", {"-d", "tool"}, out, err) == 0);
+    assert(registry.execute("hash", {"-d", "tool"}, out, err) == 1);
+    assert(registry.execute("hash", {"-t", "tool"}, out, err) == 1);
+    assert(registry.execute("hash", {"-p", "/only/path"}, out, err) == 1);
+    assert(registry.execute("hash", {"-d"}, out, err) == 1);
+
+    assert(registry.execute("hash", {"-r"}, out, err) == 0);
+    out.str("");
+    out.clear();
+    assert(registry.execute("hash", {}, out, err) == 0);
+    assert(out.str() == "hash: hash table empty\n");
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+void test_set_builtin_options() {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry registry(resolver, history_manager);
+
+    assert(!registry.options().pipefail);
+    assert(registry.runs_in_process("set", std::vector<std::string_view>{"-o"}));
+    assert(!registry.runs_in_process("set", std::vector<std::string_view>{"-o", "pipefail"}));
+
+    std::ostringstream out;
+    std::ostringstream err;
+    assert(registry.execute("set", {"-o", "pipefail"}, out, err) == 0);
+    assert(registry.options().pipefail);
+
+    assert(registry.execute("set", {"-o"}, out, err) == 0);
+    assert(out.str() == "autosplit      \toff\npipefail       \ton\n");
+    out.str("");
+    assert(registry.execute("set", {"+o"}, out, err) == 0);
+    assert(out.str() == "set +o autosplit\nset -o pipefail\n");
+
+    assert(registry.execute("set", {"-o", "autosplit"}, out, err) == 0);
+    assert(registry.options().autosplit && registry.options().pipefail);
+
+    assert(registry.execute("set", {"+o", "pipefail"}, out, err) == 0);
+    assert(!registry.options().pipefail);
+
+    assert(registry.execute("set", {"-o", "nosuch"}, out, err) == 1);
+    assert(err.str() == "set: nosuch: invalid option name\n");
+    err.str("");
+    assert(registry.execute("set", {"-x"}, out, err) == 2);
+    assert(err.str() == "set: -x: invalid option\n");
+    err.str("");
+    assert(registry.execute("set", {"-o", "pipefail", "+o"}, out, err) == 2);
+    assert(err.str() == "set: +o: option name required\n");
+}
+
+void test_export_and_unset_builtins() {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry registry(resolver, history_manager);
+    auto &variables = registry.variables();
+
+    // The environment the shell started with is exported.
+    assert(variables.get("PATH").has_value() && variables.exported("PATH"));
+
+    assert(registry.runs_in_process("export", std::vector<std::string_view>{}));
+    assert(registry.runs_in_process("export", std::vector<std::string_view>{"-p"}));
+    assert(!registry.runs_in_process("export", std::vector<std::string_view>{"A=1"}));
+    assert(!registry.runs_in_process("unset", std::vector<std::string_view>{"A"}));
+
+    std::ostringstream out;
+    std::ostringstream err;
+    variables.set("LOCAL", "kept");
+    assert(registry.execute("export", {"--", "NEW=it's", "LOCAL", "LATER"}, out, err) == 0);
+    assert(variables.get("NEW") == "it's" && variables.exported("NEW"));
+    assert(variables.get("LOCAL") == "kept" && variables.exported("LOCAL"));
+    assert(variables.exported("LATER") && !variables.get("LATER").has_value());
+
+    assert(registry.execute("export", {}, out, err) == 0);
+    const std::string listing = out.str();
+    assert(listing.find("export NEW='it'\\''s'\n") != std::string::npos);
+    assert(listing.find("export LATER\n") != std::string::npos);
+    assert(listing.find("export LATER\n") < listing.find("export LOCAL='kept'\n"));
+
+    assert(registry.execute("export", {"-n", "LOCAL"}, out, err) == 0);
+    assert(!variables.exported("LOCAL") && variables.get("LOCAL") == "kept");
+
+    assert(registry.execute("export", {"1BAD=x", "OK=y"}, out, err) == 1);
+    assert(err.str() == "export: `1BAD=x': not a valid identifier\n");
+    assert(variables.get("OK") == "y");
+    err.str("");
+    assert(registry.execute("export", {"-x"}, out, err) == 2);
+    assert(err.str() == "export: -x: invalid option\n");
+
+    err.str("");
+    assert(registry.execute("unset", {"-v", "NEW", "MISSING", "a-b"}, out, err) == 1);
+    assert(err.str() == "unset: `a-b': not a valid identifier\n");
+    assert(!variables.get("NEW").has_value());
+    assert(registry.execute("unset", {"-f", "OK"}, out, err) == 0);
+    assert(variables.get("OK") == "y");
+    assert(registry.execute("unset", {"-z"}, out, err) == 2);
+}
+
 void test_names_handles_allocation_failure_path() {
     PathResolver resolver;
     HistoryManager history_manager;
@@ -335,9 +525,13 @@ void test_names_handles_allocation_failure_path() {
 
 int main() {
     test_registry_lookup_and_dispatch();
+    test_static_lookup_and_runtime_extensions();
     test_cd_echo_pwd_and_exit();
     test_type_builtin_for_all_branches();
     test_history_builtin_variants();
+    test_hash_builtin_variants();
+    test_set_builtin_options();
+    test_export_and_unset_builtins();
     test_names_handles_allocation_failure_path();
 
     return 0;
@@ -0,0 +1,156 @@
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "execution/child_reaper.hpp"
+
+using shell::ChildExit;
+
+namespace {
+
+using namespace std::chrono_literals;
+
+int exit_handler_fd = -1;
+
+void write_exit_marker() {
+    if (exit_handler_fd != -1) {
+        (void)write(exit_handler_fd, "atexit", 6);
+    }
+}
+
+// A child that exits with `code` once `delay` has passed, optionally
+// ignoring SIGTERM first.
+pid_t start_child(int code, std::chrono::milliseconds delay = {}, bool ignore_sigterm = false) {
+    const pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        if (ignore_sigterm) {
+            signal(SIGTERM, SIG_IGN);
+        }
+        std::this_thread::sleep_for(delay);
+        _exit(code);
+    }
+
+    return pid;
+}
+
+void test_exit_codes_from_wait_statuses() {
+    assert(shell::exit_code_from_wait_status(W_EXITCODE(0, 0)) == 0);
+    assert(shell::exit_code_from_wait_status(W_EXITCODE(42, 0)) == 42);
+    assert(shell::exit_code_from_wait_status(SIGKILL) == 128 + SIGKILL);
+    assert(shell::exit_code_from_wait_status(W_STOPCODE(SIGSTOP)) == 1);
+}
+
+void test_every_child_is_reaped_regardless_of_order() {
+    // The first child outlives the rest; each status lands at its own index
+    // and skipped entries keep theirs.
+    const std::vector<pid_t> pids{start_child(1, 100ms), -1, start_child(2), start_child(3, 20ms)};
+    std::vector<ChildExit> exits(pids.size());
+    exits[1].status = 77;
+
+    assert(!shell::reap_children(pids, exits));
+    assert(exits[0].status == 1);
+    assert(exits[1].status == 77);
+    assert(exits[2].status == 2);
+    assert(exits[3].status == 3);
+
+    // No zombies are left behind.
+    int status = 0;
+    assert(waitpid(-1, &status, WNOHANG) == -1);
+}
+
+void test_lone_child_and_usage() {
+    const std::array pids{start_child(5)};
+    std::array<ChildExit, 1> exits{};
+    assert(!shell::reap_children(pids, exits));
+    assert(exits[0].status == 5);
+    assert(exits[0].usage.max_rss_kib > 0);
+
+    const std::array<pid_t, 2> none{-1, -1};
+    std::array<ChildExit, 2> untouched{};
+    assert(!shell::reap_children(none, untouched));
+    assert(untouched[0].status == 1 && untouched[1].status == 1);
+}
+
+void test_timeout_terminates_remaining_children() {
+    {
+        const auto started = std::chrono::steady_clock::now();
+        const std::array pids{start_child(0), start_child(0, 10s)};
+        std::array<ChildExit, 2> exits{};
+        assert(shell::reap_children(pids, exits, 50ms));
+        assert(exits[0].status == 0);
+        assert(exits[1].status == 128 + SIGTERM);
+        assert(std::chrono::steady_clock::now() - started < 5s);
+    }
+
+    // A child that ignores SIGTERM is killed after the grace period.
+    {
+        const std::array pids{start_child(0, 10s, true)};
+        std::array<ChildExit, 1> exits{};
+        assert(shell::reap_children(pids, exits, 50ms));
+        assert(exits[0].status == 128 + SIGKILL);
+    }
+
+    // Children that finish in time are not disturbed.
+    {
+        const std::array pids{start_child(4), start_child(0, 10ms)};
+        std::array<ChildExit, 2> exits{};
+        assert(!shell::reap_children(pids, exits, 5s));
+        assert(exits[0].status == 4 && exits[1].status == 0);
+    }
+}
+
+void test_child_exit_flushes_output_and_skips_exit_handlers() {
+    std::array<int, 2> fds{};
+    assert(pipe(fds.data()) == 0);
+    exit_handler_fd = fds[1];
+    assert(std::atexit(write_exit_marker) == 0);
+
+    // The handler is inherited from the parent; only the buffered output may
+    // reach the pipe.
+    const pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        std::cout << "output";
+        shell::child_exit(3);
+    }
+
+    close(fds[1]);
+    exit_handler_fd = -1;
+    std::string output;
+    std::array<char, 64> buffer{};
+    ssize_t count = 0;
+    while ((count = read(fds[0], buffer.data(), buffer.size())) > 0) {
+        output.append(buffer.data(), static_cast<std::size_t>(count));
+    }
+    close(fds[0]);
+
+    const std::array pids{pid};
+    std::array<ChildExit, 1> exits{};
+    assert(!shell::reap_children(pids, exits));
+    assert(exits[0].status == 3);
+    assert(output == "output");
+}
+
+} // namespace
+
+int main() {
+    test_exit_codes_from_wait_statuses();
+    test_every_child_is_reaped_regardless_of_order();
+    test_lone_child_and_usage();
+    test_timeout_terminates_remaining_children();
+    test_child_exit_flushes_output_and_skips_exit_handlers();
+
+    return 0;
+}
@@ -19,11 +19,13 @@
 
 #include "builtins/builtin_registry.hpp"
 #include "core/path_resolver.hpp"
+#include "execution/exec_plan.hpp"
 #include "execution/redirection.hpp"
 #include "history/history_manager.hpp"
 
 using shell::BuiltinRegistry;
 using shell::Command;
+using shell::ExecPlan;
 using shell::CompletionEngine;
 using shell::HistoryManager;
 using shell::PathResolver;
@@ -172,8 +174,9 @@ void test_process_executor_exception_edges() {
         assert(pid != -1);
         if (pid == 0) {
             Command command{.name = "missing_exec_for_alloc_test", .args = {"arg1"}, .redirections = {}};
+            const ExecPlan plan(command.name, command);
             fail_after_allocations = 0;
-            executor.execute_external_in_child(command);
+            ProcessExecutor::execute_external_in_child(plan);
         }
 
         int status = 0;
@@ -193,7 +196,7 @@ void test_process_executor_exception_edges() {
                 .args = {"x"},
                 .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = "/tmp/shell_exception_pipe_out.txt"}}};
             fail_after_allocations = 0;
-            executor.execute_pipeline_stage_in_child(command, 0, 1, std::span<const int>{}, builtins);
+            executor.execute_pipeline_stage_in_child(command, nullptr, 0, 1, std::span<const int>{}, builtins);
         }
 
         int status = 0;
@@ -0,0 +1,198 @@
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/command.hpp"
+#include "execution/exec_plan.hpp"
+
+using shell::Command;
+using shell::ExecPlan;
+using shell::exec_argument_size;
+using shell::split_arguments;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::string make_temp_dir() {
+    std::string pattern = "/tmp/shell_exec_plan_XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+
+    char *created = mkdtemp(buffer.data());
+    assert(created != nullptr);
+    return created;
+}
+
+void make_executable_script(const fs::path &path, std::string_view body) {
+    std::ofstream file(path);
+    assert(file.is_open());
+    file << body;
+    file.close();
+
+    std::error_code ec;
+    fs::permissions(path,
+                    fs::perms::owner_read | fs::perms::owner_write | fs::perms::owner_exec,
+                    fs::perm_options::replace,
+                    ec);
+    assert(!ec);
+}
+
+std::string slurp(const fs::path &path) {
+    std::ifstream file(path);
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+int run_plan(const ExecPlan &plan) {
+    const pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        plan.exec();
+        _exit(errno == ENOENT ? 42 : 1);
+    }
+
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+void test_plan_layout() {
+    Command command{.name = "tool", .args = {"one", "", "three"}, .redirections = {}};
+    const ExecPlan plan("/usr/bin/tool", command);
+
+    assert(std::string_view(plan.path()) == "/usr/bin/tool");
+    assert(plan.argc() == 4);
+
+    char *const *argv = plan.argv();
+    assert(std::string_view(argv[0]) == "tool");
+    assert(std::string_view(argv[1]) == "one");
+    assert(std::string_view(argv[2]).empty());
+    assert(std::string_view(argv[3]) == "three");
+    assert(argv[4] == nullptr);
+    assert(plan.envp() == environ);
+
+    char *custom_env[] = {const_cast<char *>("A=1"), nullptr};
+    ExecPlan with_env("/bin/true", command, custom_env);
+    assert(with_env.envp() == custom_env);
+
+    ExecPlan moved(std::move(with_env));
+    assert(std::string_view(moved.argv()[3]) == "three");
+}
+
+void test_assignments_overlay_the_environment() {
+    char *base_env[] = {const_cast<char *>("KEEP=1"),
+                        const_cast<char *>("LANG=en"),
+                        const_cast<char *>("LANGUAGE=fr"),
+                        const_cast<char *>("ODD"),
+                        nullptr};
+
+    Command command{.name = "tool", .args = {"arg"}, .redirections = {}};
+    const ExecPlan plain("/bin/tool", command, base_env);
+    assert(plain.envp() == base_env);
+
+    command.assignments = {
+        {.name = "LANG", .value = "C"},
+        {.name = "NEW", .value = ""},
+        {.name = "LANG", .value = "POSIX"},
+    };
+    const ExecPlan overlaid("/bin/tool", command, base_env);
+    char *const *envp = overlaid.envp();
+    assert(envp != base_env);
+
+    // Untouched entries are the caller's strings, not copies.
+    assert(envp[0] == base_env[0]);
+    assert(envp[1] == base_env[2]);
+    assert(envp[2] == base_env[3]);
+    assert(std::string_view(envp[3]) == "NEW=");
+    // The last assignment to a name wins.
+    assert(std::string_view(envp[4]) == "LANG=POSIX");
+    assert(envp[5] == nullptr);
+    assert(std::string_view(overlaid.argv()[1]) == "arg");
+}
+
+void test_exec_runs_resolved_path_and_falls_back_to_sh() {
+    const fs::path dir = make_temp_dir();
+    const fs::path output = dir / "out.txt";
+
+    const fs::path shebang_script = dir / "with_shebang";
+    make_executable_script(shebang_script, "#!/bin/sh\nprintf '%s,%s' \"$0\" \"$1\" > \"$2\"\n");
+
+    const std::string output_path = output.string();
+    Command command{.name = "alias_name", .args = {"first", output_path}, .redirections = {}};
+    assert(run_plan(ExecPlan(shebang_script.string(), command)) == 0);
+    assert(slurp(output) == shebang_script.string() + ",first");
+
+    const fs::path plain_script = dir / "without_shebang";
+    make_executable_script(plain_script, "printf '%s' \"$1\" > \"$2\"\n");
+    assert(run_plan(ExecPlan(plain_script.string(), command)) == 0);
+    assert(slurp(output) == "first");
+
+    assert(run_plan(ExecPlan((dir / "missing").string(), command)) == 42);
+
+    fs::remove(output);
+    const ExecPlan spawned(plain_script.string(), command);
+    pid_t pid = -1;
+    assert(spawned.spawn(pid, nullptr) == 0);
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(slurp(output) == "first");
+    assert(std::string_view(spawned.argv()[0]) == "alias_name");
+
+    assert(ExecPlan((dir / "missing").string(), command).spawn(pid, nullptr) == ENOENT);
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+void test_exec_size_and_argument_batches() {
+    char entry[] = "A=1";
+    char *const env[] = {entry, nullptr};
+    Command command{.name = "tool", .args = {"one", "three"}, .redirections = {}};
+    const ExecPlan plan("/usr/bin/tool", command, env);
+    assert(plan.exec_size() == 5 + 4 + 6 + 4 + 4 * sizeof(char *));
+
+    // A batch of the command's own arguments.
+    const std::string large(40, 'x');
+    const std::vector<std::string_view> args{"aaaa", "bb", "c", large, "e"};
+    const ExecPlan batch("/usr/bin/tool", command, std::span(args).subspan(1, 2), env);
+    assert(batch.argc() == 3);
+    assert(std::strcmp(batch.argv()[1], "bb") == 0 && std::strcmp(batch.argv()[2], "c") == 0);
+    assert(batch.argv()[3] == nullptr);
+
+    const std::size_t fixed = 10;
+    const std::size_t limit = fixed + exec_argument_size("aaaa") + exec_argument_size("bb");
+    const auto runs = split_arguments(args, fixed, limit);
+    assert(runs.size() == 4);
+    assert(runs[0].size() == 2 && runs[0][0] == "aaaa" && runs[0][1] == "bb");
+    assert(runs[1].size() == 1 && runs[1][0] == "c");
+    // An argument over the limit on its own still gets a run.
+    assert(runs[2].size() == 1 && runs[2][0] == large);
+    assert(runs[3].size() == 1 && runs[3][0] == "e");
+
+    assert(split_arguments({}, fixed, limit).empty());
+    assert(split_arguments(args, fixed, 1000).size() == 1);
+    assert(shell::exec_size_limit() > 0);
+}
+
+} // namespace
+
+int main() {
+    test_plan_layout();
+    test_assignments_overlay_the_environment();
+    test_exec_runs_resolved_path_and_falls_back_to_sh();
+    test_exec_size_and_argument_batches();
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "execution/fd_writer.hpp"
+
+using shell::FdOutputStream;
+using shell::StringOutputStream;
+
+namespace {
+
+class Pipe {
+  public:
+    Pipe() {
+        assert(pipe2(fds_, O_CLOEXEC) == 0);
+        // Large enough for every write below, so nothing blocks.
+        (void)fcntl(fds_[1], F_SETPIPE_SZ, 1 << 20);
+    }
+
+    ~Pipe() {
+        close_write();
+        close(fds_[0]);
+    }
+
+    Pipe(const Pipe &) = delete;
+    Pipe &operator=(const Pipe &) = delete;
+
+    [[nodiscard]] int write_fd() const noexcept { return fds_[1]; }
+
+    void close_write() {
+        if (fds_[1] != -1) {
+            close(fds_[1]);
+            fds_[1] = -1;
+        }
+    }
+
+    [[nodiscard]] std::string available() const {
+        const int flags = fcntl(fds_[0], F_GETFL);
+        fcntl(fds_[0], F_SETFL, flags | O_NONBLOCK);
+
+        std::string content;
+        char buffer[4096];
+        ssize_t count = 0;
+        while ((count = read(fds_[0], buffer, sizeof(buffer))) > 0) {
+            content.append(buffer, static_cast<std::size_t>(count));
+        }
+
+        fcntl(fds_[0], F_SETFL, flags);
+        return content;
+    }
+
+  private:
+    int fds_[2]{-1, -1};
+};
+
+void test_output_is_held_until_flush() {
+    Pipe pipe;
+    FdOutputStream out(pipe.write_fd(), 64);
+
+    out << "first line\n" << "second line\n";
+    assert(pipe.available().empty());
+
+    out.flush();
+    assert(pipe.available() == "first line\nsecond line\n");
+    assert(out.writer().error() == 0);
+}
+
+void test_destructor_flushes() {
+    Pipe pipe;
+    {
+        FdOutputStream out(pipe.write_fd());
+        out << "pending" << ' ' << 42 << '\n';
+    }
+
+    assert(pipe.available() == "pending 42\n");
+}
+
+void test_writes_larger_than_buffer_keep_order() {
+    Pipe pipe;
+    FdOutputStream out(pipe.write_fd(), 16);
+
+    const std::string large(100, 'x');
+    out << "head:";
+    out << large;
+    out << ":tail";
+    assert(pipe.available() == "head:" + large);
+
+    out.flush();
+    assert(pipe.available() == ":tail");
+
+    std::string many;
+    for (int i = 0; i < 1000; ++i) {
+        out << "line " << i << '\n';
+        many += "line " + std::to_string(i) + "\n";
+    }
+    out.flush();
+    assert(pipe.available() == many);
+}
+
+void test_write_error_is_recorded() {
+    FdOutputStream out(-1, 16);
+
+    out << "lost\n";
+    out.flush();
+    assert(out.writer().error() == EBADF);
+    assert(out.bad());
+}
+
+void test_string_stream_appends_to_its_target() {
+    std::string target = "kept:";
+    {
+        StringOutputStream out(target);
+        out << "a" << 42 << '\n';
+        out << std::string(100000, 'x');
+        assert(target == "kept:a42\n" + std::string(100000, 'x'));
+    }
+    assert(target.size() == 9 + 100000);
+}
+
+} // namespace
+
+int main() {
+    test_output_is_held_until_flush();
+    test_destructor_flushes();
+    test_writes_larger_than_buffer_keep_order();
+    test_write_error_is_recorded();
+    test_string_stream_appends_to_its_target();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/glob.hpp"
+
+using shell::glob_expand;
+using shell::glob_has_magic;
+using shell::glob_match;
+
+namespace {
+
+std::string make_temp_dir() {
+    std::string pattern = "/tmp/shell_glob_XXXXXX";
+    char *created = mkdtemp(pattern.data());
+    assert(created != nullptr);
+    return created;
+}
+
+void touch(const std::string &path) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    assert(fd != -1);
+    close(fd);
+}
+
+std::vector<std::string> expand(std::string_view pattern) {
+    std::vector<std::string> paths;
+    const std::size_t count = glob_expand(pattern, [&](std::string_view path) { paths.emplace_back(path); });
+    assert(count == paths.size());
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+void test_matcher() {
+    assert(glob_match("*", "anything"));
+    assert(glob_match("*", ""));
+    assert(glob_match("a*c", "abbbc"));
+    assert(glob_match("a*c", "ac"));
+    assert(!glob_match("a*c", "acb"));
+    assert(glob_match("*.tar.*", "x.tar.gz"));
+    assert(glob_match("a*b*c", "a_b_b_c"));
+    assert(!glob_match("a*b*c", "a_c_b"));
+    assert(glob_match("?", "x"));
+    assert(!glob_match("?", ""));
+    assert(!glob_match("??", "x"));
+
+    assert(glob_match("[abc]", "b"));
+    assert(!glob_match("[abc]", "d"));
+    assert(glob_match("[a-c]x", "cx"));
+    assert(glob_match("[!a-c]", "d"));
+    assert(glob_match("[^a-c]", "d"));
+    assert(!glob_match("[!a-c]", "b"));
+    // A leading `]` is a member, and a trailing `-` is literal.
+    assert(glob_match("[]a]", "]"));
+    assert(glob_match("[a-]", "-"));
+    // An unterminated bracket is an ordinary character.
+    assert(glob_match("[ab", "[ab"));
+    assert(!glob_match("[ab", "a"));
+
+    assert(glob_match(R"(\*)", "*"));
+    assert(!glob_match(R"(\*)", "x"));
+    assert(glob_match(R"(a\?b)", "a?b"));
+    assert(glob_match(R"([\]])", "]"));
+
+    // A long run of stars against a near miss stays cheap.
+    assert(!glob_match("*a*a*a*a*a*a*a*a*b", std::string(200, 'a')));
+}
+
+void test_magic() {
+    assert(glob_has_magic("*.txt"));
+    assert(glob_has_magic("a?"));
+    assert(glob_has_magic("[ab]"));
+    assert(!glob_has_magic("plain"));
+    assert(!glob_has_magic("["));
+    assert(!glob_has_magic("[ab"));
+    assert(!glob_has_magic(R"(\*\?)"));
+}
+
+void test_expansion() {
+    const std::string root = make_temp_dir();
+    mkdir((root + "/src").c_str(), 0755);
+    mkdir((root + "/src/core").c_str(), 0755);
+    mkdir((root + "/src/app").c_str(), 0755);
+    mkdir((root + "/.hidden").c_str(), 0755);
+    touch(root + "/src/core/a.cpp");
+    touch(root + "/src/core/a.hpp");
+    touch(root + "/src/app/main.cpp");
+    touch(root + "/src/notes.txt");
+    touch(root + "/.hidden/x.cpp");
+    touch(root + "/.profile");
+    touch(root + "/readme");
+
+    using paths = std::vector<std::string>;
+    assert(expand(root + "/*") == (paths{root + "/readme", root + "/src"}));
+    assert(expand(root + "/.*") == (paths{root + "/.hidden", root + "/.profile"}));
+    assert(expand(root + "/src/*/*.cpp") == (paths{root + "/src/app/main.cpp", root + "/src/core/a.cpp"}));
+    // Files at a middle level are never descended into.
+    assert(expand(root + "/src/*/a.?pp") == (paths{root + "/src/core/a.cpp", root + "/src/core/a.hpp"}));
+    assert(expand(root + "/*/*/") == (paths{root + "/src/app/", root + "/src/core/"}));
+    assert(expand(root + "/src/[!c]*") == (paths{root + "/src/app", root + "/src/notes.txt"}));
+    assert(expand(root + "/nosuch/*").empty());
+    assert(expand(root + "/*.none").empty());
+    // Without a wildcard nothing is looked up.
+    assert(expand(root + "/readme").empty());
+
+    // Relative patterns are read from the working directory.
+    const auto saved = std::filesystem::current_path();
+    std::filesystem::current_path(root + "/src");
+    assert(expand("*/a.*") == (paths{"core/a.cpp", "core/a.hpp"}));
+    std::filesystem::current_path(saved);
+
+    std::filesystem::remove_all(root);
+}
+
+} // namespace
+
+int main() {
+    test_matcher();
+    test_magic();
+    test_expansion();
+
+    return 0;
+}
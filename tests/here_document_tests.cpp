@@ -0,0 +1,121 @@
+#include <cassert>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "execution/here_document.hpp"
+
+using shell::HereDocument;
+
+namespace {
+
+std::string read_all(int fd) {
+    std::string text;
+    char buffer[4096];
+    while (true) {
+        const ssize_t count = read(fd, buffer, sizeof(buffer));
+        assert(count != -1);
+        if (count == 0) {
+            return text;
+        }
+        text.append(buffer, static_cast<std::size_t>(count));
+    }
+}
+
+bool is_fifo(int fd) {
+    struct stat info{};
+    assert(fstat(fd, &info) == 0);
+    return S_ISFIFO(info.st_mode);
+}
+
+void test_small_body_goes_through_a_pipe() {
+    HereDocument body;
+    body.append("first line\n");
+    body.append("second line\n");
+
+    const int fd = body.finish();
+    assert(fd != -1 && body.error().empty());
+    assert(is_fifo(fd));
+    assert((fcntl(fd, F_GETFD) & FD_CLOEXEC) != 0);
+    assert(read_all(fd) == "first line\nsecond line\n");
+
+    // An empty body is an empty pipe.
+    HereDocument empty;
+    const int empty_fd = empty.finish();
+    assert(empty_fd != -1 && read_all(empty_fd).empty());
+}
+
+void test_large_body_goes_into_a_sealed_memfd() {
+    const std::string line(1000, 'x');
+    std::string expected;
+
+    HereDocument body;
+    // Enough to spill the buffer more than once.
+    for (int i = 0; i < 200; ++i) {
+        const std::string numbered = std::to_string(i) + line + "\n";
+        body.append(numbered);
+        expected += numbered;
+    }
+    // A single piece larger than the buffer goes straight through.
+    const std::string huge(HereDocument::buffer_capacity * 2, 'y');
+    body.append(huge);
+    expected += huge;
+
+    const int fd = body.finish();
+    assert(fd != -1);
+    assert(!is_fifo(fd));
+    assert((fcntl(fd, F_GET_SEALS) & (F_SEAL_WRITE | F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL)) ==
+           (F_SEAL_WRITE | F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL));
+    assert(read_all(fd) == expected);
+
+    // Nobody can change the body after the fact.
+    assert(write(fd, "z", 1) == -1 && errno == EPERM);
+    assert(ftruncate(fd, 0) == -1);
+}
+
+void test_body_just_over_the_pipe_limit_uses_memfd() {
+    HereDocument body;
+    body.append(std::string(HereDocument::pipe_limit, 'a'));
+    const int at_limit = body.finish();
+    assert(is_fifo(at_limit));
+
+    HereDocument larger;
+    larger.append(std::string(HereDocument::pipe_limit + 1, 'a'));
+    const int fd = larger.finish();
+    assert(fd != -1 && !is_fifo(fd));
+    assert(read_all(fd).size() == HereDocument::pipe_limit + 1);
+}
+
+void test_release_and_move_transfer_the_descriptor() {
+    HereDocument body;
+    body.append("moved\n");
+
+    HereDocument moved(std::move(body));
+    const int fd = moved.finish();
+    assert(fd != -1);
+    assert(moved.release() == fd);
+    assert(moved.release() == -1);
+
+    // Released descriptors survive the document.
+    {
+        const HereDocument gone(std::move(moved));
+    }
+    assert(read_all(fd) == "moved\n");
+    close(fd);
+}
+
+} // namespace
+
+int main() {
+    test_small_body_goes_through_a_pipe();
+    test_large_body_goes_into_a_sealed_memfd();
+    test_body_just_over_the_pipe_limit_uses_memfd();
+    test_release_and_move_transfer_the_descriptor();
+
+    return 0;
+}
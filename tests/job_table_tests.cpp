@@ -0,0 +1,283 @@
+#include <cassert>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "app/shell_parameters.hpp"
+#include "builtins/builtin_registry.hpp"
+#include "core/path_resolver.hpp"
+#include "execution/job_table.hpp"
+#include "execution/process_executor.hpp"
+#include "history/history_manager.hpp"
+
+using shell::BuiltinRegistry;
+using shell::Command;
+using shell::HistoryManager;
+using shell::JobTable;
+using shell::PathResolver;
+using shell::Pipeline;
+using shell::ProcessExecutor;
+using shell::RedirectionOp;
+using shell::ShellParameters;
+using shell::SpawnBackend;
+
+namespace {
+
+namespace fs = std::filesystem;
+
+std::string make_temp_file() {
+    std::string pattern = "/tmp/shell_job_table_XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+
+    const int fd = mkstemp(buffer.data());
+    assert(fd != -1);
+    close(fd);
+
+    return buffer.data();
+}
+
+std::string slurp(const std::string &path) {
+    std::ifstream file(path);
+    return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+// A child that exits with `code` once `delay` has passed.
+pid_t start_child(int code, std::chrono::milliseconds delay = {}) {
+    const pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        std::this_thread::sleep_for(delay);
+        _exit(code);
+    }
+
+    return pid;
+}
+
+// Reaps until the first `count` jobs have finished.
+void reap_until_finished(JobTable &jobs, std::size_t count, bool signalled_only) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    const auto finished = [&jobs, count] {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!jobs.jobs()[i].finished()) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    while (!finished()) {
+        assert(std::chrono::steady_clock::now() < deadline);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (signalled_only) {
+            jobs.reap_if_signalled();
+        } else {
+            jobs.reap();
+        }
+    }
+}
+
+void test_jobs_are_reaped_listed_and_forgotten() {
+    JobTable jobs;
+    assert(jobs.empty());
+
+    assert(jobs.add(std::vector<pid_t>{start_child(0)}, "true &") == 1);
+    assert(jobs.add(std::vector<pid_t>{start_child(0), start_child(3)}, "a | b &") == 2);
+    const pid_t sleeper = start_child(0, std::chrono::seconds(30));
+    assert(jobs.add(std::vector<pid_t>{sleeper}, "sleep 30 &") == 3);
+
+    reap_until_finished(jobs, 2, false);
+    {
+        std::ostringstream listing;
+        jobs.print(listing);
+        assert(listing.str() == "[1]   Done                    true &\n"
+                                "[2]-  Exit 3                  a | b &\n"
+                                "[3]+  Running                 sleep 30 &\n");
+    }
+
+    // Finished jobs are listed once.
+    kill(sleeper, SIGKILL);
+    reap_until_finished(jobs, 1, false);
+    {
+        std::ostringstream listing;
+        jobs.print(listing);
+        const std::string state = strsignal(SIGKILL);
+        assert(listing.str() == "[3]+  " + state + std::string(24 - state.size(), ' ') + "sleep 30 &\n");
+    }
+    assert(jobs.empty());
+
+    // Numbering starts over once every job is gone.
+    assert(jobs.add(std::vector<pid_t>{start_child(0)}, "true &") == 1);
+    jobs.wait_all();
+}
+
+void test_waiting_for_jobs_and_pids() {
+    JobTable jobs;
+
+    const int slow = jobs.add(std::vector<pid_t>{start_child(4, std::chrono::milliseconds(50))}, "slow &");
+    assert(jobs.wait_job(slow) == 4);
+    assert(jobs.empty());
+    assert(!jobs.wait_job(slow).has_value());
+
+    const pid_t middle = start_child(5);
+    const pid_t last = start_child(6, std::chrono::milliseconds(20));
+    jobs.add(std::vector<pid_t>{middle, last}, "a | b &");
+    assert(jobs.wait_pid(middle) == 5);
+    assert(!jobs.empty());
+    assert(jobs.wait_pid(last) == 6);
+    assert(jobs.empty());
+    assert(!jobs.wait_pid(getpid()).has_value());
+
+    // A stage that never started counts as failed.
+    jobs.add(std::vector<pid_t>{start_child(0), -1}, "ok | missing &");
+    jobs.add(std::vector<pid_t>{start_child(0)}, "true &");
+    jobs.wait_all();
+    assert(jobs.empty());
+
+    const pid_t lost = start_child(0);
+    jobs.add(std::vector<pid_t>{lost}, "lost &");
+    int status = 0;
+    assert(waitpid(lost, &status, 0) == lost);
+    assert(jobs.wait_pid(lost) == 127);
+}
+
+void test_sigchld_flag_drives_reaping() {
+    JobTable::install_sigchld_handler();
+
+    JobTable jobs;
+    jobs.add(std::vector<pid_t>{start_child(2)}, "false &");
+    reap_until_finished(jobs, 1, true);
+
+    std::ostringstream report;
+    jobs.report_finished(report);
+    assert(report.str() == "[1]+  Exit 2                  false &\n");
+    assert(jobs.empty());
+
+    signal(SIGCHLD, SIG_DFL);
+}
+
+void test_start_background(SpawnBackend backend) {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    ProcessExecutor executor(resolver, backend);
+    JobTable &jobs = builtins.jobs();
+    ShellParameters parameters(builtins.variables());
+    assert(!parameters.parameter("!").has_value());
+    const std::string output_file = make_temp_file();
+
+    {
+        Pipeline pipeline;
+        pipeline.background = true;
+        pipeline.stages.push_back(Command{.name = "echo", .args = {"abc"}, .redirections = {}});
+        pipeline.stages.push_back(Command{
+            .name = "wc",
+            .args = {"-c"},
+            .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+
+        const auto pids = executor.start_background(pipeline, builtins);
+        assert(pids.size() == 2 && pids[0] > 0 && pids[1] > 0);
+        const int id = jobs.add(pids, "echo abc | wc -c > out &");
+        assert(jobs.wait_job(id) == 0);
+        assert(slurp(output_file).find('4') != std::string::npos);
+    }
+
+    // The first stage reads /dev/null, so cat ends at once with no output.
+    {
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{
+            .name = "cat",
+            .args = {},
+            .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+
+        const auto pids = executor.start_background(pipeline, builtins);
+        assert(pids.size() == 1);
+        jobs.add(pids, "cat > out &");
+        parameters.set_last_background_pid(pids[0]);
+        assert(parameters.parameter("!") == std::to_string(pids[0]));
+        assert(jobs.wait_pid(pids[0]) == 0);
+        assert(slurp(output_file).empty());
+    }
+
+    {
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "definitely_missing_command_for_jobs", .args = {}, .redirections = {}});
+        const int id = jobs.add(executor.start_background(pipeline, builtins), "missing &");
+        assert(jobs.wait_job(id) == 127);
+    }
+
+    std::error_code ec;
+    fs::remove(output_file, ec);
+}
+
+void test_jobs_and_wait_builtins() {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    JobTable &jobs = builtins.jobs();
+
+    assert(builtins.is_builtin("jobs") && builtins.is_builtin("wait"));
+    assert(builtins.runs_in_process("jobs", {}));
+    assert(!builtins.runs_in_process("wait", {}));
+
+    const pid_t sleeper = start_child(0, std::chrono::seconds(30));
+    jobs.add(std::vector<pid_t>{sleeper}, "sleep 30 &");
+    const pid_t quick = start_child(7);
+    jobs.add(std::vector<pid_t>{quick}, "exit 7 &");
+
+    {
+        std::ostringstream out;
+        std::ostringstream err;
+        assert(builtins.execute("jobs", {}, out, err) == 0);
+        assert(out.str().starts_with("[1]-  Running                 sleep 30 &\n[2]+  "));
+    }
+
+    {
+        std::ostringstream out;
+        std::ostringstream err;
+        const std::string pid = std::to_string(quick);
+        assert(builtins.execute("wait", {pid}, out, err) == 7);
+        assert(jobs.jobs().size() == 1);
+        assert(builtins.execute("wait", {"%2"}, out, err) == 127);
+        assert(err.str().ends_with("wait: %2: no such job\n"));
+        assert(builtins.execute("wait", {"1"}, out, err) == 127);
+        assert(err.str().ends_with("wait: pid 1 is not a child of this shell\n"));
+        assert(builtins.execute("wait", {"x"}, out, err) == 1);
+        assert(builtins.execute("wait", {"%0"}, out, err) == 1);
+        assert(err.str().ends_with("wait: `%0': not a pid or valid job spec\n"));
+    }
+
+    kill(sleeper, SIGTERM);
+    {
+        std::ostringstream out;
+        std::ostringstream err;
+        assert(builtins.execute("wait", {"%1"}, out, err) == 128 + SIGTERM);
+        assert(builtins.execute("wait", {}, out, err) == 0);
+        assert(builtins.execute("jobs", {}, out, err) == 0);
+        assert(out.str().empty() && err.str().empty());
+    }
+}
+
+} // namespace
+
+int main() {
+    test_jobs_are_reaped_listed_and_forgotten();
+    test_waiting_for_jobs_and_pids();
+    test_sigchld_flag_drives_reaping();
+    test_start_background(SpawnBackend::PosixSpawn);
+    test_start_background(SpawnBackend::Fork);
+    test_jobs_and_wait_builtins();
+
+    return 0;
+}
@@ -1,16 +1,53 @@
 #include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "core/lexer_scan.hpp"
+#include "core/line_arena.hpp"
+#include "core/parameters.hpp"
 #include "core/parser.hpp"
 #include "core/tokenizer.hpp"
 
+using shell::ArenaResource;
+using shell::Lexer;
+using shell::ParameterSource;
+using shell::LineArena;
 using shell::Parser;
+using shell::ScanKernel;
 using shell::RedirectionOp;
+using shell::Token;
+using shell::TokenKind;
 using shell::Tokenizer;
 
 namespace {
 
+std::size_t allocation_count = 0;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+    ++allocation_count;
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, std::size_t /*size*/) noexcept { std::free(memory); }
+
+namespace {
+
 void test_tokenizer_quotes_and_pipeline() {
     Tokenizer tokenizer;
     const auto tokens = tokenizer.tokenize(R"(echo "hello world" | wc -c)");
@@ -48,11 +85,10 @@ void test_tokenizer_quotes_escapes_and_append_operators() {
 }
 
 void test_parser_extracts_redirections() {
-    Tokenizer tokenizer;
     Parser parser;
+    LineArena arena;
 
-    const auto tokens = tokenizer.tokenize("echo hi > out.txt 2>> err.txt");
-    auto pipeline_result = parser.parse(tokens);
+    auto pipeline_result = parser.parse("echo hi > out.txt 2>> err.txt", arena);
 
     assert(pipeline_result.has_value());
     const auto &pipeline = pipeline_result.value();
@@ -61,7 +97,7 @@ void test_parser_extracts_redirections() {
     const auto &command = pipeline.stages.front();
 
     assert(command.name == "echo");
-    assert(command.args == std::vector<std::string>({"hi"}));
+    assert(command.args == std::pmr::vector<std::string_view>({"hi"}));
     assert(command.redirections.size() == 2);
     assert(command.redirections[0].op == RedirectionOp::StdoutTruncate);
     assert(command.redirections[0].target == "out.txt");
@@ -70,49 +106,61 @@ void test_parser_extracts_redirections() {
 }
 
 void test_parser_parses_all_redirection_operators() {
-    Tokenizer tokenizer;
     Parser parser;
+    LineArena arena;
 
-    const auto tokens = tokenizer.tokenize("echo hi 1>> out.txt 2> err.txt");
-    auto parsed = parser.parse(tokens);
-    assert(parsed.has_value());
+    {
+        const auto parsed = parser.parse("echo hi 1>> out.txt 2> err.txt", arena);
+        assert(parsed.has_value());
 
-    const auto &command = parsed->stages.front();
-    assert(command.redirections.size() == 2);
-    assert(command.redirections[0].op == RedirectionOp::StdoutAppend);
-    assert(command.redirections[1].op == RedirectionOp::StderrTruncate);
+        const auto &command = parsed->stages.front();
+        assert(command.redirections.size() == 2);
+        assert(command.redirections[0].op == RedirectionOp::StdoutAppend);
+        assert(command.redirections[1].op == RedirectionOp::StderrTruncate);
+    }
+
+    {
+        const auto input = parser.parse(R"(sort<in.txt -r 0< "a b" | wc '<' x\<y)", arena);
+        assert(input.has_value() && input->stages.size() == 2);
+        const auto &sort = input->stages[0];
+        assert(sort.name == "sort" && sort.args.size() == 1);
+        assert(sort.redirections.size() == 2);
+        assert(sort.redirections[0].op == RedirectionOp::StdinRead && sort.redirections[0].target == "in.txt");
+        assert(sort.redirections[1].op == RedirectionOp::StdinRead && sort.redirections[1].target == "a b");
+        assert(input->stages[1].redirections.empty());
+        assert(input->stages[1].args.size() == 2 && input->stages[1].args[0] == "<" && input->stages[1].args[1] == "x<y");
+    }
+
+    assert(!parser.parse("cat <", arena).has_value());
+    assert(!parser.parse("< in.txt", arena).has_value());
 }
 
 void test_parser_rejects_invalid_syntax() {
-    Tokenizer tokenizer;
     Parser parser;
+    LineArena arena;
 
-    const auto malformed_redirection = tokenizer.tokenize("echo hi >");
-    assert(!parser.parse(malformed_redirection).has_value());
-
-    const auto leading_pipe = tokenizer.tokenize("| echo hi");
-    assert(!parser.parse(leading_pipe).has_value());
-
-    const auto trailing_pipe = tokenizer.tokenize("echo hi |");
-    assert(!parser.parse(trailing_pipe).has_value());
-
-    const auto redirection_before_command = tokenizer.tokenize("> out.txt");
-    assert(!parser.parse(redirection_before_command).has_value());
+    assert(!parser.parse("echo hi >", arena).has_value());
+    assert(!parser.parse("| echo hi", arena).has_value());
+    assert(!parser.parse("echo hi |", arena).has_value());
+    assert(!parser.parse("> out.txt", arena).has_value());
+    assert(!parser.parse("echo hi > | wc", arena).has_value());
+    assert(!parser.parse("echo hi > >> out.txt", arena).has_value());
 }
 
 void test_redirection_fd_digits_only_at_token_start() {
     Tokenizer tokenizer;
     Parser parser;
+    LineArena arena;
 
     {
         const auto tokens = tokenizer.tokenize("echo hi1>/tmp/out");
         const std::vector<std::string> expected{"echo", "hi1", ">", "/tmp/out"};
         assert(tokens == expected);
 
-        auto parsed = parser.parse(tokens);
+        auto parsed = parser.parse("echo hi1>/tmp/out", arena);
         assert(parsed.has_value());
         const auto &command = parsed->stages.front();
-        assert(command.args == std::vector<std::string>({"hi1"}));
+        assert(command.args == std::pmr::vector<std::string_view>({"hi1"}));
         assert(command.redirections.size() == 1);
         assert(command.redirections.front().op == RedirectionOp::StdoutTruncate);
     }
@@ -130,6 +178,617 @@ void test_redirection_fd_digits_only_at_token_start() {
     }
 }
 
+void test_tokenizer_skips_comments() {
+    Tokenizer tokenizer;
+
+    assert(tokenizer.tokenize("#!/usr/bin/env shell").empty());
+    assert(tokenizer.tokenize("   # indented comment").empty());
+
+    {
+        const auto tokens = tokenizer.tokenize("echo a#b '#quoted' # trailing | wc");
+        const std::vector<std::string> expected{"echo", "a#b", "#quoted"};
+        assert(tokens == expected);
+    }
+}
+
+void test_tokenizer_views_input_and_uses_arena_for_respelled_words() {
+    Tokenizer tokenizer;
+    LineArena arena;
+
+    const std::string line = R"(echo plain "quoted" a'b'c "x\"y" 2>> err.txt)";
+    const auto tokens = tokenizer.tokenize(line, arena);
+    const std::vector<std::string_view> expected{"echo", "plain", "quoted", "abc", R"(x"y)", "2>>", "err.txt"};
+    assert(tokens.size() == expected.size());
+    for (std::size_t i = 0; i < tokens.size(); ++i) {
+        assert(tokens[i].text == expected[i]);
+    }
+
+    const auto points_into_line = [&](const Token &token) {
+        return token.text.data() >= line.data() && token.text.data() + token.text.size() <= line.data() + line.size();
+    };
+    assert(points_into_line(tokens[0]));
+    assert(points_into_line(tokens[1]));
+    assert(points_into_line(tokens[2]));
+    assert(points_into_line(tokens[5]));
+    assert(points_into_line(tokens[6]));
+    assert(!points_into_line(tokens[3]));
+    assert(!points_into_line(tokens[4]));
+
+    // The arena is rewound, not reallocated, for a line that fits.
+    const std::string next = "'a'b'c'";
+    const auto reused = tokenizer.tokenize(next, arena);
+    assert(reused.size() == 1 && reused.front().text == "abc");
+    assert(reused.front().text.data() == tokens[3].text.data());
+
+    Parser parser;
+    const auto parsed = parser.parse(line, arena);
+    assert(parsed.has_value());
+    const auto &command = parsed->stages.front();
+    assert(command.args.size() == 4);
+    assert(command.args[1].data() == line.data() + 12);
+    assert(command.redirections.front().target.data() == line.data() + line.size() - 7);
+}
+
+void test_scan_kernels_agree_with_scalar_lexing() {
+    // Specials land at every offset within and across 16/32-byte blocks, and
+    // bytes above 0x7f must stay ordinary.
+    std::string text;
+    for (int i = 0; i < 300; ++i) {
+        text.append(static_cast<std::size_t>(i % 37), 'a');
+        text.push_back("\t\n\v\f\r '\"`\\|><&$*?[#12\x7f\x80\xff\x08\x0e"[i % 27]);
+    }
+
+    const auto reference = [&](std::size_t from, bool double_quoted) {
+        for (std::size_t i = from; i < text.size(); ++i) {
+            const char c = text[i];
+            const bool special = double_quoted ? c == '"' || c == '\\' || c == '$' || c == '`'
+                                               : shell::is_lexer_space(c) || c == '\'' || c == '"' || c == '`' ||
+                                                     c == '\\' || c == '|' || c == '>' || c == '<' || c == '&' ||
+                                                     c == '$' || c == '*' || c == '?' || c == '[';
+            if (special) {
+                return i;
+            }
+        }
+
+        return text.size();
+    };
+
+    Tokenizer tokenizer;
+    const std::string line = std::string(70, 'w') + R"( "quoted run \" with \\ and \x" 'single | quoted' a\ b 2>>err | wc)";
+    const auto original_kernel = shell::active_scan_kernel();
+    assert(shell::select_scan_kernel(ScanKernel::Scalar));
+    const auto expected = tokenizer.tokenize(line);
+
+    for (const auto kernel : {ScanKernel::Scalar, ScanKernel::Sse2, ScanKernel::Avx2}) {
+        if (!shell::select_scan_kernel(kernel)) {
+            assert(!shell::scan_kernel_supported(kernel));
+            continue;
+        }
+
+        assert(shell::active_scan_kernel() == kernel);
+        for (std::size_t from = 0; from <= text.size(); ++from) {
+            assert(shell::find_unquoted_special(text, from) == reference(from, false));
+            assert(shell::find_double_quoted_special(text, from) == reference(from, true));
+        }
+
+        assert(tokenizer.tokenize(line) == expected);
+    }
+
+    assert(expected.size() == 8);
+    assert(expected[1] == R"(quoted run " with \ and \x)");
+    assert(expected[2] == "single | quoted");
+    assert(expected[3] == "a b");
+    assert(shell::select_scan_kernel(original_kernel));
+    assert(shell::scan_kernel_supported(ScanKernel::Scalar));
+}
+
+void test_lexer_types_tokens_and_quoted_operators_stay_words() {
+    Tokenizer tokenizer;
+    LineArena arena;
+
+    const auto tokens = tokenizer.tokenize(R"(echo "|" '>' a\| b|c>>d 2>e)", arena);
+    assert(tokens.size() == 11);
+
+    const TokenKind kinds[] = {
+        TokenKind::Word,
+        TokenKind::Word,
+        TokenKind::Word,
+        TokenKind::Word,
+        TokenKind::Word,
+        TokenKind::Pipe,
+        TokenKind::Word,
+        TokenKind::Redirection,
+        TokenKind::Word,
+        TokenKind::Redirection,
+        TokenKind::Word,
+    };
+    for (std::size_t i = 0; i < tokens.size(); ++i) {
+        assert(tokens[i].kind == kinds[i]);
+    }
+
+    assert(tokens[1].text == "|");
+    assert(tokens[2].text == ">");
+    assert(tokens[3].text == "a|");
+    assert(tokens[7].fd == 1 && tokens[7].append);
+    assert(tokens[9].fd == 2 && !tokens[9].append);
+
+    Parser parser;
+    {
+        const auto parsed = parser.parse(R"(echo "|" x '>' y)", arena);
+        assert(parsed.has_value());
+        assert(parsed->stages.size() == 1);
+        assert(parsed->stages.front().args == std::pmr::vector<std::string_view>({"|", "x", ">", "y"}));
+        assert(parsed->stages.front().redirections.empty());
+    }
+
+    const auto blank = parser.parse("   # only a comment", arena);
+    assert(blank.has_value() && blank->empty());
+}
+
+void test_arena_resource_reuses_blocks_after_rewind() {
+    ArenaResource resource(64);
+
+    void *small = resource.allocate(24, 8);
+    void *aligned = resource.allocate(8, 64);
+    void *large = resource.allocate(1000, 16);
+    assert(reinterpret_cast<std::uintptr_t>(aligned) % 64 == 0);
+    assert(reinterpret_cast<std::uintptr_t>(large) % 16 == 0);
+    const auto blocks = resource.block_count();
+    assert(blocks >= 2);
+
+    resource.deallocate(large, 1000, 16);
+    resource.rewind();
+    assert(resource.allocate(24, 8) == small);
+    assert(resource.allocate(8, 64) == aligned);
+    assert(resource.allocate(1000, 16) == large);
+    assert(resource.block_count() == blocks);
+}
+
+void test_parser_reuses_line_arena_without_heap_allocations() {
+    Parser parser;
+    LineArena arena;
+    const std::string line = R"(printf '%s\n' a b c d e f g h | sort -r | uniq -c > out.txt 2>> err.txt)";
+
+    {
+        const auto warm_up = parser.parse(line, arena);
+        assert(warm_up.has_value() && warm_up->stages.size() == 3);
+    }
+
+    const auto blocks = arena.arena_resource().block_count();
+    const auto allocations_before = allocation_count;
+    for (int i = 0; i < 100; ++i) {
+        const auto parsed = parser.parse(line, arena);
+        assert(parsed.has_value());
+        assert(parsed->stages[0].args.size() == 9);
+        assert(parsed->stages[2].redirections.size() == 2);
+    }
+
+    assert(allocation_count == allocations_before);
+    assert(arena.arena_resource().block_count() == blocks);
+}
+
+void test_parser_recognizes_time_keyword() {
+    Parser parser;
+    LineArena arena;
+
+    {
+        const auto parsed = parser.parse("time sort data | uniq -c", arena);
+        assert(parsed.has_value());
+        assert(parsed->timing == shell::PipelineTiming::Total);
+        assert(parsed->stages.size() == 2 && parsed->stages[0].name == "sort");
+    }
+
+    {
+        const auto parsed = parser.parse("time -v ls -l", arena);
+        assert(parsed.has_value());
+        assert(parsed->timing == shell::PipelineTiming::PerStage);
+        assert(parsed->stages.size() == 1 && parsed->stages[0].name == "ls");
+    }
+
+    {
+        const auto parsed = parser.parse("time", arena);
+        assert(parsed.has_value() && parsed->empty());
+        assert(parsed->timing == shell::PipelineTiming::Total);
+    }
+
+    // Only an unquoted first word is the keyword.
+    for (const char *line : {R"("time" ls)", R"(ti\me ls)", "echo time", "ls | time"}) {
+        const auto parsed = parser.parse(line, arena);
+        assert(parsed.has_value());
+        assert(parsed->timing == shell::PipelineTiming::None);
+    }
+
+    {
+        const auto parsed = parser.parse("time echo -v", arena);
+        assert(parsed.has_value() && parsed->timing == shell::PipelineTiming::Total);
+        assert(parsed->stages[0].args.size() == 1 && parsed->stages[0].args[0] == "-v");
+    }
+
+    assert(!parser.parse("time | wc", arena).has_value());
+}
+
+void test_parser_marks_background_pipelines() {
+    Parser parser;
+    LineArena arena;
+
+    {
+        const auto parsed = parser.parse("sleep 1 | wc -c &", arena);
+        assert(parsed.has_value() && parsed->background);
+        assert(parsed->stages.size() == 2 && parsed->stages[1].args.size() == 1);
+    }
+
+    {
+        const auto parsed = parser.parse("sleep 1&", arena);
+        assert(parsed.has_value() && parsed->background);
+        assert(parsed->stages.size() == 1 && parsed->stages[0].args[0] == "1");
+    }
+
+    {
+        const auto parsed = parser.parse(R"(echo "&" a\& '&')", arena);
+        assert(parsed.has_value() && !parsed->background);
+        assert(parsed->stages[0].args.size() == 3 && parsed->stages[0].args[1] == "a&");
+    }
+
+    assert(!parser.parse("&", arena).has_value());
+    assert(!parser.parse("ls | &", arena).has_value());
+    assert(!parser.parse("sleep 1 & ls", arena).has_value());
+    assert(!parser.parse("sleep 1 & &", arena).has_value());
+}
+
+class FakeParameters final : public ParameterSource {
+  public:
+    std::string status = "0";
+    std::string last_pid;
+
+    [[nodiscard]] std::optional<std::string_view> parameter(std::string_view name) const override {
+        if (name == "?") {
+            return status;
+        }
+        if (name == "PIPESTATUS") {
+            return "0 1";
+        }
+        if (name == "_x1") {
+            return "named";
+        }
+        if (name == "!" && !last_pid.empty()) {
+            return last_pid;
+        }
+        return std::nullopt;
+    }
+
+    mutable std::vector<std::string> commands;
+    mutable std::string output;
+
+    [[nodiscard]] std::optional<std::string_view> command_output(std::string_view command) const override {
+        commands.emplace_back(command);
+        output = command == "glob" ? "*.c" : "out(" + std::string(command) + ")";
+        return output;
+    }
+};
+
+void test_lexer_expands_special_parameters() {
+    Tokenizer tokenizer;
+    Parser parser;
+    LineArena arena;
+    FakeParameters parameters;
+    parameters.status = "127";
+
+    {
+        const std::string line = R"(echo $? x$?y "[$?]" '$?' \$? "\$?" $ a$b $!)";
+        const auto parsed = parser.parse(line, arena, &parameters);
+        assert(parsed.has_value());
+        const auto &args = parsed->stages[0].args;
+        // An unset parameter leaves no word behind.
+        assert(args.size() == 8);
+        assert(args[0] == "127");
+        assert(args[1] == "x127y");
+        assert(args[2] == "[127]");
+        assert(args[3] == "$?");
+        assert(args[4] == "$?");
+        assert(args[5] == "$?");
+        assert(args[6] == "$");
+        // Unknown names expand to nothing.
+        assert(args[7] == "a");
+    }
+
+    {
+        const auto parsed = parser.parse(R"(echo $PIPESTATUS "$_x1.$_x1"$_x1- $1 $-)", arena, &parameters);
+        assert(parsed.has_value());
+        const auto &args = parsed->stages[0].args;
+        // Values are not split into fields.
+        assert(args.size() == 4);
+        assert(args[0] == "0 1");
+        assert(args[1] == "named.namednamed-");
+        assert(args[2] == "$1" && args[3] == "$-");
+    }
+
+    // Without a parameter source `$` is ordinary.
+    assert(tokenizer.tokenize("echo $? $!") == (std::vector<std::string>{"echo", "$?", "$!"}));
+
+    // Values longer than the line continue in the arena's spill memory, and
+    // earlier words stay where they are.
+    parameters.last_pid = std::string(200, '7');
+    {
+        const std::string line = R"(a\b $!$!$! c\d)";
+        const auto parsed = parser.parse(line, arena, &parameters);
+        assert(parsed.has_value());
+        const auto &command = parsed->stages[0];
+        assert(command.name == "ab");
+        assert(command.args.size() == 2);
+        assert(command.args[0] == std::string(600, '7'));
+        assert(command.args[1] == "cd");
+    }
+}
+
+void test_parser_reads_here_document_operators() {
+    Parser parser;
+    LineArena arena;
+
+    const auto parsed = parser.parse(R"(cat <<EOF 0<<-'END' | wc <<<"a b"<<<c 2>err)", arena);
+    assert(parsed.has_value() && parsed->stages.size() == 2);
+    const auto &cat = parsed->stages[0].redirections;
+    assert(cat.size() == 2);
+    assert(cat[0].op == RedirectionOp::StdinDocument && cat[0].target == "EOF");
+    assert(!cat[0].literal && !cat[0].strip_tabs && cat[0].source_fd == -1);
+    assert(cat[1].op == RedirectionOp::StdinDocument && cat[1].target == "END");
+    assert(cat[1].literal && cat[1].strip_tabs);
+
+    const auto &wc = parsed->stages[1].redirections;
+    assert(wc.size() == 3);
+    assert(wc[0].op == RedirectionOp::StdinString && wc[0].target == "a b");
+    assert(wc[1].op == RedirectionOp::StdinString && wc[1].target == "c");
+    assert(wc[2].op == RedirectionOp::StderrTruncate);
+
+    Tokenizer tokenizer;
+    assert(tokenizer.tokenize("cat <<<x '<<'y") == (std::vector<std::string>{"cat", "<<<", "x", "<<y"}));
+    assert(!parser.parse("cat <<", arena).has_value());
+    assert(!parser.parse("cat <<< |", arena).has_value());
+}
+
+void test_lexer_expands_here_document_lines() {
+    LineArena arena;
+    FakeParameters parameters;
+    parameters.status = "3";
+
+    // Only `$` and backslash are special; quotes are kept as written.
+    const std::string line = R"(say "$?" 'x' \$? \ "q" )";
+    assert(shell::Lexer(line, arena, &parameters).expand_document() == R"(say "3" 'x' $? \ "q" )");
+
+    const std::string plain = "  no expansions here\t";
+    const auto view = shell::Lexer(plain, arena, &parameters).expand_document();
+    assert(view == plain && view.data() == plain.data());
+    assert(shell::Lexer("", arena, &parameters).expand_document().empty());
+}
+
+void test_parser_reads_descriptor_redirections() {
+    Tokenizer tokenizer;
+    Parser parser;
+    LineArena arena;
+
+    assert(tokenizer.tokenize("echo 3>x a&>b 2>&1 x9<y") ==
+           (std::vector<std::string>{"echo", "3>", "x", "a", "&>", "b", "2>&", "1", "x9", "<", "y"}));
+
+    {
+        const auto parsed = parser.parse("cmd 2>&1 >out 3<in 4>>log >&2 <&3 0>w &>both &>>more", arena);
+        assert(parsed.has_value());
+        const auto &redirections = parsed->stages[0].redirections;
+        assert(parsed->stages[0].args.empty());
+        assert(redirections.size() == 11);
+
+        const auto expect = [&redirections](std::size_t index, RedirectionOp op, int target_fd, int source_fd = -1) {
+            const auto &redirection = redirections[index];
+            return redirection.op == op && redirection.target_fd == target_fd && redirection.source_fd == source_fd;
+        };
+        assert(expect(0, RedirectionOp::Duplicate, 2, 1));
+        assert(expect(1, RedirectionOp::StdoutTruncate, 1) && redirections[1].target == "out");
+        assert(expect(2, RedirectionOp::StdinRead, 3) && redirections[2].target == "in");
+        assert(expect(3, RedirectionOp::StdoutAppend, 4));
+        assert(expect(4, RedirectionOp::Duplicate, 1, 2));
+        assert(expect(5, RedirectionOp::Duplicate, 0, 3));
+        assert(expect(6, RedirectionOp::StdoutTruncate, 0));
+        // `&>` is `>` followed by `2>&1`.
+        assert(expect(7, RedirectionOp::StdoutTruncate, 1) && redirections[7].target == "both");
+        assert(expect(8, RedirectionOp::Duplicate, 2, 1));
+        assert(expect(9, RedirectionOp::StdoutAppend, 1) && redirections[9].target == "more");
+        assert(expect(10, RedirectionOp::Duplicate, 2, 1));
+    }
+
+    const auto not_a_descriptor = parser.parse("cmd 2>&x", arena);
+    assert(!not_a_descriptor.has_value());
+    assert(not_a_descriptor.error().message == "x: redirection needs a file descriptor");
+    assert(!parser.parse("cmd >&12", arena).has_value());
+    assert(!parser.parse("cmd >&", arena).has_value());
+    assert(!parser.parse("cmd &>", arena).has_value());
+    assert(!parser.parse("&> out", arena).has_value());
+    assert(!parser.parse("cmd & > out", arena).has_value());
+}
+
+void test_lexer_expands_braced_parameters() {
+    Parser parser;
+    LineArena arena;
+    FakeParameters parameters;
+    parameters.status = "2";
+
+    const auto parsed = parser.parse(R"(echo ${_x1}s "${?}x" ${_x1 ${} ${1} '${?}' ${nosuch}z)", arena, &parameters);
+    assert(parsed.has_value());
+    const auto &args = parsed->stages[0].args;
+    assert(args.size() == 7);
+    assert(args[0] == "nameds");
+    assert(args[1] == "2x");
+    // Anything but a name or special parameter in braces stays as written.
+    assert(args[2] == "${_x1");
+    assert(args[3] == "${}");
+    assert(args[4] == "${1}");
+    assert(args[5] == "${?}");
+    assert(args[6] == "z");
+}
+
+void test_parser_reads_assignments() {
+    Parser parser;
+    LineArena arena;
+    FakeParameters parameters;
+
+    {
+        const auto parsed = parser.parse(R"(A=1 _b="two words" C= D=$_x1=x >out)", arena, &parameters);
+        assert(parsed.has_value() && parsed->stages.size() == 1);
+        const auto &command = parsed->stages[0];
+        assert(command.name.empty() && command.args.empty());
+        assert(command.assignments.size() == 4);
+        assert(command.assignments[0].name == "A" && command.assignments[0].value == "1");
+        assert(command.assignments[1].name == "_b" && command.assignments[1].value == "two words");
+        assert(command.assignments[2].name == "C" && command.assignments[2].value.empty());
+        assert(command.assignments[3].name == "D" && command.assignments[3].value == "named=x");
+        assert(command.redirections.size() == 1);
+    }
+
+    // Quoted names, names that are not names, and words after the command
+    // name are not assignments.
+    for (const std::string_view line : {R"("A"=1)", R"(\A=1)", "1A=2", "=x", "A-B=1", "echo A=1"}) {
+        const auto parsed = parser.parse(line, arena, &parameters);
+        assert(parsed.has_value() && parsed->stages[0].assignments.empty());
+        assert(!parsed->stages[0].name.empty());
+    }
+
+    // Before a command name they belong to that command, and after it they
+    // are ordinary arguments.
+    {
+        const auto parsed = parser.parse("A=1 B='x y' env C=3 | LC_ALL=C sort", arena, &parameters);
+        assert(parsed.has_value() && parsed->stages.size() == 2);
+        const auto &env = parsed->stages[0];
+        assert(env.name == "env");
+        assert(env.assignments.size() == 2);
+        assert(env.assignments[1].name == "B" && env.assignments[1].value == "x y");
+        assert(env.args.size() == 1 && env.args[0] == "C=3");
+        const auto &sort = parsed->stages[1];
+        assert(sort.name == "sort" && sort.assignments.size() == 1 && sort.assignments[0].value == "C");
+    }
+
+    const auto piped = parser.parse("A=1 | cat", arena);
+    assert(!piped.has_value());
+    assert(piped.error().message == "variable assignments without a command must stand alone");
+    assert(!parser.parse("cat | A=1", arena).has_value());
+    assert(!parser.parse("A=1 &", arena).has_value());
+}
+
+void test_lexer_marks_glob_words_and_escapes_quoted_wildcards() {
+    LineArena arena;
+    FakeParameters parameters;
+    Lexer lexer(R"(*.txt 'a*'b? "x?"[ab] \* plain a=* $_x1 "*")", arena, &parameters);
+
+    const auto expect = [&](std::string_view text, bool glob) {
+        const auto token = lexer.next();
+        assert(token.has_value() && token->text == text && token->glob == glob);
+    };
+
+    expect("*.txt", true);
+    // Quoted wildcards and backslashes in a pattern come back escaped.
+    expect(R"(a\*b?)", true);
+    expect(R"(x\?[ab])", true);
+    // Words without an unquoted wildcard keep their plain spelling.
+    expect("*", false);
+    expect("plain", false);
+    expect("a=*", true);
+    expect("named", false);
+    expect("*", false);
+    assert(!lexer.next().has_value());
+}
+
+void test_parser_expands_globs() {
+    char directory[] = "/tmp/shell_parser_glob_XXXXXX";
+    assert(mkdtemp(directory) != nullptr);
+    const std::string root = directory;
+    for (const char *name : {"b.txt", "a.txt", "c.log", "*.txt"}) {
+        const std::string path = root + "/" + name;
+        const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        assert(fd != -1);
+        close(fd);
+    }
+
+    Parser parser;
+    LineArena arena;
+    const std::string line = "ls " + root + "/?.txt '" + root + "/*.txt' " + root + "/*.none A=" + root + "/* > " +
+                             root + "/out*";
+    {
+        const auto parsed = parser.parse(line, arena);
+        assert(parsed.has_value());
+        const auto &command = parsed->stages[0];
+        // Matches come back sorted in byte order, a file named `*.txt` is an
+        // ordinary match, a quoted wildcard is literal, and a pattern that
+        // matches nothing stays as written.
+        assert(command.args.size() == 6);
+        assert(command.args[0] == root + "/*.txt");
+        assert(command.args[1] == root + "/a.txt");
+        assert(command.args[2] == root + "/b.txt");
+        assert(command.args[3] == root + "/*.txt");
+        assert(command.args[4] == root + "/*.none");
+        assert(command.args[5] == "A=" + root + "/*");
+        // Redirection targets are never globbed.
+        assert(command.redirections.size() == 1 && command.redirections[0].target == root + "/out*");
+    }
+
+    // The first match of a pattern in command position becomes the name.
+    {
+        const std::string pattern = root + "/[ab].t*";
+        const auto named = parser.parse(pattern, arena);
+        assert(named.has_value());
+        assert(named->stages[0].name == root + "/a.txt");
+        assert(named->stages[0].args.size() == 1 && named->stages[0].args[0] == root + "/b.txt");
+    }
+
+    {
+        const auto assigned = parser.parse("A='*'? env", arena);
+        assert(assigned.has_value() && assigned->stages[0].assignments[0].value == "*?");
+    }
+
+    for (const char *name : {"b.txt", "a.txt", "c.log", "*.txt"}) {
+        unlink((root + "/" + name).c_str());
+    }
+    rmdir(directory);
+}
+
+void test_lexer_substitutes_commands() {
+    LineArena arena;
+    FakeParameters parameters;
+    Lexer lexer(
+        R"--(a$(echo "x)" (y)) "$(two words)" `b\`c\$d` '$(no)' \$(no) x$(glob) "`glob`")--", arena, &parameters);
+
+    const auto expect = [&](std::string_view text, bool glob) {
+        const auto token = lexer.next();
+        assert(token.has_value() && token->text == text && token->glob == glob);
+    };
+
+    // Quoted and nested parentheses do not end the command.
+    expect(R"--(aout(echo "x)" (y)))--", false);
+    expect("out(two words)", false);
+    // Inside backquotes a backslash escapes '`' and '$'.
+    expect("out(b`c$d)", false);
+    expect("$(no)", false);
+    expect("$(no)", false);
+    // Wildcards in unquoted output make a glob pattern.
+    expect("x*.c", true);
+    expect("*.c", false);
+    assert(!lexer.next().has_value());
+    assert(parameters.commands.size() == 5);
+    assert(parameters.commands[0] == R"--(echo "x)" (y))--");
+
+    const auto plain = Tokenizer().tokenize("`a` $(b)");
+    assert(plain.size() == 2 && plain[0] == "`a`" && plain[1] == "$(b)");
+
+    // A substitution the line never closes is a syntax error and never runs.
+    Parser parser;
+    LineArena parse_arena;
+    const auto unclosed = parser.parse("echo $(echo hi", parse_arena, &parameters);
+    assert(!unclosed.has_value());
+    assert(unclosed.error().message == "unexpected EOF while looking for matching `)'");
+    const auto unclosed_quote = parser.parse(R"--(echo "$(echo ')")--", parse_arena, &parameters);
+    assert(!unclosed_quote.has_value());
+    const auto unclosed_backquote = parser.parse("echo x`echo y", parse_arena, &parameters);
+    assert(!unclosed_backquote.has_value());
+    assert(unclosed_backquote.error().message == "unexpected EOF while looking for matching ``'");
+    assert(!parser.parse("cat < `echo in", parse_arena, &parameters).has_value());
+    assert(parameters.commands.size() == 5);
+}
+
 } // namespace
 
 int main() {
@@ -139,6 +798,23 @@ int main() {
     test_parser_parses_all_redirection_operators();
     test_parser_rejects_invalid_syntax();
     test_redirection_fd_digits_only_at_token_start();
+    test_tokenizer_skips_comments();
+    test_tokenizer_views_input_and_uses_arena_for_respelled_words();
+    test_scan_kernels_agree_with_scalar_lexing();
+    test_lexer_types_tokens_and_quoted_operators_stay_words();
+    test_arena_resource_reuses_blocks_after_rewind();
+    test_parser_reuses_line_arena_without_heap_allocations();
+    test_parser_recognizes_time_keyword();
+    test_parser_marks_background_pipelines();
+    test_lexer_expands_special_parameters();
+    test_parser_reads_here_document_operators();
+    test_lexer_expands_here_document_lines();
+    test_parser_reads_descriptor_redirections();
+    test_lexer_expands_braced_parameters();
+    test_parser_reads_assignments();
+    test_lexer_marks_glob_words_and_escapes_quoted_wildcards();
+    test_parser_expands_globs();
+    test_lexer_substitutes_commands();
 
     return 0;
 }
@@ -147,11 +147,122 @@ void test_prefix_filtering_and_callback_early_stop_behavior() {
     fs::remove_all(dir, ec);
 }
 
+void test_command_hash_table_tracks_path_and_directory_changes() {
+    EnvVarGuard guard("PATH");
+
+    const fs::path early_dir = make_temp_dir();
+    const fs::path late_dir = make_temp_dir();
+    const fs::path late_cmd = late_dir / "hashed_cmd";
+
+    write_file(late_cmd, "#!/bin/sh\nexit 0\n");
+    make_executable(late_cmd);
+
+    const std::string path_env = early_dir.string() + ":" + late_dir.string();
+    setenv("PATH", path_env.c_str(), 1);
+
+    PathResolver resolver;
+    assert(resolver.cached_commands().empty());
+    assert(resolver.find_command_path("hashed_cmd") == late_cmd.string());
+    assert(resolver.find_command_path("hashed_cmd") == late_cmd.string());
+    assert(resolver.cached_command_path("hashed_cmd") == late_cmd.string());
+
+    const auto cached = resolver.cached_commands();
+    assert(cached.size() == 1);
+    assert(cached.front().name == "hashed_cmd");
+    assert(cached.front().hits == 2);
+
+    // A new executable in an earlier PATH directory bumps its mtime and must shadow the cached entry.
+    const fs::path early_cmd = early_dir / "hashed_cmd";
+    write_file(early_cmd, "#!/bin/sh\nexit 0\n");
+    make_executable(early_cmd);
+    assert(resolver.find_command_path("hashed_cmd") == early_cmd.string());
+
+    // Changing PATH drops every cached entry.
+    setenv("PATH", late_dir.c_str(), 1);
+    assert(resolver.find_command_path("hashed_cmd") == late_cmd.string());
+    assert(resolver.cached_commands().size() == 1);
+
+    resolver.remember_command("seeded", "/definitely/seeded/path");
+    assert(resolver.find_command_path("seeded") == "/definitely/seeded/path");
+    assert(resolver.forget_command("seeded"));
+    assert(!resolver.forget_command("seeded"));
+    assert(resolver.find_command_path("seeded").empty());
+
+    resolver.clear_command_cache();
+    assert(resolver.cached_commands().empty());
+    assert(!resolver.cached_command_path("hashed_cmd").has_value());
+
+    // Names containing a slash are never looked up on PATH.
+    assert(resolver.find_command_path(late_dir.filename().string() + "/hashed_cmd").empty());
+
+    std::error_code ec;
+    fs::remove_all(early_dir, ec);
+    fs::remove_all(late_dir, ec);
+}
+
+void test_broken_symlink_does_not_hide_later_entries() {
+    EnvVarGuard guard("PATH");
+
+    const fs::path dir = make_temp_dir();
+    std::error_code ec;
+    fs::create_symlink(dir / "missing_target", dir / "aaa_broken_link", ec);
+    assert(!ec);
+
+    const fs::path exe = dir / "zzz_after_link";
+    write_file(exe, "#!/bin/sh\nexit 0\n");
+    make_executable(exe);
+
+    setenv("PATH", dir.c_str(), 1);
+
+    PathResolver resolver;
+    assert(resolver.find_command_path("zzz_after_link") == exe.string());
+    assert(resolver.executable_candidates("").contains("zzz_after_link"));
+
+    fs::remove_all(dir, ec);
+}
+
+void test_find_command_path_in_searches_given_path_without_caching() {
+    EnvVarGuard guard("PATH");
+
+    const fs::path shell_dir = make_temp_dir();
+    const fs::path assigned_dir = make_temp_dir();
+    const fs::path shell_cmd = shell_dir / "assigned_cmd";
+    const fs::path assigned_cmd = assigned_dir / "assigned_cmd";
+    write_file(shell_cmd, "#!/bin/sh\nexit 0\n");
+    make_executable(shell_cmd);
+    write_file(assigned_cmd, "#!/bin/sh\nexit 0\n");
+    make_executable(assigned_cmd);
+
+    setenv("PATH", shell_dir.c_str(), 1);
+
+    PathResolver resolver;
+    assert(resolver.find_command_path("assigned_cmd") == shell_cmd.string());
+
+    const std::string assigned_path = "::/nonexistent:" + assigned_dir.string();
+    assert(resolver.find_command_path_in("assigned_cmd", assigned_path) == assigned_cmd.string());
+    assert(resolver.find_command_path_in("assigned_cmd", "/nonexistent").empty());
+    assert(resolver.find_command_path_in("assigned_cmd", "").empty());
+    assert(resolver.find_command_path_in(assigned_cmd.string(), assigned_path).empty());
+
+    // The hash table still holds the shell's own PATH result.
+    const auto cached = resolver.cached_commands();
+    assert(cached.size() == 1);
+    assert(cached.front().path == shell_cmd.string());
+    assert(cached.front().hits == 1);
+
+    std::error_code ec;
+    fs::remove_all(shell_dir, ec);
+    fs::remove_all(assigned_dir, ec);
+}
+
 } // namespace
 
 int main() {
     test_unset_path_returns_no_matches();
     test_find_command_path_ignores_non_executables();
     test_prefix_filtering_and_callback_early_stop_behavior();
+    test_command_hash_table_tracks_path_and_directory_changes();
+    test_broken_symlink_does_not_hide_later_entries();
+    test_find_command_path_in_searches_given_path_without_caching();
     return 0;
 }
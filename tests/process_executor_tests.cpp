@@ -1,9 +1,11 @@
 #include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <csignal>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <system_error>
 #include <vector>
@@ -20,16 +22,20 @@
 
 #include "builtins/builtin_registry.hpp"
 #include "core/path_resolver.hpp"
+#include "execution/exec_plan.hpp"
 #include "history/history_manager.hpp"
 
 using shell::BuiltinRegistry;
 using shell::Command;
+using shell::ExecPlan;
 using shell::HistoryManager;
 using shell::PathResolver;
 using shell::Pipeline;
+using shell::PipelineTimes;
 using shell::ProcessExecutor;
 using shell::Redirection;
 using shell::RedirectionOp;
+using shell::SpawnBackend;
 
 namespace {
 
@@ -135,7 +141,7 @@ void reap_all_children() {
     }
 }
 
-void test_execute_single_paths() {
+void test_execute_single_paths(SpawnBackend backend) {
     EnvVarGuard path_guard("PATH");
 
     const std::string dir = make_temp_dir();
@@ -149,7 +155,8 @@ void test_execute_single_paths() {
     PathResolver resolver;
     HistoryManager history_manager;
     BuiltinRegistry builtins(resolver, history_manager);
-    ProcessExecutor executor(resolver);
+    ProcessExecutor executor(resolver, backend);
+    assert(executor.spawn_backend() == backend);
 
     {
         FdCapture stdout_capture(STDOUT_FILENO);
@@ -192,7 +199,7 @@ void test_execute_single_paths() {
     fs::remove_all(dir, ec);
 }
 
-void test_execute_pipeline_paths() {
+void test_execute_pipeline_paths(SpawnBackend backend) {
     EnvVarGuard path_guard("PATH");
 
     const std::string dir = make_temp_dir();
@@ -209,7 +216,7 @@ void test_execute_pipeline_paths() {
     PathResolver resolver;
     HistoryManager history_manager;
     BuiltinRegistry builtins(resolver, history_manager);
-    ProcessExecutor executor(resolver);
+    ProcessExecutor executor(resolver, backend);
 
     Pipeline empty;
     assert(executor.execute_pipeline(empty, builtins) == 0);
@@ -229,6 +236,135 @@ void test_execute_pipeline_paths() {
         fs::remove(output_file, ec);
     }
 
+    {
+        const std::string input_file = make_temp_file();
+        const std::string output_file = make_temp_file();
+        {
+            std::ofstream input(input_file);
+            input << "abc\ndef\n";
+        }
+
+        // The file replaces the pipe for the stage that reads it.
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "echo", .args = {"ignored"}, .redirections = {}});
+        pipeline.stages.push_back(
+            Command{.name = "ext_pass", .args = {}, .redirections = {{.op = RedirectionOp::StdinRead, .target = input_file}}});
+        pipeline.stages.push_back(
+            Command{.name = "wc", .args = {"-l"}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+        assert(executor.execute_pipeline(pipeline, builtins) == 0);
+        assert(slurp(output_file).find('2') != std::string::npos);
+
+        Command single{.name = "wc",
+                       .args = {"-c"},
+                       .redirections = {{.op = RedirectionOp::StdinRead, .target = input_file},
+                                        {.op = RedirectionOp::StdoutTruncate, .target = output_file}}};
+        assert(executor.execute_single(single, builtins) == 0);
+        assert(slurp(output_file).find('8') != std::string::npos);
+
+        // An in-process builtin ignores its input, but the file must exist.
+        Pipeline builtin_input;
+        builtin_input.stages.push_back(
+            Command{.name = "echo", .args = {"x"}, .redirections = {{.op = RedirectionOp::StdinRead, .target = input_file}}});
+        builtin_input.stages.push_back(
+            Command{.name = "wc", .args = {"-c"}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+        assert(executor.execute_pipeline(builtin_input, builtins) == 0);
+        assert(slurp(output_file).find('2') != std::string::npos);
+
+        std::error_code ec;
+        fs::remove(input_file, ec);
+        FdCapture stderr_capture(STDERR_FILENO);
+        assert(executor.execute_pipeline(builtin_input, builtins) == 0);
+        assert(executor.stage_statuses()[0] == 1);
+        assert(stderr_capture.content().find("failed to open") != std::string::npos);
+        fs::remove(output_file, ec);
+    }
+
+    {
+        const fs::path both_exe = fs::path(dir) / "ext_both";
+        make_executable_script(both_exe, "#!/bin/sh\necho out\necho err >&2\necho out2\n");
+        const std::string output_file = make_temp_file();
+        const std::string count_file = make_temp_file();
+        const Redirection to_output{.op = RedirectionOp::StdoutTruncate, .target = output_file};
+        const Redirection errors_to_stdout{.op = RedirectionOp::Duplicate, .target = {}, .source_fd = 1, .target_fd = 2};
+
+        // Both streams share one offset whether the file is duplicated or
+        // named twice, so nothing is overwritten.
+        Command duplicated{.name = "ext_both", .args = {}, .redirections = {to_output, errors_to_stdout}};
+        assert(executor.execute_single(duplicated, builtins) == 0);
+        assert(slurp(output_file) == "out\nerr\nout2\n");
+
+        Command named_twice{.name = "ext_both",
+                            .args = {},
+                            .redirections = {to_output, {.op = RedirectionOp::StderrTruncate, .target = output_file}}};
+        assert(executor.execute_single(named_twice, builtins) == 0);
+        assert(slurp(output_file) == "out\nerr\nout2\n");
+
+        // A builtin's buffered output is flushed before each error it writes,
+        // so a file shared by both streams keeps them in order.
+        const std::string hashed = "ext_both\t" + both_exe.string() + "\nhash: nosuch: not found\n";
+        Command hash_both{.name = "hash", .args = {"-t", "ext_both", "nosuch"}, .redirections = {to_output, errors_to_stdout}};
+        assert(executor.execute_single(hash_both, builtins) == 1);
+        assert(slurp(output_file) == hashed);
+
+        {
+            FdCapture stdout_capture(STDOUT_FILENO);
+            const int saved_stderr = dup(STDERR_FILENO);
+            assert(saved_stderr != -1 && dup2(STDOUT_FILENO, STDERR_FILENO) != -1);
+            Pipeline hash_stage;
+            hash_stage.stages.push_back(Command{.name = "echo", .args = {"ignored"}, .redirections = {}});
+            hash_stage.stages.push_back(Command{.name = "hash", .args = {"-t", "ext_both", "nosuch"}, .redirections = {}});
+            const int status = executor.execute_pipeline(hash_stage, builtins);
+            dup2(saved_stderr, STDERR_FILENO);
+            close(saved_stderr);
+            assert(status == 1);
+            assert(stdout_capture.content() == hashed);
+        }
+
+        // Duplicated before stdout moves, stderr still goes down the pipe.
+        Pipeline piped;
+        piped.stages.push_back(Command{.name = "echo", .args = {"ignored"}, .redirections = {}});
+        piped.stages.push_back(Command{
+            .name = "ext_both",
+            .args = {},
+            .redirections = {errors_to_stdout, {.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+        piped.stages.push_back(Command{
+            .name = "wc",
+            .args = {"-l"},
+            .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = count_file}}});
+        assert(executor.execute_pipeline(piped, builtins) == 0);
+        assert(slurp(output_file) == "out\nout2\n");
+        assert(slurp(count_file).find('1') != std::string::npos);
+
+        // In-process builtin stages follow the same order.
+        Pipeline builtin_errors;
+        builtin_errors.stages.push_back(
+            Command{.name = "cd", .args = {"/definitely/missing/dir"}, .redirections = {errors_to_stdout}});
+        builtin_errors.stages.push_back(Command{
+            .name = "wc",
+            .args = {"-l"},
+            .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = count_file}}});
+        assert(executor.execute_pipeline(builtin_errors, builtins) == 0);
+        assert(slurp(count_file).find('1') != std::string::npos);
+
+        Pipeline builtin_fd;
+        builtin_fd.stages.push_back(Command{
+            .name = "echo",
+            .args = {"three"},
+            .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file, .target_fd = 3},
+                             {.op = RedirectionOp::Duplicate, .target = {}, .source_fd = 3, .target_fd = 1}}});
+        builtin_fd.stages.push_back(Command{
+            .name = "wc",
+            .args = {"-c"},
+            .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = count_file}}});
+        assert(executor.execute_pipeline(builtin_fd, builtins) == 0);
+        assert(slurp(output_file) == "three\n");
+        assert(slurp(count_file).find('0') != std::string::npos);
+
+        std::error_code ec;
+        fs::remove(output_file, ec);
+        fs::remove(count_file, ec);
+    }
+
     {
         FdCapture stdout_capture(STDOUT_FILENO);
         Pipeline pipeline;
@@ -285,6 +421,120 @@ void test_execute_pipeline_paths() {
     fs::remove_all(dir, ec);
 }
 
+void test_builtin_stages_run_in_process(SpawnBackend backend) {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    ProcessExecutor executor(resolver, backend);
+
+    const std::string output_file = make_temp_file();
+    const std::string redirected_file = make_temp_file();
+
+    {
+        // Larger than a pipe buffer, so part of it goes through a writer thread.
+        const std::string big(300000, 'x');
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "echo", .args = {big}, .redirections = {}});
+        pipeline.stages.push_back(
+            Command{.name = "wc", .args = {"-c"}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+        assert(executor.execute_pipeline(pipeline, builtins) == 0);
+        assert(slurp(output_file).find("300001") != std::string::npos);
+    }
+
+    {
+        FdCapture stdout_capture(STDOUT_FILENO);
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "echo", .args = {"dropped"}, .redirections = {}});
+        pipeline.stages.push_back(Command{.name = "echo", .args = {"kept"}, .redirections = {}});
+        assert(executor.execute_pipeline(pipeline, builtins) == 0);
+        assert(stdout_capture.content() == "kept\n");
+    }
+
+    {
+        // Output redirected away from the pipe leaves the next stage with EOF.
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "pwd",
+                                          .args = {},
+                                          .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = redirected_file}}});
+        pipeline.stages.push_back(
+            Command{.name = "wc", .args = {"-c"}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+        assert(executor.execute_pipeline(pipeline, builtins) == 0);
+        assert(slurp(redirected_file) == fs::current_path().string() + "\n");
+        assert(slurp(output_file).find('0') != std::string::npos);
+    }
+
+    {
+        // A reader that exits early ends the builtin stage with EPIPE, not the
+        // shell with SIGPIPE.
+        const std::string big(1 << 20, 'y');
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "echo", .args = {big}, .redirections = {}});
+        pipeline.stages.push_back(Command{.name = "true", .args = {}, .redirections = {}});
+        assert(executor.execute_pipeline(pipeline, builtins) == 0);
+    }
+
+    {
+        // State-changing builtins keep subshell semantics.
+        const fs::path before = fs::current_path();
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "cd", .args = {"/"}, .redirections = {}});
+        pipeline.stages.push_back(Command{.name = "true", .args = {}, .redirections = {}});
+        assert(executor.execute_pipeline(pipeline, builtins) == 0);
+        assert(fs::current_path() == before);
+    }
+
+    assert(builtins.runs_in_process("echo", {}));
+    assert(!builtins.runs_in_process("cd", {}));
+    assert(!builtins.runs_in_process("exit", {}));
+    const std::vector<std::string_view> listing{"5"};
+    const std::vector<std::string_view> reload{"-r", "file"};
+    assert(builtins.runs_in_process("history", listing));
+    assert(!builtins.runs_in_process("history", reload));
+    assert(!builtins.runs_in_process("missing_builtin", {}));
+
+    std::error_code ec;
+    fs::remove(output_file, ec);
+    fs::remove(redirected_file, ec);
+}
+
+void test_spawned_stages_get_pipes_and_redirections() {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    ProcessExecutor executor(resolver);
+    assert(executor.spawn_backend() == SpawnBackend::PosixSpawn);
+
+    const std::string output_file = make_temp_file();
+    const std::string error_file = make_temp_file();
+
+    Pipeline pipeline;
+    pipeline.stages.push_back(Command{.name = "printf", .args = {"a\\nb\\nc\\n"}, .redirections = {}});
+    pipeline.stages.push_back(Command{.name = "sort", .args = {"-r"}, .redirections = {}});
+    pipeline.stages.push_back(Command{
+        .name = "sh",
+        .args = {"-c", "cat; echo oops >&2"},
+        .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file},
+                         {.op = RedirectionOp::StderrTruncate, .target = error_file}}});
+
+    assert(executor.execute_pipeline(pipeline, builtins) == 0);
+    assert(slurp(output_file) == "c\nb\na\n");
+    assert(slurp(error_file) == "oops\n");
+
+    executor.set_spawn_backend(SpawnBackend::Fork);
+    assert(executor.execute_pipeline(pipeline, builtins) == 0);
+    assert(slurp(output_file) == "c\nb\na\n");
+
+    std::error_code ec;
+    fs::remove(output_file, ec);
+    fs::remove(error_file, ec);
+}
+
+void test_spawn_backend_names() {
+    assert(shell::spawn_backend_from_name("fork") == SpawnBackend::Fork);
+    assert(shell::spawn_backend_from_name("posix_spawn") == SpawnBackend::PosixSpawn);
+    assert(!shell::spawn_backend_from_name("vfork").has_value());
+}
+
 void test_private_process_helpers() {
     PathResolver resolver;
     ProcessExecutor executor(resolver);
@@ -349,7 +599,8 @@ void test_private_process_helpers() {
         assert(pid != -1);
         if (pid == 0) {
             Command command{.name = "definitely_missing_execvp_cmd", .args = {}, .redirections = {}};
-            executor.execute_external_in_child(command);
+            const ExecPlan plan(command.name, command);
+            ProcessExecutor::execute_external_in_child(plan);
         }
 
         int status = 0;
@@ -377,7 +628,7 @@ void test_fork_failure_paths_when_nproc_limit_is_low() {
     bool external_throw = false;
     try {
         Command command{.name = "true", .args = {}, .redirections = {}};
-        (void)executor.execute_external(command);
+        (void)executor.execute_external(ExecPlan("/bin/true", command));
     } catch (const std::runtime_error &error) {
         external_throw = std::string(error.what()).find("fork failed") != std::string::npos;
     }
@@ -387,8 +638,9 @@ void test_fork_failure_paths_when_nproc_limit_is_low() {
 
     bool pipeline_throw = false;
     try {
+        // cd changes shell state, so as a pipeline stage it still forks.
         Pipeline pipeline;
-        pipeline.stages.push_back(Command{.name = "echo", .args = {"x"}, .redirections = {}});
+        pipeline.stages.push_back(Command{.name = "cd", .args = {"/"}, .redirections = {}});
         (void)executor.execute_pipeline(pipeline, builtins);
     } catch (const std::runtime_error &error) {
         pipeline_throw = std::string(error.what()).find("fork failed") != std::string::npos;
@@ -399,14 +651,203 @@ void test_fork_failure_paths_when_nproc_limit_is_low() {
     assert(external_throw || pipeline_throw);
 }
 
+void test_pipeline_times(SpawnBackend backend) {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    ProcessExecutor executor(resolver, backend);
+
+    const std::string output_file = make_temp_file();
+    // Enough shell arithmetic to show up as CPU time.
+    const std::string busy_loop = "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done; echo done";
+
+    {
+        PipelineTimes times;
+        Pipeline pipeline;
+        pipeline.stages.push_back(Command{.name = "sh", .args = {"-c", busy_loop}, .redirections = {}});
+        pipeline.stages.push_back(Command{.name = "echo", .args = {"builtin"}, .redirections = {}});
+        pipeline.stages.push_back(
+            Command{.name = "wc", .args = {"-c"}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}});
+        assert(executor.execute_pipeline(pipeline, builtins, &times) == 0);
+
+        assert(times.stages.size() == 3);
+        assert(times.stages[0].name == "sh" && !times.stages[0].in_process);
+        assert(times.stages[1].name == "echo" && times.stages[1].in_process);
+        assert(times.stages[0].usage.user + times.stages[0].usage.system > std::chrono::microseconds::zero());
+        assert(times.stages[0].usage.max_rss_kib > 0);
+        assert(times.total.user >= times.stages[0].usage.user);
+        assert(times.total.max_rss_kib >= times.stages[2].usage.max_rss_kib);
+        assert(times.wall > std::chrono::nanoseconds::zero());
+    }
+
+    {
+        PipelineTimes times;
+        Command command{.name = "sh", .args = {"-c", busy_loop}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}};
+        assert(executor.execute_single(command, builtins, &times) == 0);
+        assert(times.stages.size() == 1 && !times.stages[0].in_process);
+        assert(times.total.user + times.total.system > std::chrono::microseconds::zero());
+    }
+
+    {
+        PipelineTimes times;
+        Command command{.name = "pwd", .args = {}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = output_file}}};
+        assert(executor.execute_single(command, builtins, &times) == 0);
+        assert(times.stages.size() == 1 && times.stages[0].in_process);
+        assert(times.total.max_rss_kib > 0);
+    }
+
+    {
+        PipelineTimes times;
+        times.wall = std::chrono::milliseconds(61'234);
+        times.total = {.user = std::chrono::microseconds(1'500), .system = {}, .max_rss_kib = 2048};
+        times.stages.push_back({.name = "cat", .usage = times.total, .in_process = false});
+        times.stages.push_back({.name = "echo", .usage = {}, .in_process = true});
+
+        std::ostringstream out;
+        shell::print_times(out, times, false);
+        assert(out.str() == "\nreal\t1m1.234s\nuser\t0m0.001s\nsys\t0m0.000s\nmaxrss\t2048k\n");
+
+        std::ostringstream verbose;
+        shell::print_times(verbose, times, true);
+        assert(verbose.str().ends_with("[1]\tuser 0m0.001s\tsys 0m0.000s\tmaxrss 2048k\tcat\n"
+                                       "[2]\tuser 0m0.000s\tsys 0m0.000s\tmaxrss 0k\techo (builtin)\n"));
+    }
+
+    std::error_code ec;
+    fs::remove(output_file, ec);
+}
+
+void test_stage_statuses_pipefail_and_timeout(SpawnBackend backend) {
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    ProcessExecutor executor(resolver, backend);
+
+    Pipeline pipeline;
+    pipeline.stages.push_back(Command{.name = "sh", .args = {"-c", "exit 3"}, .redirections = {}});
+    pipeline.stages.push_back(Command{.name = "sh", .args = {"-c", "cat >/dev/null; exit 4"}, .redirections = {}});
+    pipeline.stages.push_back(Command{.name = "true", .args = {}, .redirections = {}});
+
+    assert(executor.execute_pipeline(pipeline, builtins) == 0);
+    assert(std::ranges::equal(executor.stage_statuses(), std::vector<int>{3, 4, 0}));
+
+    builtins.options().pipefail = true;
+    assert(executor.execute_pipeline(pipeline, builtins) == 4);
+    pipeline.stages.pop_back();
+    pipeline.stages.push_back(Command{.name = "echo", .args = {}, .redirections = {{.op = RedirectionOp::StdoutTruncate, .target = "/dev/null"}}});
+    assert(executor.execute_pipeline(pipeline, builtins) == 4);
+    assert(std::ranges::equal(executor.stage_statuses(), std::vector<int>{3, 4, 0}));
+
+    Command single{.name = "sh", .args = {"-c", "exit 6"}, .redirections = {}};
+    assert(executor.execute_single(single, builtins) == 6);
+    assert(std::ranges::equal(executor.stage_statuses(), std::vector<int>{6}));
+
+    // A hung first stage is terminated at the deadline; the stages after it
+    // have long finished.
+    executor.set_pipeline_timeout(std::chrono::milliseconds(100));
+    assert(executor.pipeline_timeout() == std::chrono::milliseconds(100));
+    Pipeline hung;
+    hung.stages.push_back(Command{.name = "sleep", .args = {"10"}, .redirections = {}});
+    hung.stages.push_back(Command{.name = "sh", .args = {"-c", "exit 5"}, .redirections = {}});
+    const auto started = std::chrono::steady_clock::now();
+    {
+        FdCapture stderr_capture(STDERR_FILENO);
+        assert(executor.execute_pipeline(hung, builtins) == 5);
+        assert(stderr_capture.content() == "shell: timed out after 100ms\n");
+    }
+    assert(std::ranges::equal(executor.stage_statuses(), std::vector<int>{128 + SIGTERM, 5}));
+
+    Command sleeper{.name = "sleep", .args = {"10"}, .redirections = {}};
+    {
+        FdCapture stderr_capture(STDERR_FILENO);
+        assert(executor.execute_single(sleeper, builtins) == 128 + SIGTERM);
+    }
+    assert(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+}
+
+// Sums the argument counts the batches appended to `path`, one per line.
+std::size_t sum_counts(const fs::path &path, std::size_t &lines) {
+    std::ifstream file(path);
+    std::size_t total = 0;
+    lines = 0;
+    for (std::size_t count = 0; file >> count; ++lines) {
+        total += count;
+    }
+    return total;
+}
+
+void test_autosplit_runs_oversized_commands_in_batches(SpawnBackend backend) {
+    EnvVarGuard path_guard("PATH");
+
+    const fs::path dir = make_temp_dir();
+    const fs::path script = dir / "count_args";
+    const fs::path output = dir / "counts";
+    make_executable_script(script, "#!/bin/sh\necho $# >> \"$OUT\"\n");
+    setenv("PATH", dir.c_str(), 1);
+
+    PathResolver resolver;
+    HistoryManager history_manager;
+    BuiltinRegistry builtins(resolver, history_manager);
+    ProcessExecutor executor(resolver, backend);
+
+    // Well over ARG_MAX for the default 8 MiB stack limit.
+    const std::string arg(1024, 'a');
+    const std::string output_path = output.string();
+    Command command{.name = "count_args", .args = {}, .redirections = {}, .assignments = {{.name = "OUT", .value = output_path}}};
+    command.args.assign(3 * shell::exec_size_limit() / arg.size(), arg);
+
+    {
+        FdCapture stderr_capture(STDERR_FILENO);
+        assert(executor.execute_single(command, builtins) == 1);
+        assert(stderr_capture.content().find("Argument list too long") != std::string::npos);
+    }
+    assert(!fs::exists(output));
+
+    builtins.options().autosplit = true;
+    std::size_t lines = 0;
+    assert(executor.execute_single(command, builtins) == 0);
+    assert(sum_counts(output, lines) == command.args.size());
+    assert(lines >= 3);
+
+    fs::remove(output);
+    executor.set_autosplit_jobs(4);
+    assert(executor.autosplit_jobs() == 4);
+    assert(executor.execute_single(command, builtins) == 0);
+    assert(sum_counts(output, lines) == command.args.size());
+    executor.set_autosplit_jobs(0);
+    assert(executor.autosplit_jobs() >= 1);
+
+    // A failing batch decides the status; short commands never split.
+    make_executable_script(script, "#!/bin/sh\necho $# >> \"$OUT\"\nexit 3\n");
+    assert(executor.execute_single(command, builtins) == 3);
+    fs::remove(output);
+    command.args.resize(2);
+    assert(executor.execute_single(command, builtins) == 3);
+    assert(sum_counts(output, lines) == 2 && lines == 1);
+
+    fs::remove_all(dir);
+}
+
 } // namespace
 
 int main() {
     using_history();
     clear_history();
 
-    test_execute_single_paths();
-    test_execute_pipeline_paths();
+    test_execute_single_paths(SpawnBackend::PosixSpawn);
+    test_execute_single_paths(SpawnBackend::Fork);
+    test_execute_pipeline_paths(SpawnBackend::PosixSpawn);
+    test_execute_pipeline_paths(SpawnBackend::Fork);
+    test_builtin_stages_run_in_process(SpawnBackend::PosixSpawn);
+    test_builtin_stages_run_in_process(SpawnBackend::Fork);
+    test_pipeline_times(SpawnBackend::PosixSpawn);
+    test_pipeline_times(SpawnBackend::Fork);
+    test_stage_statuses_pipefail_and_timeout(SpawnBackend::PosixSpawn);
+    test_stage_statuses_pipefail_and_timeout(SpawnBackend::Fork);
+    test_autosplit_runs_oversized_commands_in_batches(SpawnBackend::PosixSpawn);
+    test_autosplit_runs_oversized_commands_in_batches(SpawnBackend::Fork);
+    test_spawned_stages_get_pipes_and_redirections();
+    test_spawn_backend_names();
     test_private_process_helpers();
     test_fork_failure_paths_when_nproc_limit_is_low();
 
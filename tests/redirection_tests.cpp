@@ -7,11 +7,14 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "core/command.hpp"
+#include "execution/here_document.hpp"
 #include "execution/redirection.hpp"
 
 using shell::Redirection;
@@ -115,21 +118,165 @@ void test_multiple_redirections_for_same_fd_reuses_saved_backup() {
     std::remove(path2.c_str());
 }
 
+void test_stdin_redirection_reads_file_and_restores() {
+    const std::string path = std::format("/tmp/shell_redirection_test_{}_in.txt", getpid());
+    {
+        std::ofstream file(path);
+        file << "input line\n";
+    }
+
+    struct stat before{};
+    assert(fstat(STDIN_FILENO, &before) == 0);
+
+    {
+        std::array redirections{Redirection{.op = RedirectionOp::StdinRead, .target = path}};
+        RedirectionGuard guard(redirections);
+        assert(guard.is_valid());
+
+        std::array<char, 64> buffer{};
+        const ssize_t count = read(STDIN_FILENO, buffer.data(), buffer.size());
+        assert(std::string_view(buffer.data(), static_cast<std::size_t>(count)) == "input line\n");
+    }
+
+    struct stat after{};
+    assert(fstat(STDIN_FILENO, &after) == 0);
+    assert(before.st_dev == after.st_dev && before.st_ino == after.st_ino);
+
+    // A missing input file is never created.
+    std::remove(path.c_str());
+    std::array redirections{Redirection{.op = RedirectionOp::StdinRead, .target = path}};
+    RedirectionGuard guard(redirections);
+    assert(!guard.is_valid());
+    assert(guard.error().find("No such file") != std::string::npos);
+    assert(access(path.c_str(), F_OK) == -1);
+}
+
+void test_here_strings_and_documents_feed_stdin() {
+    std::array<char, 64> buffer{};
+
+    {
+        std::array redirections{Redirection{.op = RedirectionOp::StdinString, .target = "a here-string"}};
+        RedirectionGuard guard(redirections);
+        assert(guard.is_valid());
+
+        const ssize_t count = read(STDIN_FILENO, buffer.data(), buffer.size());
+        assert(std::string_view(buffer.data(), static_cast<std::size_t>(count)) == "a here-string\n");
+    }
+
+    // A here-document's descriptor is used as is and stays open.
+    shell::HereDocument body;
+    body.append("body\n");
+    const int fd = body.finish();
+    {
+        std::array redirections{Redirection{.op = RedirectionOp::StdinDocument, .target = "EOF", .source_fd = fd}};
+        shell::OpenedRedirections opened(redirections);
+        assert(opened.is_valid());
+        assert(opened.actions().size() == 1);
+        assert(opened.actions()[0].source_fd == fd && opened.actions()[0].target_fd == STDIN_FILENO);
+    }
+    assert(fcntl(fd, F_GETFD) != -1);
+
+    std::array unread{Redirection{.op = RedirectionOp::StdinDocument, .target = "EOF"}};
+    RedirectionGuard guard(unread);
+    assert(!guard.is_valid());
+    assert(guard.error() == "here-document body was not read");
+}
+
 void test_invalid_operator_can_fail_while_saving_fd() {
     const std::string path = std::format("/tmp/shell_redirection_test_{}_invalid.txt", getpid());
 
-    const int stdout_backup = dup(STDOUT_FILENO);
-    assert(stdout_backup != -1);
-    assert(close(STDOUT_FILENO) == 0);
+    static const shell::RedirectionSyscalls failing_dup_syscalls{
+        .dup_fn = +[](int /*fd*/) {
+            errno = EMFILE;
+            return -1;
+        },
+        .open_fn = +[](const char *target, int flags, unsigned int mode) { return ::open(target, flags, mode); },
+        .dup2_fn = +[](int old_fd, int new_fd) { return ::dup2(old_fd, new_fd); },
+        .close_fn = +[](int fd) { return ::close(fd); },
+    };
 
     std::array redirections{Redirection{.op = static_cast<RedirectionOp>(999), .target = path}};
-    RedirectionGuard guard(redirections);
+    RedirectionGuard guard(redirections, &failing_dup_syscalls);
     assert(!guard.is_valid());
     assert(guard.error().find("failed to save file descriptor") != std::string::npos);
+    assert(access(path.c_str(), F_OK) == -1);
+}
+
+void test_closed_target_is_closed_again_on_restore() {
+    const std::string path = std::format("/tmp/shell_redirection_test_{}_closed.txt", getpid());
+    // The lowest free descriptor, so the file is opened as the very
+    // descriptor it is meant for and has to move aside first.
+    const int target_fd = dup(STDIN_FILENO);
+    assert(target_fd != -1 && target_fd < shell::OpenedRedirections::first_private_fd);
+    close(target_fd);
+
+    {
+        std::array redirections{Redirection{.op = RedirectionOp::StdoutTruncate, .target = path, .target_fd = target_fd}};
+        RedirectionGuard guard(redirections);
+        assert(guard.is_valid());
+        assert(write(target_fd, "seven\n", 6) == 6);
+        assert((fcntl(target_fd, F_GETFD) & FD_CLOEXEC) == 0);
+    }
+
+    assert(fcntl(target_fd, F_GETFD) == -1);
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    assert(buffer.str() == "seven\n");
+    std::remove(path.c_str());
+}
+
+void test_duplications_and_shared_targets() {
+    const std::string path = std::format("/tmp/shell_redirection_test_{}_shared.txt", getpid());
+    const std::string other = std::format("/tmp/shell_redirection_test_{}_other.txt", getpid());
+
+    // The same file named twice is opened once and both descriptors share its
+    // offset; a duplication refers to a descriptor by number.
+    {
+        std::array redirections{
+            Redirection{.op = RedirectionOp::StdoutTruncate, .target = path, .target_fd = 5},
+            Redirection{.op = RedirectionOp::StdoutAppend, .target = other, .target_fd = 6},
+            Redirection{.op = RedirectionOp::StderrTruncate, .target = path, .target_fd = 6},
+            Redirection{.op = RedirectionOp::Duplicate, .target = "5", .source_fd = 5, .target_fd = 4},
+        };
+        shell::OpenedRedirections opened(redirections);
+        assert(opened.is_valid());
+        const auto actions = opened.actions();
+        assert(actions.size() == 4);
+        assert(actions[2].source_fd == actions[0].source_fd);
+        assert(actions[1].source_fd != actions[0].source_fd);
+        assert(actions[3].source_fd == 5 && actions[3].target_fd == 4);
+    }
+
+    const auto open_fds = [] { return std::array{fcntl(4, F_GETFD) != -1, fcntl(5, F_GETFD) != -1, fcntl(6, F_GETFD) != -1}; };
+    const auto open_before = open_fds();
+    {
+        std::array redirections{
+            Redirection{.op = RedirectionOp::StdoutTruncate, .target = path, .target_fd = 5},
+            Redirection{.op = RedirectionOp::StderrTruncate, .target = path, .target_fd = 6},
+            Redirection{.op = RedirectionOp::Duplicate, .target = "5", .source_fd = 5, .target_fd = 4},
+        };
+        RedirectionGuard guard(redirections);
+        assert(guard.is_valid());
+        assert(write(5, "one ", 4) == 4);
+        assert(write(6, "two ", 4) == 4);
+        assert(write(4, "three", 5) == 5);
+    }
+    assert(open_fds() == open_before);
+
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    assert(buffer.str() == "one two three");
+
+    // Duplicating a descriptor that is not open fails when it is applied.
+    std::array bad{Redirection{.op = RedirectionOp::Duplicate, .target = "8", .source_fd = 8, .target_fd = 1}};
+    RedirectionGuard guard(bad);
+    assert(!guard.is_valid());
+    assert(guard.error().find("failed to redirect file descriptor 1") != std::string::npos);
 
-    assert(dup2(stdout_backup, STDOUT_FILENO) != -1);
-    close(stdout_backup);
     std::remove(path.c_str());
+    std::remove(other.c_str());
 }
 
 void test_invalid_operator_defaults_to_stdout_truncate() {
@@ -178,8 +325,12 @@ int main() {
     test_stdout_redirection_roundtrip();
     test_invalid_redirection_path_reports_error();
     test_stderr_redirection_and_append();
+    test_here_strings_and_documents_feed_stdin();
     test_multiple_redirections_for_same_fd_reuses_saved_backup();
+    test_stdin_redirection_reads_file_and_restores();
     test_invalid_operator_can_fail_while_saving_fd();
+    test_closed_target_is_closed_again_on_restore();
+    test_duplications_and_shared_targets();
     test_invalid_operator_defaults_to_stdout_truncate();
     test_dup2_failure_reports_error();
 
@@ -0,0 +1,97 @@
+#include <cassert>
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include "app/script_source.hpp"
+
+using shell::ScriptSource;
+
+namespace {
+
+std::vector<std::string> drain(ScriptSource &source) {
+    std::vector<std::string> lines;
+    while (const auto line = source.next_line()) {
+        lines.emplace_back(*line);
+    }
+    return lines;
+}
+
+void test_command_string_lines() {
+    auto source = ScriptSource::from_string("echo one\n\necho two");
+    const std::vector<std::string> expected{"echo one", "", "echo two"};
+    assert(drain(source) == expected);
+    assert(!source.next_line().has_value());
+
+    auto empty = ScriptSource::from_string("");
+    assert(drain(empty).empty());
+}
+
+void test_fd_lines_span_block_boundaries() {
+    int fds[2];
+    assert(pipe(fds) == 0);
+
+    const std::string long_line(100, 'x');
+    const std::string content = "short\n" + long_line + "\nlast-without-newline";
+    assert(write(fds[1], content.data(), content.size()) == static_cast<ssize_t>(content.size()));
+    close(fds[1]);
+
+    auto source = ScriptSource::from_fd(fds[0], 8);
+    const std::vector<std::string> expected{"short", long_line, "last-without-newline"};
+    assert(drain(source) == expected);
+    close(fds[0]);
+}
+
+void test_mapped_file_lines_and_moves() {
+    const std::string path = std::format("/tmp/shell_script_source_{}.sh", getpid());
+    {
+        std::ofstream file(path);
+        file << "#!/usr/bin/env shell\necho mapped\n";
+    }
+
+    auto opened = ScriptSource::open_file(path);
+    assert(opened.has_value());
+
+    ScriptSource source = std::move(*opened);
+    assert(source.next_line() == std::optional<std::string_view>("#!/usr/bin/env shell"));
+
+    ScriptSource moved = ScriptSource::from_string("");
+    moved = std::move(source);
+    assert(moved.next_line() == std::optional<std::string_view>("echo mapped"));
+    assert(!moved.next_line().has_value());
+
+    {
+        std::ofstream truncate(path, std::ios::trunc);
+    }
+    auto empty = ScriptSource::open_file(path);
+    assert(empty.has_value());
+    assert(!empty->next_line().has_value());
+
+    std::remove(path.c_str());
+}
+
+void test_open_errors() {
+    const auto missing = ScriptSource::open_file("/definitely/missing/script.sh");
+    assert(!missing.has_value());
+    assert(missing.error().find("No such file") != std::string::npos);
+
+    const auto directory = ScriptSource::open_file("/tmp");
+    assert(!directory.has_value());
+}
+
+} // namespace
+
+int main() {
+    test_command_string_lines();
+    test_fd_lines_span_block_boundaries();
+    test_mapped_file_lines_and_moves();
+    test_open_errors();
+    return 0;
+}
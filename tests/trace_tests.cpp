@@ -0,0 +1,99 @@
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "core/trace.hpp"
+
+using shell::Trace;
+using shell::TraceSpan;
+
+namespace {
+
+std::string slurp(const std::string &path) {
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+std::size_t count(std::string_view text, std::string_view needle) {
+    std::size_t found = 0;
+    for (auto at = text.find(needle); at != std::string_view::npos; at = text.find(needle, at + 1)) {
+        ++found;
+    }
+    return found;
+}
+
+void test_spans_are_written_as_complete_events() {
+    const std::string path = std::format("/tmp/shell_trace_test_{}.json", getpid());
+
+    {
+        const TraceSpan ignored("before_start");
+    }
+
+    assert(Trace::start(path));
+    assert(Trace::enabled());
+    {
+        const TraceSpan outer("line", R"(echo "quoted" \ back)");
+        const TraceSpan inner("parse");
+    }
+
+    // Spans from a forked child stay out of the parent's trace.
+    const pid_t pid = fork();
+    assert(pid != -1);
+    if (pid == 0) {
+        {
+            const TraceSpan child("child_span");
+        }
+        Trace::stop();
+        _exit(0);
+    }
+
+    int status = 0;
+    assert(waitpid(pid, &status, 0) == pid);
+
+    // Enough events to go through more than one buffered write.
+    for (int i = 0; i < 5000; ++i) {
+        const TraceSpan span("resolve", "some-command");
+    }
+
+    Trace::stop();
+    assert(!Trace::enabled());
+    {
+        const TraceSpan ignored("after_stop");
+    }
+
+    const std::string trace = slurp(path);
+    assert(trace.starts_with("[\n{"));
+    assert(trace.ends_with("}\n]\n"));
+    assert(count(trace, R"("ph":"X")") == 5002);
+    assert(count(trace, R"("name":"resolve")") == 5000);
+    assert(trace.find(R"("name":"line","cat":"shell")") != std::string::npos);
+    assert(trace.find(R"("args":{"detail":"echo \"quoted\" \\ back"})") != std::string::npos);
+    assert(trace.find("child_span") == std::string::npos);
+    assert(trace.find("before_start") == std::string::npos);
+    assert(trace.find("after_stop") == std::string::npos);
+
+    std::remove(path.c_str());
+}
+
+void test_start_reports_unwritable_path() {
+    assert(!Trace::start("/no/such/dir/trace.json"));
+    assert(!Trace::enabled());
+}
+
+} // namespace
+
+int main() {
+    test_spans_are_written_as_complete_events();
+    test_start_reports_unwritable_path();
+    return 0;
+}
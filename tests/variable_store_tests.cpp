@@ -0,0 +1,186 @@
+#include <cassert>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define private public
+#include "core/variable_store.hpp"
+#undef private
+
+using shell::VariableStore;
+
+namespace {
+
+std::set<std::string> environment_of(VariableStore &store) {
+    std::set<std::string> entries;
+    for (char *const *entry = store.envp(); *entry != nullptr; ++entry) {
+        entries.emplace(*entry);
+    }
+    return entries;
+}
+
+void test_set_get_and_unset() {
+    VariableStore store;
+    assert(!store.get("NAME").has_value());
+
+    store.set("NAME", "value");
+    assert(store.get("NAME") == "value");
+    assert(!store.exported("NAME"));
+
+    store.set("NAME", "");
+    assert(store.get("NAME") == "");
+
+    // A value too long for the slot moves to the heap and back again.
+    const std::string long_value(200, 'x');
+    store.set("NAME", long_value);
+    assert(store.get("NAME") == long_value);
+    store.set("NAME", "short");
+    assert(store.get("NAME") == "short");
+    assert(store.size() == 1);
+
+    assert(store.unset("NAME"));
+    assert(!store.unset("NAME"));
+    assert(!store.get("NAME").has_value());
+    assert(store.size() == 0);
+}
+
+void test_valid_names() {
+    assert(VariableStore::valid_name("PATH"));
+    assert(VariableStore::valid_name("_private9"));
+    assert(!VariableStore::valid_name(""));
+    assert(!VariableStore::valid_name("9lives"));
+    assert(!VariableStore::valid_name("A-B"));
+    assert(!VariableStore::valid_name("A=B"));
+}
+
+void test_growth_and_deletion_keep_every_variable() {
+    VariableStore store;
+    for (int i = 0; i < 1000; ++i) {
+        store.set("VAR_" + std::to_string(i), std::to_string(i * 7));
+    }
+    assert(store.size() == 1000);
+
+    // Deleting every third variable shifts the rest of their probe runs.
+    for (int i = 0; i < 1000; i += 3) {
+        assert(store.unset("VAR_" + std::to_string(i)));
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        const auto value = store.get("VAR_" + std::to_string(i));
+        if (i % 3 == 0) {
+            assert(!value.has_value());
+        } else {
+            assert(value == std::to_string(i * 7));
+        }
+    }
+
+    const auto variables = store.variables();
+    assert(variables.size() == store.size());
+    for (std::size_t i = 1; i < variables.size(); ++i) {
+        assert(variables[i - 1].name < variables[i].name);
+    }
+}
+
+void test_environment_import_and_export() {
+    std::string first = "HOME=/home/user";
+    std::string second = "not a name=dropped";
+    std::string third = "EMPTY=";
+    std::string fourth = "no-separator";
+    std::vector<char *> environment{first.data(), second.data(), third.data(), fourth.data(), nullptr};
+
+    VariableStore store(environment.data());
+    assert(store.size() == 2);
+    assert(store.get("HOME") == "/home/user" && store.exported("HOME"));
+    assert(store.get("EMPTY") == "" && store.exported("EMPTY"));
+    assert(environment_of(store) == (std::set<std::string>{"HOME=/home/user", "EMPTY="}));
+
+    // Unexported variables stay out of the environment.
+    store.set("LOCAL", "1");
+    assert(environment_of(store) == (std::set<std::string>{"HOME=/home/user", "EMPTY="}));
+
+    // A name exported before it has a value joins once it is assigned.
+    store.set_exported("LATER", true);
+    assert(store.exported("LATER") && !store.get("LATER").has_value());
+    assert(environment_of(store).size() == 2);
+    store.set("LATER", "now");
+    assert(environment_of(store).contains("LATER=now"));
+
+    store.set_exported("HOME", false);
+    assert(!environment_of(store).contains("HOME=/home/user"));
+    assert(store.get("HOME") == "/home/user");
+
+    store.unset("LATER");
+    assert(environment_of(store) == (std::set<std::string>{"EMPTY="}));
+
+    const VariableStore empty(nullptr);
+    assert(empty.size() == 0);
+}
+
+void test_envp_is_rebuilt_only_after_exported_changes() {
+    VariableStore store;
+    store.set("EXPORTED", "1");
+    store.set_exported("EXPORTED", true);
+    // Enough room that later inserts do not grow the table.
+    for (int i = 0; i < 8; ++i) {
+        store.set("LOCAL_" + std::to_string(i), "x");
+    }
+
+    char *const *envp = store.envp();
+    assert(!store.envp_dirty_);
+
+    store.set("LOCAL_0", "changed");
+    store.set("ANOTHER", "new");
+    store.unset("LOCAL_1");
+    store.set("EXPORTED", "1");
+    assert(!store.envp_dirty_);
+    assert(store.envp() == envp);
+    assert(std::string_view(envp[0]) == "EXPORTED=1" && envp[1] == nullptr);
+
+    store.set("EXPORTED", "2");
+    assert(store.envp_dirty_);
+    assert(std::string_view(store.envp()[0]) == "EXPORTED=2");
+    assert(!store.envp_dirty_);
+}
+
+void test_scoped_assignments_are_undone() {
+    VariableStore store;
+    store.set("LOCAL", "before");
+    store.set("EXPORTED", "kept");
+    store.set_exported("EXPORTED", true);
+    store.set_exported("VALUELESS", true);
+
+    const std::vector<shell::Assignment> assignments{
+        {.name = "LOCAL", .value = "during"},
+        {.name = "NEW", .value = "1"},
+        {.name = "EXPORTED", .value = "x"},
+        {.name = "VALUELESS", .value = "y"},
+        {.name = "NEW", .value = "2"},
+    };
+
+    {
+        const shell::ScopedAssignments scoped(store, assignments);
+        assert(store.get("LOCAL") == "during" && store.exported("LOCAL"));
+        assert(store.get("NEW") == "2" && store.exported("NEW"));
+        assert(environment_of(store).contains("VALUELESS=y"));
+    }
+
+    assert(store.get("LOCAL") == "before" && !store.exported("LOCAL"));
+    assert(!store.get("NEW").has_value() && !store.exported("NEW"));
+    assert(store.get("EXPORTED") == "kept" && store.exported("EXPORTED"));
+    assert(!store.get("VALUELESS").has_value() && store.exported("VALUELESS"));
+    assert(environment_of(store) == (std::set<std::string>{"EXPORTED=kept"}));
+}
+
+} // namespace
+
+int main() {
+    test_set_get_and_unset();
+    test_valid_names();
+    test_growth_and_deletion_keep_every_variable();
+    test_environment_import_and_export();
+    test_envp_is_rebuilt_only_after_exported_changes();
+    test_scoped_assignments_are_undone();
+
+    return 0;
+}